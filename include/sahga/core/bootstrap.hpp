@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <sahga/core/gasa.hpp>
+#include <sahga/structures/dataset.hpp>
+#include <sahga/structures/graph.hpp>
+#include <string>
+#include <vector>
+
+/*
+ * **Bootstrap class.**
+ *
+ * Percentile confidence intervals for the coefficients of a fitted model. Every replicate
+ * draws the rows of the data with replacement and fits the model again; the interval of a
+ * coefficient spans the middle `confidence` percent of its replicate values.
+ *
+ * A replicate is a weight per row, how many times it was drawn, over the one shared
+ * dataset and MPG: rows left out weigh 0 in the fitness but keep their place in the
+ * neighborhoods of the others, so the MPG stays the same for every replicate. Replicates
+ * run concurrently and start from the full data solution (`run`'s estimate) with a
+ * fraction of its generations, as they only have to find how far it moves.
+ * */
+class Bootstrap {
+public:
+  struct Interval {
+    double estimate;      // Of the full data
+    double lower, upper;  // Percentiles of the replicates
+  };
+
+  // graph and dataset are those the estimate was fitted on, dataset already normalized.
+  Bootstrap(std::shared_ptr<const Graph> graph, std::shared_ptr<const Dataset> dataset,
+            GASA::ModelType modelType, GASA::ObjectiveType objectiveType);
+
+  Bootstrap *setReplicates(int32_t replicates = 200);
+  Bootstrap *setConfidence(double confidence = 95);  // Percent
+  Bootstrap *setSeed(uint32_t seed = std::default_random_engine::default_seed);
+  // GA settings of the replicates; generations <= 0 runs a quarter of those of parameters.
+  Bootstrap *setParameters(GASA::SAHGAParameter parameters, int32_t generations = 0);
+
+  // Fits every replicate starting from estimate, the coefficients fitted on all rows.
+  std::vector<Interval> run(const std::vector<double> &estimate);
+  // Coefficients fitted by every replicate of the last run.
+  const std::vector<std::vector<double>> &replicates() const { return _replicates; }
+
+private:
+  std::shared_ptr<const Graph> _graph;
+  std::shared_ptr<const Dataset> _dataset;
+  GASA::ModelType _modelType;
+  GASA::ObjectiveType _objectiveType;
+  GASA::SAHGAParameter _parameters;
+  int32_t _generations;
+  int32_t _count;
+  double _confidence;
+  uint32_t _seed;
+  std::vector<std::vector<double>> _replicates;
+};
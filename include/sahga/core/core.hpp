@@ -4,6 +4,8 @@
 #include <sahga/structures/dataset.hpp>
 #include <sahga/structures/graph.hpp>
 #include <sahga/structures/layer.hpp>
+#include <sahga/structures/layer_stack.hpp>
+#include <sahga/structures/tiled_raster.hpp>
 #include <sahga/utils/common.hpp>
 #include <sahga/utils/random.hpp>
 
@@ -19,8 +21,24 @@ public:
   SAHGACore* separateTrainTest(const std::string& filename, double ratio = 75.0,
                                bool stratify = false);
   SAHGACore* generateMPG();
-  SAHGACore* extractLayers(const std::string& filename);
+  SAHGACore* buildOverviews(
+      const std::string& folderName, int32_t levels,
+      Utils::binary::Encoding quantization = Utils::binary::Encoding::FLOAT64);
+  SAHGACore* extractLayers(const std::string& filename, int32_t level = 0);
   SAHGACore* mergeData(const std::string& mpgFilename, const std::string& layersFilename);
   SAHGACore* adjustModel(int32_t modelType, int32_t objectType, const std::string& filename,
                          const bool& normalize = true);
+  SAHGACore* predict(const std::string& modelFilename, const std::string& folderName,
+                     const std::string& output, int32_t level = 0);
+  SAHGACore* evaluate(const std::string& modelFilename, const std::string& testFilename,
+                      const std::string& folderName, int32_t level = 0);
+
+  // Runs the jobs of queueFile (see JobRunner::readQueue), at most `workers` at a time.
+  static void runJobs(const std::string& queueFile, int32_t workers);
+  // k-fold cross validation of the default model on pointsFile and layersFolder (relative
+  // to the server folder), with stratified or spatial block folds.
+  static void crossValidate(const std::string& pointsFile, const std::string& layersFolder,
+                            int32_t folds, bool spatial);
+  // Serves fit/predict requests on the Unix socket socketPath until asked to shut down.
+  static void serve(const std::string& socketPath, size_t memoryBudget);
 };
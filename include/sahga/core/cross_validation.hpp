@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <sahga/core/evaluation.hpp>
+#include <sahga/core/gasa.hpp>
+#include <sahga/core/layer_cache.hpp>
+#include <sahga/structures/dataset.hpp>
+#include <sahga/structures/graph.hpp>
+#include <string>
+#include <vector>
+
+/*
+ * **Cross Validation class.**
+ *
+ * Fits the model k times, each time leaving one fold of the points out, and scores every
+ * fit on the points it left out. Folds are either stratified (every fold keeps the
+ * presence/absence proportions of the whole set) or spatial blocks (the points are
+ * binned into square blocks `blockSize` km wide and whole blocks go to a fold, so the
+ * held out points are not next to training points).
+ *
+ * The points, their sampled layers and one neighbor table of all of them are built once
+ * and shared by the folds: the MPG of a fold is the subgraph of its training points in
+ * that table, not a new neighbor search. Folds run concurrently, each a Pipeline of its
+ * own writing its model to `<folder>/fold<k>/result.txt`, and are scored with the
+ * suitability map value at the held out points (see Evaluation).
+ * */
+class CrossValidation {
+public:
+  enum class Scheme { STRATIFIED, SPATIAL };
+
+  struct Fold {
+    std::vector<int32_t> train, test;  // Rows of the points
+  };
+
+  struct Score {
+    int32_t fold;
+    int32_t trainPoints, testPoints;
+    double fitness;         // Of the best chromosome on the training points
+    Evaluation evaluation;  // Of the model on the held out points
+    double seconds;
+  };
+
+  CrossValidation(const std::string &pointsFile, const std::string &layersFolder,
+                  const std::string &folder);
+
+  CrossValidation *setFolds(Scheme scheme, int32_t k = 5,
+                            uint32_t seed = std::default_random_engine::default_seed);
+  CrossValidation *setBlockSize(double km);  // Side of the SPATIAL blocks
+  CrossValidation *setMPG(double radius, Graph::MPGTypes type = Graph::MPGTypes::HALFRADIUM);
+  CrossValidation *setModel(GASA::ModelType modelType, GASA::ObjectiveType objectiveType,
+                            GASA::SAHGAParameter parameters = GASA::SAHGAParameter::HIGHPOP);
+  // Overview level of the layers and the encoding they are stored in (see LayerCache::get)
+  CrossValidation *setLevel(
+      int32_t level, Utils::binary::Encoding quantization = Utils::binary::Encoding::FLOAT64);
+  CrossValidation *shareLayers(std::shared_ptr<LayerCache> layers);
+
+  const Dataset &points() const { return _points; }  // #id;long;lat;presence
+  std::vector<Fold> folds() const;
+
+  std::vector<Score> run();  // Scores in fold order
+  // One line per fold, then the mean and standard deviation of every score.
+  static std::string summary(const std::vector<Score> &scores);
+
+private:
+  std::string _pointsFile, _layersFolder, _folder;
+  Dataset _points;
+  Scheme _scheme;
+  int32_t _k;
+  uint32_t _seed;
+  double _blockSize;
+  double _radius;
+  Graph::MPGTypes _mpgType;
+  GASA::ModelType _modelType;
+  GASA::ObjectiveType _objectiveType;
+  GASA::SAHGAParameter _parameters;
+  int32_t _level;
+  Utils::binary::Encoding _quantization;
+  std::shared_ptr<LayerCache> _layers;
+
+  std::vector<Fold> stratifiedFolds() const;
+  std::vector<Fold> spatialFolds() const;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sahga/core/layer_cache.hpp>
+#include <sahga/core/memory_cache.hpp>
+#include <set>
+#include <string>
+
+/*
+ * **Daemon class.**
+ *
+ * Long-running SAHGA server on a Unix domain socket. A client sends one JSON object per
+ * line and gets JSON lines back: progress events while its request runs, then a "done"
+ * or an "error" line. All requests share one LayerCache and one MemoryCache, so once a
+ * job has run its layers, MPG and sampled data stay in memory (least recently used out
+ * first, within the memory budget) and fitting it again only pays for the GA.
+ *
+ * Requests carry an "op" and the fields of JobRunner::Job (`setField` keys), with paths
+ * relative to the server folder:
+ *
+ *   {"op": "fit", "user": 7, "name": "furcata", "points": "PtsFurcata.txt",
+ *    "layers": "layers", "parameters": "FAST", "predict": true}
+ *   {"op": "predict", "user": 7, "name": "furcata", "layers": "layers", "level": 1}
+ *   {"op": "status"}
+ *   {"op": "shutdown"}
+ *
+ * fit writes result.txt and evaluation.txt (and suitability.asc with "predict") to the
+ * job folder, as JobRunner does, answers with the test scores and the job name (a new one
+ * per request when it has none) and keeps the model for later predicts; predict names
+ * the job and falls back to its result.txt. Events are
+ * {"event": "stage", "stage", "state", "seconds"} for every stage and {"event":
+ * "generation", "generation", "generations", "fitness"} for every generation of the GA.
+ * */
+class Daemon {
+public:
+  // Sends one JSON line to the client of a request.
+  typedef std::function<void(const std::string &line)> Send;
+
+  // derivedFolder holds the rasters, overviews and stacks of the layers (see LayerCache).
+  Daemon(const std::string &socketPath, const std::string &usersFolder,
+         const std::string &serverFolder, size_t memoryBudget = 512 << 20,
+         const std::string &derivedFolder = "");
+  ~Daemon();
+
+  void serve();  // Accepts clients until a shutdown request or `stop`
+  void stop();
+
+private:
+  std::string _socketPath, _usersFolder, _serverFolder;
+  int _listener;
+  std::atomic<bool> _stopping;
+  std::atomic<uint64_t> _fits;  // Requests so far, for the names of unnamed jobs
+  std::shared_ptr<LayerCache> _layers;   // Half of the budget, for the decoded tiles
+  std::shared_ptr<MemoryCache> _memory;  // The other half, for stage results and models
+
+  std::mutex _mutex;
+  std::condition_variable _idle;
+  std::set<int> _clients;  // Open connections
+
+  void handle(int client);
+  void request(const std::map<std::string, std::string> &fields, const Send &send);
+  void fit(const std::map<std::string, std::string> &fields, const Send &send);
+  void predict(const std::map<std::string, std::string> &fields, const Send &send);
+  std::string status() const;
+};
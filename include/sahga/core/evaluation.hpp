@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <sahga/core/predict.hpp>
+#include <sahga/structures/dataset.hpp>
+#include <sahga/structures/layer_stack.hpp>
+#include <sahga/utils/span.hpp>
+#include <string>
+
+/*
+ * **Evaluation class.**
+ *
+ * Scores of a fitted model on points it was not fitted on: the predicted suitability of
+ * every point against its observed presence (1) or absence (0). Points predicted as
+ * noData (outside the layers) are left out.
+ *
+ * AUC is threshold free and comes from the ranks of the predictions (Mann-Whitney), with
+ * ties counted as half. Above `exactLimit` points the ranks are taken from a histogram of
+ * `bins` bins instead of a sort. The confusion matrix, TSS (sensitivity + specificity - 1),
+ * Cohen's kappa and accuracy take the points predicted at or above `threshold` as
+ * presences; RMSE is of the predictions themselves.
+ * */
+class Evaluation {
+public:
+  struct Confusion {
+    int64_t truePositives = 0, falsePositives = 0, falseNegatives = 0, trueNegatives = 0;
+
+    int64_t total() const {
+      return truePositives + falsePositives + falseNegatives + trueNegatives;
+    }
+    double sensitivity() const;  // Presences predicted as presences
+    double specificity() const;  // Absences predicted as absences
+    double accuracy() const;
+    double tss() const;
+    double kappa() const;
+  };
+
+  static constexpr int64_t exactLimit = 1 << 21;
+  static constexpr int32_t bins = 1 << 16;
+
+  int64_t points = 0;  // Points given
+  int64_t scored = 0;  // Points with a prediction
+  double threshold = 0.5;
+  double auc = NAN, rmse = NAN;
+  Confusion confusion;
+
+  /*
+   * Scores predictions against observations (1 presence, 0 absence).
+   *
+   * @param { Span<const double> } predicted - Prediction of each point.
+   * @param { Span<const double> } observed - Presence of each point.
+   * @param { double } threshold - Predictions at or above it count as presences.
+   * @param { double } noData - Prediction of the points left out.
+   * */
+  static Evaluation score(Span<const double> predicted, Span<const double> observed,
+                          double threshold = 0.5, double noData = -9999);
+  // Predicts points (#id;long;lat;presence) with predictor over stack, then scores them.
+  static Evaluation score(const Predictor &predictor, const LayerStack &stack,
+                          const Dataset &points, double threshold = 0.5);
+  static double areaUnderCurve(Span<const double> predicted, Span<const double> observed,
+                               double noData = -9999);
+
+  std::string report() const;  // The scores and the confusion matrix, as text
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <sahga/structures/dataset.hpp>
 #include <sahga/structures/graph.hpp>
@@ -38,6 +39,10 @@ class GASA {
 private:
   double normalizeFitnessFactor;
   std::unique_ptr<Random> _random;
+  std::shared_ptr<const std::vector<double>> weights;  // Of every row, 1 when null
+  std::vector<double> initialGenes;                    // Warm start, empty for none
+
+  double sampleError(const double &observed, const double &estimation) const;
 
   void sortChromosomes(std::vector<Chromosome> &chromosomes, int32_t start, int32_t end);
   int32_t partitionChromosomes(std::vector<Chromosome> &chromosomes, int32_t start, int32_t end);
@@ -46,9 +51,12 @@ public:
   enum class ModelType { LINEAR, QUADRATIC, LAG };
   enum class ObjectiveType { MINSQT, MINERR, MINBOTH };
   enum class SAHGAParameter { DEFAULT, FAST, HARD, ULTRA, HIGHPOP };
+  // Called after every generation with its number (from 1) and the best fitness so far
+  typedef std::function<void(int32_t generation, int32_t generations, double fitness)> Progress;
 
-  Graph *graph;
-  Dataset *dataset;
+  // Read-only inputs, shared with the caller and with other runs over the same data
+  std::shared_ptr<const Graph> graph;
+  std::shared_ptr<const Dataset> dataset;
   int32_t populationSize, eliteSize, geneSize, maxGenerations, maxIterations;
   ModelType modelType;
   ObjectiveType objectiveFunction;
@@ -63,7 +71,13 @@ public:
   std::vector<GeneFormat> chromosomeFormat;
   std::vector<Chromosome> population;
   Chromosome bestChromosome;
+  Progress progress;
 
+  GASA(std::shared_ptr<const Graph> graph, std::shared_ptr<const Dataset> dataset,
+       const ModelType &modelType = ModelType::LINEAR,
+       const ObjectiveType &objectiveFunction = ObjectiveType::MINSQT);
+  GASA(Graph &&graph, Dataset &&dataset, const ModelType &modelType = ModelType::LINEAR,
+       const ObjectiveType &objectiveFunction = ObjectiveType::MINSQT);
   GASA(const Graph &graph, const Dataset &dataset, const ModelType &modelType = ModelType::LINEAR,
        const ObjectiveType &objectiveFunction = ObjectiveType::MINSQT);
   ~GASA();
@@ -81,6 +95,9 @@ public:
   GASA *setCrossoverRate(const float &crossoverRate = 80);
   GASA *setMutationRate(const float &mutationRate = 1);
   GASA *setEpsilon(const float &episilon = 0.1);
+  GASA *setProgress(Progress progress);
+  GASA *setWeights(std::shared_ptr<const std::vector<double>> weights);
+  GASA *setInitialChromosome(const std::vector<double> &genes);
 
   GASA *run();
 
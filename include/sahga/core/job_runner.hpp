@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <sahga/core/gasa.hpp>
+#include <sahga/core/layer_cache.hpp>
+#include <sahga/core/pipeline.hpp>
+#include <sahga/structures/graph.hpp>
+#include <sahga/utils/parallel.hpp>
+#include <string>
+#include <vector>
+
+/*
+ * **Job Runner class.**
+ *
+ * Runs queued modeling jobs (a species points file, the layers and the model to fit) on a
+ * bounded number of workers. Every job is a Pipeline of its own writing to
+ * `<usersFolder>/<user>/jobs/<name>`: result.txt, suitability.asc, evaluation.txt,
+ * bootstrap.txt (with `bootstrap` replicates) and report.txt, the timings of its stages,
+ * the memory it held and the test scores. All jobs sample and predict through one
+ * LayerCache, so layers shared by many jobs are opened once and their tiles are decoded
+ * into a single bounded cache; stage outputs are cached per user in `<user>/cache`.
+ *
+ * A failing job is reported and does not stop the others.
+ * */
+class JobRunner {
+public:
+  struct Job {
+    std::string name;  // Folder of the job inside the user's jobs folder: no '/', '\\' or ".."
+    int32_t userId = 1;  // Not negative
+    std::string points;  // #id, label, long, lat, presence
+    std::string layers;  // Folder of the layers
+    GASA::ModelType modelType = GASA::ModelType::QUADRATIC;
+    GASA::ObjectiveType objectiveType = GASA::ObjectiveType::MINBOTH;
+    GASA::SAHGAParameter parameters = GASA::SAHGAParameter::HIGHPOP;
+    Graph::MPGTypes mpgType = Graph::MPGTypes::HALFRADIUM;
+    double radius = 5;
+    double ratio = 75;      // Percentage of the points used to fit
+    int32_t level = 0;      // Overview level of the layers (0 = full resolution)
+    // Encoding the layers are stored in (see LayerCache::get)
+    Utils::binary::Encoding quantization = Utils::binary::Encoding::FLOAT64;
+    int32_t bootstrap = 0;  // Replicates for the coefficient intervals (0 = none)
+  };
+
+  struct Report {
+    std::string name, folder;
+    int32_t userId;
+    bool ok;
+    std::string error;
+    double seconds;        // Wall time of the job
+    size_t dataBytes;      // Held by the datasets and the MPG of the job at its end
+    size_t peakBytes;      // Peak resident memory of the process when the job ended
+    double auc;            // Of the model on the test points
+    std::string stages;    // Timings of the stages (TaskGraph::report)
+  };
+
+  // derivedFolder holds the rasters, overviews and stacks of the layers (see LayerCache).
+  explicit JobRunner(const std::string &usersFolder, int32_t workers = 1,
+                     size_t tileCapacity = 256 << 20, const std::string &derivedFolder = "");
+
+  /*
+   * Jobs of a queue file: one job per line as `key=value` fields separated by blanks,
+   * e.g. `name=furcata user=7 points=PtsFurcata.txt layers=layers model=QUADRATIC`.
+   * Keys are name, user, points, layers, model, objective, parameters, mpg, radius, ratio,
+   * level, quantization and bootstrap; missing ones take the defaults of Job. Blank lines
+   * and lines starting with '#' are skipped, and relative paths are relative to the folder
+   * of the queue.
+   * */
+  static std::vector<Job> readQueue(const std::string &fileName);
+  // Sets the field key of job (a key of the queue format); paths are relative to folder.
+  static void setField(Job &job, const std::string &key, const std::string &value,
+                       const std::string &folder);
+  // Adds the stages of job on pipeline to stages, predicting to output unless it is empty;
+  // the model is always evaluated.
+  // pipeline and job must outlive the run of stages.
+  static void addStages(Utils::parallel::TaskGraph &stages, Pipeline &pipeline, const Job &job,
+                        const std::string &output);
+
+  std::vector<Report> run(const std::vector<Job> &jobs);  // Reports in the order of jobs
+  static std::string summary(const std::vector<Report> &reports);
+
+  const LayerCache &layers() const { return *_layers; }
+
+private:
+  std::string _usersFolder;
+  int32_t _workers;
+  std::shared_ptr<LayerCache> _layers;
+
+  Report runJob(const Job &job) const;
+};
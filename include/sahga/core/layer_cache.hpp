@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sahga/structures/layer_stack.hpp>
+#include <sahga/structures/tiled_raster.hpp>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/*
+ * **Layer Cache class.**
+ *
+ * Layers folders opened once and shared by every pipeline that samples or predicts on
+ * them. `get` hands out reference-counted sets of layers: a set stays loaded while the
+ * cache or any pipeline holds it, and all of them decode their tiles into one TileCache,
+ * so memory is bounded by its capacity however many jobs run on the same layers.
+ *
+ * Layers are opened as in SAHGACore: ASCII grids are converted to tiled rasters (.sdr)
+ * when missing, stale or unreadable and overviews are built on demand. Derived files go
+ * next to the layers, or to a folder per layers folder inside `derivedFolder` when one is
+ * given, and are written whole or not at all. Layers quantized to a narrower encoding are
+ * derived into a folder of their own per encoding, so jobs asking for different ones never
+ * overwrite each other's rasters. Every set is loaded by one thread while the others
+ * asking for it wait, with no lock held, so concurrent jobs never convert the same grid
+ * twice. Sets are not reloaded when their files change: `trim` them (or use a new cache)
+ * to pick changes up.
+ * */
+class LayerCache {
+public:
+  struct Layers {
+    std::vector<std::unique_ptr<TiledRaster>> rasters;  // In name order
+    std::unique_ptr<LayerStack> stack;  // The rasters interleaved, null when not on one grid
+  };
+
+  explicit LayerCache(size_t tileCapacity = 64 << 20, const std::string &derivedFolder = "");
+
+  // The layers in folderName at the overview level (0 = full resolution). quantization:
+  // INT16, UINT16 or FLOAT32 to store the converted layers in when they do not fit it
+  // exactly (see TiledRaster::convert); FLOAT64 keeps them exact.
+  std::shared_ptr<const Layers> get(
+      const std::string &folderName, int32_t level = 0,
+      Utils::binary::Encoding quantization = Utils::binary::Encoding::FLOAT64);
+  size_t trim();  // Drops the sets no pipeline holds; returns how many were dropped
+  size_t size() const;  // Sets held
+  const TileCache &tiles() const { return *_tiles; }
+
+  // Source file of every layer in folderName by name: the .asc grid when there is one, as
+  // rasters, stacks and overviews are all derived from it, or else the .sdr raster.
+  static std::map<std::string, std::filesystem::path> sources(const std::string &folderName);
+  // Folder of the files derived from the layers in folderName, quantized as asked.
+  std::filesystem::path derivedFolder(
+      const std::string &folderName,
+      Utils::binary::Encoding quantization = Utils::binary::Encoding::FLOAT64) const;
+  // Folder of the overviews of folderName at level (1 = 2x, 2 = 4x, ...; 0 is its derived
+  // folder).
+  std::filesystem::path overviewFolder(
+      const std::string &folderName, int32_t level,
+      Utils::binary::Encoding quantization = Utils::binary::Encoding::FLOAT64) const;
+
+private:
+  // Canonical path of the folder, level and quantization
+  typedef std::tuple<std::string, int32_t, Utils::binary::Encoding> Key;
+
+  std::shared_ptr<TileCache> _tiles;
+  std::string _derivedFolder;  // Empty: derived files go next to the layers
+  mutable std::mutex _mutex;  // Guards _sets only, never held while loading
+  std::map<Key, std::shared_future<std::shared_ptr<const Layers>>> _sets;
+
+  std::shared_ptr<const Layers> load(const std::string &folderName, int32_t level,
+                                     Utils::binary::Encoding quantization);
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+/*
+ * **Memory Cache class.**
+ *
+ * Results of pipeline stages (splits, MPGs, sampled layers, merged data) kept in memory
+ * under their StageCache key, least recently used first out once `budget` bytes are held.
+ * Values are shared as const pointers and remain valid after being evicted; callers copy
+ * what they need to change. One cache can be shared by any number of pipelines and
+ * threads, which is what keeps the graphs of recent requests warm in the daemon.
+ * */
+class MemoryCache {
+public:
+  explicit MemoryCache(size_t budget = 256 << 20);
+
+  // The value stored under key (as the type it was stored with), or null.
+  template <typename T>
+  std::shared_ptr<const T> get(uint64_t key) {
+    return std::static_pointer_cast<const T>(find(key));
+  }
+  // Stores value under key as `bytes` bytes, evicting older values to stay in budget.
+  template <typename T>
+  void put(uint64_t key, std::shared_ptr<const T> value, size_t bytes) {
+    insert(key, std::static_pointer_cast<const void>(std::move(value)), bytes);
+  }
+
+  size_t size() const;  // Bytes of the cached values
+  size_t count() const;
+  size_t budget() const { return _budget; }
+  uint64_t hits() const { return _hits; }
+  uint64_t misses() const { return _misses; }
+
+private:
+  struct Entry {
+    std::shared_ptr<const void> value;
+    size_t bytes;
+    std::list<uint64_t>::iterator order;
+  };
+
+  mutable std::mutex _mutex;
+  size_t _budget, _size;
+  std::atomic<uint64_t> _hits, _misses;
+  std::list<uint64_t> _order;  // Most recently used first
+  std::unordered_map<uint64_t, Entry> _entries;
+
+  std::shared_ptr<const void> find(uint64_t key);
+  void insert(uint64_t key, std::shared_ptr<const void> value, size_t bytes);
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <random>
+#include <sahga/core/bootstrap.hpp>
+#include <sahga/core/evaluation.hpp>
+#include <sahga/core/gasa.hpp>
+#include <sahga/core/layer_cache.hpp>
+#include <sahga/core/memory_cache.hpp>
+#include <sahga/core/predict.hpp>
+#include <sahga/core/stage_cache.hpp>
+#include <sahga/structures/dataset.hpp>
+#include <sahga/structures/graph.hpp>
+#include <string>
+
+/*
+ * **Pipeline class.**
+ *
+ * The modeling stages of SAHGACore with their results kept in memory: every stage reads
+ * the Dataset/Graph the previous one left in the pipeline, so nothing is written and
+ * parsed back between them.
+ *
+ *   separateTrainTest -> generateMPG -> extractLayers -> mergeData -> adjustModel -> predict
+ *                                                                                 -> evaluate
+ *                                                                                 -> bootstrap
+ *
+ * The fitted model (result.txt) always goes to `folder`. With `keepIntermediates` every
+ * stage also writes what it produced there, in the same files SAHGACore reads (train.txt,
+ * test.txt, gpm.mpg, layersData.sds, mergedData.mpg), which is useful for debugging or
+ * to resume from a stage. evaluate scores the model on the test points, which the other
+ * stages leave aside, and writes the scores to evaluation.txt; bootstrap refits the model
+ * on resamples of the training points for the confidence intervals in bootstrap.txt.
+ *
+ * With `useCache` the stages up to mergeData store those same files in a StageCache,
+ * keyed by their inputs (the points file, the split ratio and seed, the MPG radius and
+ * criterion, the fingerprints of the layer files), and load them from there instead of
+ * running when nothing they depend on changed. adjustModel and the stages after it always
+ * run.
+ *
+ * `useMemory` puts a MemoryCache in front of the StageCache, so a long-running process
+ * keeps the results of recent stages without reading them back from disk.
+ *
+ * extractLayers, predict and evaluate take the layers from a LayerCache, one of the pipeline's own
+ * unless `shareLayers` hands it one shared with other pipelines, stored exactly unless
+ * `quantizeLayers` asks for a narrower encoding.
+ * */
+class Pipeline {
+public:
+  Dataset train, test;              // #id;long;lat;presence
+  std::shared_ptr<Graph> graph;     // MPG of the training points
+  Dataset layersData;               // #id;long;lat;presence;x0;x1;...;xn
+  std::shared_ptr<Dataset> merged;  // presence;x0;x1;...;xn, one row per MPG node
+  SuitabilityModel model;
+  Evaluation evaluation;  // Of the model on the test points
+  std::vector<Bootstrap::Interval> intervals;  // Of the model coefficients, by bootstrap
+  std::string source;  // Named in result.txt as the data the model was fitted on
+
+  explicit Pipeline(const std::string &folder);
+
+  Pipeline *keepIntermediates(bool keep = true);
+  Pipeline *useCache(const std::string &cacheFolder);
+  Pipeline *shareLayers(std::shared_ptr<LayerCache> layers);
+  Pipeline *useMemory(std::shared_ptr<MemoryCache> memory);
+  Pipeline *quantizeLayers(Utils::binary::Encoding quantization);  // See LayerCache::get
+  Pipeline *onGeneration(GASA::Progress progress);  // Passed on to the GASA of adjustModel
+  // Called with the key name of every stage loaded from the cache, from the thread of the
+  // stage.
+  Pipeline *onRestore(std::function<void(const std::string &stage)> restored);
+  // Neighborhood of predict and evaluate (see Predictor) for a model fitted on an MPG this
+  // pipeline did not generate; generateMPG sets it to the pipeline's own.
+  Pipeline *setNeighborhood(double radius, Graph::MPGTypes type, int32_t neighbors = 8);
+  std::string pathTo(const std::string &file) const;  // file inside the pipeline folder
+
+  Pipeline *separateTrainTest(const std::string &fileName, double ratio = 75.0,
+                              bool stratify = false,
+                              uint32_t seed = std::default_random_engine::default_seed);
+  Pipeline *generateMPG(double radius = 5, Graph::MPGTypes type = Graph::MPGTypes::HALFRADIUM);
+  Pipeline *extractLayers(const std::string &folderName, int32_t level = 0);
+  Pipeline *mergeData();
+  Pipeline *adjustModel(GASA::ModelType modelType, GASA::ObjectiveType objectiveType,
+                        bool normalize = true,
+                        GASA::SAHGAParameter parameters = GASA::SAHGAParameter::HIGHPOP);
+  Pipeline *predict(const std::string &folderName, const std::string &output, int32_t level = 0);
+  Pipeline *evaluate(const std::string &folderName, int32_t level = 0, double threshold = 0.5);
+  Pipeline *bootstrap(int32_t replicates = 200, double confidence = 95, int32_t generations = 0);
+
+  size_t bytes() const;  // Held by the datasets and the MPG of the pipeline
+
+  // Overviews of the layers in folderName up to levels (2x, 4x, ... 2^levels x), written to
+  // derivedFolder (see LayerCache) or next to the layers, quantized as asked. Returns the
+  // layers of the last level.
+  static std::shared_ptr<const LayerCache::Layers> buildOverviews(
+      const std::string &folderName, int32_t levels, const std::string &derivedFolder = "",
+      Utils::binary::Encoding quantization = Utils::binary::Encoding::FLOAT64);
+
+private:
+  std::string folder;
+  bool intermediates;
+  double radius;          // Of the MPG, reused as the neighborhood of the prediction
+  Graph::MPGTypes mpgType;
+  int32_t neighbors;      // Of the KNN criteria
+  std::shared_ptr<StageCache> cache;
+  StageCache::Key splitKey, mpgKey, layersKey;
+  std::shared_ptr<LayerCache> layerCache;
+  Utils::binary::Encoding quantization;  // Of the layers taken from layerCache
+  std::shared_ptr<MemoryCache> memory;
+  GASA::Progress progress;
+  std::function<void(const std::string &stage)> restored;
+  std::shared_ptr<const Dataset> fitted;  // The normalized data adjustModel fitted on
+  GASA::ObjectiveType fitObjective;
+  GASA::SAHGAParameter fitParameters;
+
+  bool restore(const StageCache::Key &key, const std::vector<std::string> &files) const;
+  void save(const StageCache::Key &key,
+            const std::function<void(const std::string &folder)> &write) const;
+  template <typename T>
+  std::shared_ptr<const T> recall(const StageCache::Key &key) const;
+  template <typename T>
+  void keep(const StageCache::Key &key, T value, size_t bytes) const;
+};
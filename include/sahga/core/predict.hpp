@@ -0,0 +1,68 @@
+#pragma once
+
+#include <sahga/core/gasa.hpp>
+#include <sahga/structures/graph.hpp>
+#include <sahga/structures/layer_stack.hpp>
+#include <sahga/utils/span.hpp>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------
+// Fitted model, as adjustModel writes it to result.txt
+//----------------------------------------------------------------------------------------------
+struct SuitabilityModel {
+  GASA::ModelType type;
+  std::vector<double> coefficients;  // c1;c2;...;cn;constante;[lambda] (the best chromosome)
+  std::vector<double> avg, stdDev;   // Of the presence column and of each variable X1..Xn
+
+  static SuitabilityModel load(const std::string &fileName);  // Reads a result.txt
+  int32_t variables() const { return (int32_t)avg.size() - 1; }
+};
+
+/*
+ * **Predictor class.**
+ *
+ * Evaluates a fitted model over every cell of a layer stack and writes the suitability
+ * map as an ESRI ASCII grid that Layer can load.
+ *
+ * The neighborhood of a cell is every cell whose center lies within `radius` km, weighed
+ * like the MPG edges of `type`, with the cell itself at weight 1. For KNN and KNNIDW it is
+ * the `neighbors` closest cells instead, within `radius` km unless it is <= 0. LINEAR and QUADRATIC
+ * models use the weighted means of the variables over it. LAG models need the response
+ * of the neighbors, which a map does not have: it is approximated in one step by the
+ * non-spatial part of the model evaluated at each neighbor.
+ *
+ * The map is computed one tile (plus a halo as wide as the neighborhood) at a time, the
+ * tiles of a band of rows in parallel, and each band is written as soon as it is done,
+ * so memory depends on the tile size and the map width, not on the map size.
+ * */
+class Predictor {
+public:
+  explicit Predictor(const SuitabilityModel &model, double radius = 5,
+                     Graph::MPGTypes type = Graph::MPGTypes::HALFRADIUM, int32_t neighbors = 8,
+                     int32_t tileSize = 256);
+
+  Predictor *predict(const LayerStack &stack, const std::string &fileName);
+  // The map value at each point: noData outside the stack or where a layer has no data.
+  std::vector<double> predictPoints(const LayerStack &stack, Span<const double> longitude,
+                                    Span<const double> latitude) const;
+  double noDataValue() const { return noData; }
+
+private:
+  struct Offset {
+    int32_t row, col;
+    double weight;
+  };
+
+  SuitabilityModel model;
+  double radius;
+  Graph::MPGTypes type;
+  int32_t neighbors;  // KNN, KNNIDW
+  int32_t tileSize;
+  double noData;
+
+  std::vector<Offset> neighborhood(const LayerStack &stack) const;
+  void predictTile(const LayerStack &stack, const std::vector<Offset> &offsets, int32_t halo,
+                   int32_t row, int32_t col, int32_t rows, int32_t cols, double *out,
+                   int64_t rowStride) const;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*
+ * **Stage Cache class.**
+ *
+ * Outputs of pipeline stages stored under a hash of everything they were computed from
+ * (input data, parameters and the keys of the stages they depend on). Every entry is a
+ * folder `<stage>-<key>` holding the files the stage writes as intermediates, so a stage
+ * whose key is found loads them instead of running.
+ *
+ * Entries are written to a temporary folder and renamed into place, so a run that stops
+ * halfway never leaves an entry that looks complete. Nothing is ever evicted: remove the
+ * cache folder to reclaim its space.
+ * */
+class StageCache {
+public:
+  /*
+   * Hash of the inputs of a stage. Values are folded in the order they are added, so
+   * the same inputs always give the same key.
+   * */
+  class Key {
+  public:
+    explicit Key(const std::string &stage);
+
+    Key &add(const void *data, size_t size);
+    Key &add(const std::string &text);
+    Key &add(const Key &key);  // Chains the key of a stage this one depends on
+    template <typename T,
+              typename = std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>>>
+    Key &add(T value) {
+      return add(&value, sizeof(value));
+    }
+    Key &addFile(const std::string &fileName);         // Contents of the file
+    Key &addFingerprint(const std::string &fileName);  // Path, size and modification time
+
+    const std::string &stage() const { return _stage; }
+    uint64_t value() const { return _value; }
+    std::string name() const;  // <stage>-<16 hex digits>
+
+  private:
+    std::string _stage;
+    uint64_t _value;
+  };
+
+  explicit StageCache(const std::string &folder);
+
+  std::string path(const Key &key, const std::string &file) const;  // file of the entry
+  bool contains(const Key &key, const std::vector<std::string> &files) const;
+  // Creates the entry of key: write(folder) stores the files of the entry in folder.
+  void store(const Key &key, const std::function<void(const std::string &folder)> &write) const;
+
+private:
+  std::string _folder;
+};
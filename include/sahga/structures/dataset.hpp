@@ -1,5 +1,10 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
+#include <sahga/utils/binary_format.hpp>
+#include <sahga/utils/span.hpp>
+#include <string>
 #include <vector>
 
 /*
@@ -22,6 +27,12 @@ typedef struct {
  * Advanced custom structure to store dataset info natively with operations
  * for its statistical data.
  *
+ * The values live in a single 64-byte aligned buffer, stored row by row
+ * (ROW_MAJOR) or column by column (COLUMN_MAJOR). `row(i)` and `column(j)`
+ * view any row or column in either layout; `M[i][j]` is kept as a view of the
+ * rows of ROW_MAJOR datasets (it is nullptr for COLUMN_MAJOR ones). The buffer
+ * may also belong to someone else, e.g. a memory-mapped file (see `view`).
+ *
  * **Public Interface**
  *
  * - rowN: Number of rows in the matrix;
@@ -29,19 +40,45 @@ typedef struct {
  * */
 class Dataset {
 public:
+  enum class Layout { ROW_MAJOR, COLUMN_MAJOR };
+
   int rowN;    // Number of rows in the matrix
   int colN;    // Number of columns in the matrix
-  double **M;  // Pointer to the matrix data
+  double **M;  // Pointers to the rows of the matrix data (ROW_MAJOR only)
   std::vector<Stats> stats;
+  std::vector<std::string> names;  // Column names (optional)
 
   // Sets initial matrix properties
   Dataset();
   // Deallocate the memory region where the data is stored
   ~Dataset();
 
-  bool reset(int row = 1,
-             int col = 1);        // Resets array size and allocates space for data
-  bool copy(const Dataset &src);  // Copies the matrix into src
+  Dataset(const Dataset &src);             // Deep copy
+  Dataset(Dataset &&src) noexcept;         // Takes over the storage of src
+  Dataset &operator=(const Dataset &src);  // Deep copy
+  Dataset &operator=(Dataset &&src) noexcept;
+
+  bool reset(int row = 1, int col = 1,
+             Layout layout = Layout::ROW_MAJOR);  // Resets array size and allocates space for data
+  bool copy(const Dataset &src);                  // Copies the matrix into src
+  bool view(std::shared_ptr<double> storage, int row, int col, Layout layout,
+            int64_t stride);      // Uses external storage (shared, not copied) as the matrix
+  bool setLayout(Layout layout);  // Rearranges the values in the given layout
+  bool saveBinary(const std::string &fileName,
+                  const std::vector<Utils::binary::Encoding> &encodings
+                  = {}) const;  // Saves the matrix as a columnar binary dataset (.sds)
+
+  Layout layout() const { return _layout; }
+  int64_t stride() const { return _stride; }  // Distance between rows (ROW_MAJOR) or columns
+  double *data() { return _buffer.get(); }
+  const double *data() const { return _buffer.get(); }
+
+  double &at(int i, int j) { return _buffer.get()[offset(i, j)]; }
+  double at(int i, int j) const { return _buffer.get()[offset(i, j)]; }
+  Span<double> row(int i);
+  Span<const double> row(int i) const;
+  Span<double> column(int j);
+  Span<const double> column(int j) const;
 
   bool updateStats();  // Update matrix status for each column
   bool getStats(       // TODO: Change to return [vector<double>, vector<double>]
@@ -54,5 +91,14 @@ public:
                  int r);  // Ordena as linhas de l a r, considerando col como coluna chave
 
 private:
+  Layout _layout;
+  int64_t _stride;
+  std::shared_ptr<double> _buffer;  // Aligned storage of the values
+  std::vector<double *> _rows;      // Storage behind M
+
+  int64_t offset(int i, int j) const {
+    return (_layout == Layout::ROW_MAJOR) ? i * _stride + j : j * _stride + i;
+  }
+  void swapRows(int i, int j);
   int partition(int col, int l, int r);
 };
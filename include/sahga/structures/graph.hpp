@@ -1,6 +1,8 @@
 #pragma once
 
+#include <memory>
 #include <sahga/structures/dataset.hpp>
+#include <sahga/structures/spatial_index.hpp>
 #include <string>
 #include <vector>
 
@@ -15,20 +17,67 @@ typedef struct {
   std::vector<TEdge> edge;  // All node relationships (edges connected to node)
 } TNode;
 
+// Neighbors of every point within `radius` km, each list sorted by distance (closest
+// first) and stored back to back: the neighbors of row i are neighbor[offset[i]..offset[i + 1]).
+typedef struct {
+  double radius;
+  std::vector<int32_t> offset;
+  std::vector<SpatialIndex::Neighbor> neighbor;
+} TNeighborTable;
+
 class Graph {
 public:
-  enum MPGTypes { UNDEFINED, HALFRADIUM, UMBD, UMBD2 };
+  // Radius criteria (HALFRADIUM, UMBD, UMBD2) relate every point within R km.
+  // Nearest-neighbor criteria (KNN, KNNIDW) relate the `neighbors` closest points,
+  // optionally limited to R km, with uniform (KNN) or 1/d (KNNIDW) weights.
+  enum MPGTypes { UNDEFINED, HALFRADIUM, UMBD, UMBD2, KNN, KNNIDW };
 
   int nNodes;            // Number of nodes in the graph
   MPGTypes type;         // MPG type --> criteria used to generate the graph (MPG)
+  int32_t neighbors;     // Neighbors per node for the nearest-neighbor criteria
   std::vector<TNode> node;  // Set of nodes that make up the graph
 
   Graph();
   ~Graph();
+  Graph(const Graph &src) = default;  // The spatial index is shared until either side changes
+  Graph(Graph &&src) = default;
+  Graph &operator=(const Graph &src) = default;
+  Graph &operator=(Graph &&src) = default;
+
   Graph *insert(const TNode &node);  // Insert new node in graph
   Graph *copy(const Graph &src);     // Copy graph into src
+  Graph *setNeighbors(const int32_t &neighbors = 8);  // Neighbors per node (KNN, KNNIDW)
   Graph *createMPG(const Dataset &M, const double &R,
                    int32_t T);  // Analyze M and build a graph (MPG) based on T
+                                // (R <= 0 means no radius limit for KNN, KNNIDW)
+  Graph *createMPG(const Dataset &M, const TNeighborTable &table, const double &R,
+                   int32_t T);  // Build the MPG for R <= table.radius by truncating the table
+  Graph *createMPG(const Dataset &M, const TNeighborTable &table,
+                   const std::vector<int32_t> &rows, const double &R,
+                   int32_t T);  // The same, for the points `rows` of M alone (ids 1..rows.size())
+  static TNeighborTable findNeighbors(const Dataset &M,
+                                      const double &R);  // Neighbor search shared by many MPGs
+  static std::vector<Graph> createMPGSweep(
+      const Dataset &M, const std::vector<double> &radii, int32_t T,
+      const int32_t &neighbors = 8);  // One MPG per radius out of a single neighbor search
+  static double edgeWeight(MPGTypes type, double dist,
+                           double R);  // Weight of an edge `dist` km long under the MPG type T
+  Graph *insertPoints(const Dataset &M);  // Appends the points in M (#id;long;lat;presence)
+  Graph *removePoints(const std::vector<int32_t> &nodeIds);  // Removes nodes, ids stay 1..nNodes
   Graph *save(const std::string &inFileName, const double &R,
               const std::string &outFileName);  // Saves the graph (MPG) in a text file
+  Graph *saveBinary(const std::string &outFileName,
+                    const Dataset *M = nullptr);  // Saves the graph (MPG) [and M] as binary MPG
+
+private:
+  // State kept by createMPG(M, R, T) so points can be inserted and removed later
+  double radius;                        // R the MPG was built with
+  std::shared_ptr<SpatialIndex> index;  // Location and type of every node
+  std::vector<int32_t> slotOfNode;      // Index slot of each node
+  std::vector<int32_t> nodeOfSlot;      // Node of each index slot (-1 once removed)
+  std::vector<double> reach;            // Farthest distance at which a slot gains a neighbor
+
+  void relate(int32_t slot);  // Rebuilds the edges of the node in slot (KNN, KNNIDW)
+  void candidates(int32_t slot, double R,
+                  std::vector<SpatialIndex::Neighbor> &out);  // Same type nodes within R km
 };
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <sahga/utils/common.hpp>
+#include <sahga/utils/sampling.hpp>
+#include <sahga/utils/span.hpp>
+#include <string_view>
 
 class Layer {
 public:
@@ -18,6 +21,8 @@ public:
   Layer();   // Ajusta propriedades da Layer
   ~Layer();  // Desaloca a regiao de memoria onde os dados estao armazenados
   Layer *load(const std::string &fileName);  // Le uma Layer indicada no path
+  size_t readHeader(const std::vector<std::string_view>
+                        &lines);  // Le o cabecalho ASCII e retorna a primeira linha de dados
   Layer *save(const std::string &fileName);  // Salva uma Layer indicada no path
   Layer *updateStat();  // Calcula a média e o desvio padrão dos dados da Layer
   Layer *setStat(const double &avg,
@@ -32,6 +37,15 @@ public:
   double getLong(int32_t x);         // Retorna a longitude no centro da coluna x
   double getLat(int32_t y);          // Retorna a loatitude no centro da linha y
 
+  double cell(int32_t row, int32_t col) const;  // Valor da celula (linha, coluna)
+  void getValues(Span<const double> longitude, Span<const double> latitude,
+                 Span<double> out) const;  // getValue de varios pontos
+  void sample(Span<const double> longitude, Span<const double> latitude, Span<double> out,
+              Utils::sampling::Mode mode,
+              int32_t k = 3) const;  // Amostra varios pontos (vizinho, bilinear ou media k x k)
+  Layer *focalMean(int32_t k);       // Troca cada celula pela media da janela k x k
+  Utils::sampling::Grid grid() const;  // Georreferenciamento das celulas
+
 private:
   void minMax();
 };
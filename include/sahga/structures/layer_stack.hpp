@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <sahga/structures/tiled_raster.hpp>
+#include <sahga/utils/binary_format.hpp>
+#include <sahga/utils/mapped_file.hpp>
+#include <sahga/utils/quantize.hpp>
+#include <sahga/utils/sampling.hpp>
+#include <string>
+#include <vector>
+
+/*
+ * **Layer Stack class.**
+ *
+ * Every environmental layer of a grid in one pixel-interleaved cube (.sdc, see
+ * Utils::binary): the N values of a cell sit next to each other, so `sample` reads all
+ * the variables of a location from one or two cache lines instead of N grids. Each band
+ * keeps the codes of its tiled raster (encoding, scale and offset), so the cube is no
+ * larger than the rasters uncompressed, and is decoded as it is read. The cube is
+ * memory-mapped, which keeps resident memory to the pages actually visited.
+ * */
+class LayerStack {
+public:
+  explicit LayerStack(const std::string &fileName);  // Maps a stack, throws if it can't
+
+  // Interleaves layers (which must share their grid) into the stack fileName, replacing it
+  // only once the new stack is complete.
+  static void build(const std::vector<const TiledRaster *> &layers, const std::string &fileName);
+  // Same xCorner, yCorner, cellSize and dimensions.
+  static bool sameGrid(const Utils::binary::RasterHeader &a, const Utils::binary::RasterHeader &b);
+
+  const Utils::binary::StackHeader &header() const { return *_header; }
+  const Utils::binary::BandHeader &band(int32_t b) const { return _bands[b]; }
+  int32_t bands() const { return _header->nBands; }
+  int32_t rows() const { return _header->rows; }
+  int32_t cols() const { return _header->cols; }
+  std::vector<std::string> names() const;  // Band names, in band order
+
+  // Every band at count cells of row from col on: band b of the k-th cell goes to
+  // out[k * bands() + b]. The cells must lie inside the grid.
+  void read(int32_t row, int32_t col, int32_t count, double *out) const;
+  void cell(int32_t row, int32_t col, double *out) const { read(row, col, 1, out); }
+  // Every band at (longitude, latitude), or their noData values outside the grid.
+  void sample(double longitude, double latitude, double *out) const;
+  // Cell holding (longitude, latitude), computed like Layer::getValue.
+  bool locate(double longitude, double latitude, int32_t &row, int32_t &col) const;
+
+private:
+  std::unique_ptr<MappedFile> _file;
+  const Utils::binary::StackHeader *_header;
+  const Utils::binary::BandHeader *_bands;
+  const char *_cube;
+  std::vector<Utils::quantize::Codec> _codecs;  // Of every band
+};
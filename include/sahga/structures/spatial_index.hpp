@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * **Spatial Index class.**
+ *
+ * Uniform grid over (longitude, latitude) points. Each point lives in a square
+ * cell of side `cellSize` (degrees), so a radius query only visits the cells that
+ * overlap the search circle and a nearest-neighbor query expands ring by ring
+ * around the query cell, keeping the best candidates in a bounded max-heap.
+ *
+ * Points are addressed by the slot returned from `insert`. Slots are never
+ * reused, which keeps them stable across `remove` calls.
+ *
+ * Distances are reported in km, using the same metric as
+ * `Utils::miscellaneous::distance`.
+ * */
+class SpatialIndex {
+public:
+  struct Point {
+    double x, y;    // Longitude and latitude of the point
+    int32_t label;  // Class of the point (presence/absence); queries never mix labels
+    bool alive;     // false once the point has been removed
+  };
+
+  struct Neighbor {
+    int32_t slot;     // Slot of the neighbor point
+    double distance;  // Distance (km) between the query and the neighbor
+  };
+
+  explicit SpatialIndex(double cellSize = 1.0);
+
+  int32_t insert(double x, double y, int32_t label = 0);  // Adds a point, returns its slot
+  void remove(int32_t slot);                               // Removes the point in slot
+  const Point &point(int32_t slot) const { return points[slot]; }
+  int32_t slots() const { return (int32_t)points.size(); }  // Slots ever handed out
+  int32_t size() const { return alive; }                     // Points currently indexed
+
+  // Every point labeled `label` within `R` km of (x, y), in no particular order.
+  void radius(double x, double y, double R, int32_t label, std::vector<Neighbor> &out,
+              int32_t exclude = -1) const;
+  // The `k` points labeled `label` closest to (x, y), sorted by distance. When
+  // `maxRadius` > 0 only points within `maxRadius` km are considered.
+  void nearest(double x, double y, int32_t k, int32_t label, double maxRadius,
+               std::vector<Neighbor> &out, int32_t exclude = -1) const;
+
+private:
+  double cellSize;
+  int32_t alive;
+  int32_t minX, minY, maxX, maxY;  // Bounding box of the occupied cells
+  std::vector<Point> points;
+  std::unordered_map<int64_t, std::vector<int32_t>> cells;
+
+  int32_t cellOf(double coordinate) const;
+  static int64_t key(int32_t cx, int32_t cy);
+  const std::vector<int32_t> *bucket(int32_t cx, int32_t cy) const;
+};
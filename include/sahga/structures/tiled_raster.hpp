@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sahga/utils/binary_format.hpp>
+#include <sahga/utils/mapped_file.hpp>
+#include <sahga/utils/quantize.hpp>
+#include <sahga/utils/sampling.hpp>
+#include <sahga/utils/span.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * **Tile Cache class.**
+ *
+ * Decoded raster tiles, least recently used first out once `capacity` bytes are
+ * held. One cache can be shared by any number of rasters and threads, so the
+ * memory spent on tiles stays the same however many layers are sampled. Tiles
+ * are handed out as shared pointers and remain valid after being evicted.
+ * */
+class TileCache {
+public:
+  typedef std::shared_ptr<const std::vector<double>> Tile;
+
+  explicit TileCache(size_t capacity = 64 << 20);
+
+  // The tile stored under key, calling load (outside the lock) when it is not cached.
+  Tile get(uint64_t key, const std::function<std::vector<double>()> &load);
+
+  size_t size() const;  // Bytes of the cached tiles
+  size_t capacity() const { return _capacity; }
+  uint64_t hits() const { return _hits; }
+  uint64_t misses() const { return _misses; }
+
+private:
+  mutable std::mutex _mutex;
+  size_t _capacity, _size;
+  std::atomic<uint64_t> _hits, _misses;
+  std::list<uint64_t> _order;  // Most recently used first
+  std::unordered_map<uint64_t, std::pair<Tile, std::list<uint64_t>::iterator>> _tiles;
+};
+
+/*
+ * **Tiled Raster class.**
+ *
+ * Reader of the tiled raster format (.sdr, see Utils::binary). The file is mapped and
+ * tiles are decoded on demand into a TileCache, so sampling points only reads the
+ * tiles that contain them. Cells are addressed like in Layer: row 0 is the north edge.
+ * */
+class TiledRaster {
+public:
+  std::string layerName;
+
+  // Maps fileName; tiles go to cache, or to a small cache of its own when null.
+  explicit TiledRaster(const std::string &fileName, std::shared_ptr<TileCache> cache = nullptr);
+
+  // Writes the ASCII grid asciiFile as a tiled raster, two bands of rows at a time, exactly
+  // or quantized to a narrower encoding (see RasterHeader). Both writers replace fileName
+  // only once the new raster is complete.
+  static void convert(const std::string &asciiFile, const std::string &fileName,
+                      int32_t tileSize = 256, bool compress = true,
+                      Utils::binary::Encoding quantization = Utils::binary::Encoding::FLOAT64);
+  // Writes the 2x overview of the tiled raster sourceFile: noData-aware mean of 2 x 2 cells.
+  static void overview(const std::string &sourceFile, const std::string &fileName,
+                       bool compress = true,
+                       Utils::binary::Encoding quantization = Utils::binary::Encoding::FLOAT64);
+
+  const std::string &fileName() const { return _fileName; }
+  const Utils::binary::RasterHeader &header() const { return *_header; }
+  const Utils::quantize::Codec &codec() const { return _codec; }  // Of the tiles
+  double cell(int32_t row, int32_t col) const;             // noData outside the grid
+  double getValue(double longitude, double latitude) const;  // Same lookup as Layer::getValue
+  // getValue of every point; consecutive points in the same tile share one cache lookup.
+  void getValues(Span<const double> longitude, Span<const double> latitude,
+                 Span<double> out) const;
+  // getValues visiting the points in the given order (see `order`).
+  void getValues(Span<const double> longitude, Span<const double> latitude, Span<double> out,
+                 const std::vector<int64_t> &order) const;
+  // Samples every point with the given kernel (see Utils::sampling::sample).
+  void sample(Span<const double> longitude, Span<const double> latitude, Span<double> out,
+              Utils::sampling::Mode mode, int32_t k = 3) const;
+  // Copies the window of rows x cols cells at (row, col) to out; cell (r, c) goes to
+  // out[r * rowStride + c * cellStride]. Cells outside the grid are noData.
+  void read(int32_t row, int32_t col, int32_t rows, int32_t cols, double *out, int64_t cellStride,
+            int64_t rowStride) const;
+  // Indices of the points sorted by cell: tile by tile, in row order within each tile.
+  std::vector<int64_t> order(Span<const double> longitude, Span<const double> latitude) const;
+  Utils::sampling::Grid grid() const;
+
+private:
+  std::string _fileName;
+  std::unique_ptr<MappedFile> _file;
+  const Utils::binary::RasterHeader *_header;
+  const Utils::binary::TileEntry *_entries;
+  Utils::quantize::Codec _codec;
+  std::shared_ptr<TileCache> _cache;
+  uint64_t _id;  // Distinguishes the tiles of this raster in a shared cache
+
+  std::vector<double> decode(int32_t index) const;
+  TileCache::Tile tile(int32_t index) const;
+  template <typename Index>
+  void gather(Span<const double> longitude, Span<const double> latitude, Span<double> out,
+              Index index) const;
+};
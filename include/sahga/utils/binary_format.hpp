@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Utils {
+  namespace binary {
+    // Sections of the binary formats start at multiples of 8 bytes.
+    static inline uint64_t align8(uint64_t offset) { return (offset + 7) & ~(uint64_t)7; }
+
+    //------------------------------------------------------------------------------------------
+    // Binary MPG (.mpg)
+    //
+    // MPGHeader, then (each section starting 8-byte aligned):
+    //   int32_t nodeId[nNodes]           - #id of each node
+    //   int64_t offset[nNodes + 1]       - edges of node i are edge[offset[i]..offset[i + 1])
+    //   MPGEdge edge[nEdges]             - same layout as TEdge
+    //   double  data[nNodes * nVars]     - optional node attributes, row-major
+    // The checksum covers every byte after the header.
+    //------------------------------------------------------------------------------------------
+    static inline const char MPG_MAGIC[8] = {'S', 'A', 'H', 'G', 'A', 'M', 'P', 'G'};
+    static inline const uint32_t MPG_VERSION = 1;
+
+    struct MPGHeader {
+      char magic[8];
+      uint32_t version;
+      int32_t type;       // Graph::MPGTypes
+      double radius;      // R (km) the MPG was built with
+      int32_t neighbors;  // Neighbors per node (KNN, KNNIDW)
+      int32_t nNodes;
+      int64_t nEdges;
+      int32_t nVars;  // Columns of the node attribute block (0 if absent)
+      int32_t reserved;
+      uint64_t checksum;
+    };
+
+    struct MPGEdge {
+      int32_t nodeId;
+      int32_t padding;
+      double weight;
+    };
+
+    //------------------------------------------------------------------------------------------
+    // Columnar dataset (.sds)
+    //
+    // DatasetHeader, ColumnHeader[nColumns], then one block per column starting at a
+    // 64-byte aligned offset. FLOAT64 blocks of a file share the same length, so a file
+    // whose columns are all FLOAT64 maps straight into a COLUMN_MAJOR Dataset. The
+    // checksum covers every byte after the header; tableChecksum covers the column headers
+    // alone, so a file can be opened without reading its blocks.
+    //------------------------------------------------------------------------------------------
+    static inline const char DATASET_MAGIC[8] = {'S', 'A', 'H', 'G', 'A', 'D', 'A', 'T'};
+    static inline const uint32_t DATASET_VERSION = 2;
+
+    // Storage of a column. value = stored * scale + offset for the quantized ones.
+    enum class Encoding : int32_t { FLOAT64, FLOAT32, INT16, UINT16 };
+
+    static inline uint64_t align64(uint64_t offset) { return (offset + 63) & ~(uint64_t)63; }
+
+    struct DatasetHeader {
+      char magic[8];
+      uint32_t version;
+      int32_t nColumns;
+      int64_t nRows;
+      uint64_t checksum;
+      uint64_t tableChecksum;
+    };
+
+    struct ColumnHeader {
+      char name[48];  // Null terminated, truncated if longer
+      Encoding encoding;
+      int32_t reserved;
+      double scale, offset;
+      double avg, stdDev, sum, sum2;  // Stats of the decoded values
+      uint64_t dataOffset;            // From the start of the file
+      uint64_t dataSize;              // Bytes of the block, without padding
+    };
+
+    //------------------------------------------------------------------------------------------
+    // Tiled raster (.sdr)
+    //
+    // RasterHeader, TileEntry[tilesX * tilesY] (row of tiles by row of tiles, north
+    // first), then one 8-byte aligned block per tile. A block holds the tileSize x
+    // tileSize cells of its tile, row-major, as codes of the raster's encoding, scale and
+    // offset (see Utils::quantize); cells past the edge of the grid are noData. An RLE
+    // block is a sequence of (uint32_t count, code) runs instead. The checksum covers the
+    // header before it and the tile table; blocks are not checksummed, so opening a raster
+    // touches only those.
+    //------------------------------------------------------------------------------------------
+    static inline const char RASTER_MAGIC[8] = {'S', 'A', 'H', 'G', 'A', 'T', 'I', 'L'};
+    static inline const uint32_t RASTER_VERSION = 3;
+
+    enum class Compression : int32_t { NONE, RLE };
+
+    struct RasterHeader {
+      char magic[8];
+      uint32_t version;
+      Encoding encoding;      // Of the codes
+      Encoding quantization;  // Asked for when written; FLOAT64 keeps every cell exact
+      int32_t rows, cols;
+      int32_t tileSize, tilesX, tilesY;
+      double xCorner, yCorner, cellSize, noData;
+      double scale, offset;          // value = code * scale + offset; noData has its own code
+      double min, max, avg, stdDev;  // Over the cells that are not noData
+      double maxError, rmsError;     // Of the codes against the cells written, 0 when exact
+      uint64_t checksum;
+    };
+
+    struct TileEntry {
+      uint64_t offset;  // From the start of the file
+      uint32_t size;    // Bytes of the block, without padding
+      Compression compression;
+    };
+
+    //------------------------------------------------------------------------------------------
+    // Layer stack (.sdc)
+    //
+    // StackHeader, BandHeader[nBands], then from a 64-byte aligned offset the cube
+    //   record cell[rows][cols]
+    // where a record holds the value of every band at one cell, each band in its own
+    // encoding at its `position` in the record, so the values of a cell are contiguous.
+    // Row 0 is the north edge. The checksum covers the header before it and the band
+    // headers; the cube is not checksummed, so opening a stack touches only those.
+    //------------------------------------------------------------------------------------------
+    static inline const char STACK_MAGIC[8] = {'S', 'A', 'H', 'G', 'A', 'S', 'T', 'K'};
+    static inline const uint32_t STACK_VERSION = 2;
+
+    struct StackHeader {
+      char magic[8];
+      uint32_t version;
+      int32_t nBands;
+      int32_t rows, cols;
+      double xCorner, yCorner, cellSize;
+      uint64_t dataOffset;  // Start of the cube, from the start of the file
+      uint64_t recordSize;  // Bytes of the record of one cell
+      uint64_t checksum;
+    };
+
+    struct BandHeader {
+      char name[48];  // Null terminated, truncated if longer
+      Encoding encoding;
+      int32_t position;      // Byte of the band in a record
+      double scale, offset;  // value = stored * scale + offset; noData has a code of its own
+      double noData;
+      double min, max, avg, stdDev;
+    };
+  }  // namespace binary
+}  // namespace Utils
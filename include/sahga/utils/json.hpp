@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cmath>
+#include <map>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace Utils {
+  namespace json {
+    /*
+     * Members of a flat JSON object, e.g. {"op": "fit", "radius": 5}. String values are
+     * unescaped; numbers, true, false and null are kept as written. Nested objects and
+     * arrays are not supported. Throws std::runtime_error on malformed input.
+     * */
+    std::map<std::string, std::string> parseObject(std::string_view text);
+
+    std::string quote(std::string_view text);  // text as a JSON string literal
+
+    /*
+     * **Object class.**
+     *
+     * Writes a flat JSON object on one line, members in the order they are added.
+     * Numbers that are not finite are written as null.
+     * */
+    class Object {
+    public:
+      Object &add(const std::string &key, std::string_view value);
+      Object &add(const std::string &key, const char *value) {
+        return add(key, std::string_view(value));
+      }
+      template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+      Object &add(const std::string &key, T value) {
+        if constexpr (std::is_same_v<T, bool>) return raw(key, value ? "true" : "false");
+        if constexpr (std::is_floating_point_v<T>)
+          if (!std::isfinite(value)) return raw(key, "null");
+        return raw(key, number((double)value));
+      }
+      Object &add(const std::string &key, const std::vector<double> &values);
+      Object &raw(const std::string &key, std::string_view json);  // json written as is
+
+      std::string str() const { return "{" + _members + "}"; }
+
+    private:
+      std::string _members;
+
+      static std::string number(double value);  // Shortest text that reads back exactly
+    };
+  }  // namespace json
+}  // namespace Utils
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/*
+ * **Mapped File class.**
+ *
+ * Memory map of a whole file. The mapping lives as long as the object, so anything
+ * pointing into `data()` must not outlive it. A private mapping can be written to:
+ * touched pages are copied on write and the file itself never changes.
+ * */
+class MappedFile {
+public:
+  explicit MappedFile(const std::string &fileName,
+                      bool copyOnWrite = false);  // Maps fileName, throws if it can't
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *data() const { return _data; }
+  char *privateData() const { return _copyOnWrite ? _data : nullptr; }  // Writable view
+  size_t size() const { return _size; }
+
+private:
+  char *_data;
+  size_t _size;
+  bool _copyOnWrite;
+};
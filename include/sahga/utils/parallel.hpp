@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Utils {
+  namespace parallel {
+    // Number of worker threads to use (hardware concurrency, at least 1).
+    int32_t threads();
+
+    // Number of chunks forChunks splits `size` items into: at most one per thread and
+    // at least `grain` items each.
+    int32_t chunkCount(int64_t size, int64_t grain);
+
+    /*
+     * **Executor class.**
+     *
+     * Work-stealing thread pool. Every worker has a queue of its own: tasks submitted from
+     * a worker go to its queue and it takes the newest first, while idle workers steal the
+     * oldest tasks of the others. Threads waiting on a TaskGroup run the pending tasks of
+     * that group in the meantime, so tasks may wait on tasks of their own without
+     * exhausting the pool.
+     * */
+    class Executor {
+    public:
+      explicit Executor(int32_t workers = threads());
+      ~Executor();
+
+      static Executor &global();  // Shared by forChunks, TaskGroup and TaskGraph by default
+
+      void submit(std::function<void()> task);
+      int32_t workers() const { return (int32_t)_threads.size(); }
+
+    private:
+      struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+      };
+
+      std::vector<std::unique_ptr<Queue>> _queues;
+      std::vector<std::thread> _threads;
+      std::mutex _mutex;
+      std::condition_variable _wake;
+      std::atomic<int64_t> _pending;
+      std::atomic<uint32_t> _next;
+      bool _stopping;
+
+      bool pop(int32_t self, std::function<void()> &task);
+      void work(int32_t self);
+    };
+
+    /*
+     * **Task Group class.**
+     *
+     * Tasks run on an executor and waited for together. `wait` rethrows the first
+     * exception raised by any of them. The tasks are queued in the group, and the executor
+     * is handed one runner per task: whichever gets to a task first, a worker or the thread
+     * in `wait`, runs it. A waiting thread thus only ever runs tasks of its own group, never
+     * unrelated work that could need a lock it holds or inflate its timings.
+     * */
+    class TaskGroup {
+    public:
+      explicit TaskGroup(Executor &executor = Executor::global());
+      ~TaskGroup();
+
+      void run(std::function<void()> task);
+      void wait();
+
+    private:
+      // Shared with the runners, which may outlive the group once its tasks are done
+      struct State {
+        std::mutex mutex;
+        std::condition_variable done;
+        std::deque<std::function<void()>> tasks;  // Not started yet
+        int64_t count = 0;                        // Not finished yet
+        std::exception_ptr error;
+
+        bool runOne();  // Runs the oldest queued task; false if there was none
+      };
+
+      Executor &_executor;
+      std::shared_ptr<State> _state;
+    };
+
+    /*
+     * **Task Graph class.**
+     *
+     * Named tasks and the tasks each one depends on. `run` starts every task as soon as
+     * its dependencies are done, so independent tasks overlap, and times them; `report`
+     * lists the timings and the critical path, the chain of dependent tasks that bounds
+     * the total time.
+     * */
+    class TaskGraph {
+    public:
+      // Told of every task as it starts, and as it ends "done", "failed" or "skipped",
+      // with the seconds since the graph started. Called from the threads running the tasks.
+      typedef std::function<void(const std::string &task, const std::string &event,
+                                 double seconds)>
+          Listener;
+
+      // Adds a task after its dependencies (ids returned by earlier `add` calls).
+      int32_t add(const std::string &name, std::function<void()> task,
+                  const std::vector<int32_t> &dependencies = {});
+
+      // Runs every task, then rethrows the first failure; tasks depending on a failed task
+      // are skipped.
+      void run(Executor &executor = Executor::global());
+
+      void listen(Listener listener) { _listener = std::move(listener); }
+
+      std::vector<int32_t> criticalPath() const;
+      std::string report() const;
+
+    private:
+      struct Task {
+        std::string name;
+        std::function<void()> run;
+        std::vector<int32_t> dependencies, dependents;
+        double start, end;  // Seconds since the graph started
+        bool ran, failed;
+      };
+
+      std::vector<Task> _tasks;
+      double _elapsed = 0;
+      Listener _listener;
+    };
+
+    /*
+     * Splits [begin, end) into chunkCount(end - begin, grain) contiguous chunks and
+     * calls fn(chunk, chunkBegin, chunkEnd) for each of them in parallel on the global
+     * executor, the first one on the calling thread. Returns once every chunk is done,
+     * rethrowing the first exception raised by any of them.
+     * */
+    template <typename Function>
+    void forChunks(int64_t begin, int64_t end, int64_t grain, Function fn) {
+      const int64_t size = end - begin;
+      const int32_t chunks = chunkCount(size, grain);
+
+      if (chunks <= 1) {
+        if (size > 0) fn(0, begin, end);
+        return;
+      }
+
+      std::vector<std::exception_ptr> errors(chunks);
+      auto run = [&](int32_t chunk) {
+        try {
+          fn(chunk, begin + size * chunk / chunks, begin + size * (chunk + 1) / chunks);
+        } catch (...) {
+          errors[chunk] = std::current_exception();
+        }
+      };
+
+      TaskGroup group;
+      for (int32_t chunk = 1; chunk < chunks; ++chunk) group.run([&run, chunk]() { run(chunk); });
+      run(0);
+      group.wait();
+
+      for (std::exception_ptr &error : errors)
+        if (error) std::rethrow_exception(error);
+    }
+  }  // namespace parallel
+}  // namespace Utils
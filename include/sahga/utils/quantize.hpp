@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <sahga/utils/binary_format.hpp>
+
+namespace Utils {
+  namespace quantize {
+    using Utils::binary::Encoding;
+
+    /*
+     * How values are stored: value = code * scale + offset. With `hasNoData`, noData is
+     * kept exactly as a sentinel code (INT16: -32768, UINT16: 65535, floats: noData
+     * itself) that no other value maps to.
+     * */
+    struct Codec {
+      Encoding encoding;
+      double scale, offset;
+      double noData;
+      bool hasNoData;
+    };
+
+    // Quantization error over the values that are not noData.
+    struct Error {
+      double max, rms;
+      int64_t count;  // Values measured
+    };
+
+    Error merge(const Error &a, const Error &b);
+
+    size_t width(Encoding encoding);  // Bytes per stored value
+    const char *name(Encoding encoding);
+
+    /*
+     * Codec covering [min, max] (the values that are not noData). Integral ranges that fit
+     * the integer encodings are stored exactly, with scale 1; otherwise the range is spread
+     * over every code but the sentinel.
+     * */
+    Codec fit(Encoding encoding, double min, double max, bool integral = false);
+    Codec fit(Encoding encoding, double min, double max, double noData, bool integral = false);
+
+    // Branch-free loops over contiguous values, so the compiler can vectorize them.
+    void encode(const Codec &codec, const double *values, int64_t size, void *codes);
+    void decode(const Codec &codec, const void *codes, int64_t size, double *values);
+    // decode of codes `codeStride` bytes apart into values `valueStride` values apart, e.g.
+    // one band out of interleaved records.
+    void decode(const Codec &codec, const void *codes, int64_t size, int64_t codeStride,
+                double *values, int64_t valueStride);
+
+    Error error(const Codec &codec, const double *values, int64_t size);
+  }  // namespace quantize
+}  // namespace Utils
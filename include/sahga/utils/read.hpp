@@ -2,6 +2,7 @@
 
 #include <sahga/structures/dataset.hpp>
 #include <sahga/structures/graph.hpp>
+#include <sahga/utils/binary_format.hpp>
 #include <string>
 #include <vector>
 
@@ -21,6 +22,33 @@ public:
   int ReadData(std::vector<std::string> &List, const std::string &FileName);
 };
 
+// Binary MPG (.mpg, see Utils::binary). The separator arguments are ignored.
+class BinaryMPGFile : public Strat_Read {
+public:
+  int ReadData(Graph &G, Dataset &M, const std::string &FileName, const char &separator);
+  int ReadData(Dataset &M, const std::string &FileName, const char &separator);
+  int ReadData(std::vector<std::string> &List, const std::string &FileName);
+
+  // Header of the MPG in FileName (its criterion, radius and neighbors), once checked.
+  static Utils::binary::MPGHeader header(const std::string &FileName);
+};
+
+// Columnar binary dataset (.sds, see Utils::binary). Datasets stored as FLOAT64 are
+// memory-mapped as COLUMN_MAJOR views; quantized ones are decoded. Separators are ignored.
+// Only the column headers are checked against their checksum, unless `verify` asks for the
+// whole file to be (which reads all of it).
+class ColumnarFile : public Strat_Read {
+public:
+  explicit ColumnarFile(bool verify = false) : verify(verify) {}
+
+  int ReadData(Graph &G, Dataset &M, const std::string &FileName, const char &separator);
+  int ReadData(Dataset &M, const std::string &FileName, const char &separator);
+  int ReadData(std::vector<std::string> &List, const std::string &FileName);
+
+private:
+  bool verify;
+};
+
 class ReadFile {
 public:
   static int Read(Graph &G, Dataset &M, const std::string &FileName, const char &separator);
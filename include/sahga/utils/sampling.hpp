@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <sahga/utils/span.hpp>
+
+namespace Utils {
+  namespace sampling {
+    enum class Mode : int32_t {
+      NEAREST,     // Value of the cell holding the point
+      BILINEAR,    // Interpolated between the centers of the 4 closest cells
+      FOCAL_MEAN,  // Mean of the k x k cells centered on the cell holding the point
+    };
+
+    /*
+     * Georeferencing of a grid, as read from an ESRI ASCII header: row 0 is the north
+     * edge and (xCorner, yCorner) the south-west corner. This is the one place that
+     * turns coordinates into cells, for Layer, TiledRaster and LayerStack alike.
+     * */
+    struct Grid {
+      int32_t rows, cols;
+      double xCorner, yCorner, cellSize;
+      double noData;
+
+      // Column and row holding (longitude, latitude), whether or not they are in the grid.
+      int32_t column(double longitude) const {
+        return (int32_t)(fabs(longitude - xCorner) / cellSize);
+      }
+      int32_t row(double latitude) const {
+        return (int32_t)(rows - (fabs(latitude - yCorner) / cellSize));
+      }
+
+      // Cell holding (longitude, latitude); false when the point is outside the grid.
+      bool locate(double longitude, double latitude, int32_t &row, int32_t &col) const {
+        if (!contains(longitude, latitude)) return false;
+
+        col = column(longitude);
+        row = this->row(latitude);
+        return (row < rows);
+      }
+
+      bool contains(double longitude, double latitude) const {
+        return (longitude >= xCorner) && (longitude <= xCorner + (cols - 1) * cellSize)
+               && (latitude >= yCorner) && (latitude <= yCorner + (rows - 1) * cellSize);
+      }
+    };
+
+    /*
+     * Samples the grid at every point, writing noData for points outside the grid. Cells
+     * holding noData are left out and the weights of the others renormalized, so a point
+     * is noData only when every cell it draws on is.
+     *
+     * Points go in blocks: their fractional grid positions are computed over contiguous
+     * arrays first, then the cells are gathered through `cell`, then weighed, so the
+     * arithmetic runs in loops the compiler can vectorize.
+     *
+     * @param { Grid } grid - Georeferencing of the cells.
+     * @param { Cell } cell - cell(row, col), called only for cells inside the grid.
+     * @param { Mode } mode - Sampling kernel.
+     * @param { int32_t } k - Side of the FOCAL_MEAN window (odd; even sides are rounded up).
+     * */
+    template <typename Cell>
+    void sample(const Grid &grid, const Cell &cell, Mode mode, int32_t k,
+                Span<const double> longitude, Span<const double> latitude, Span<double> out) {
+      const int64_t BLOCK = 256;
+      const double noData = grid.noData;
+      const int32_t half = std::max(k, 1) / 2;
+
+      double x[BLOCK], y[BLOCK], values[4][BLOCK];
+      bool inside[BLOCK];
+
+      // noData outside the grid, so gathered windows can run over its edges
+      auto at = [&](int32_t row, int32_t col) {
+        return ((row < 0) || (row >= grid.rows) || (col < 0) || (col >= grid.cols))
+                   ? noData
+                   : (double)cell(row, col);
+      };
+
+      for (int64_t start = 0; start < out.size(); start += BLOCK) {
+        const int64_t n = std::min(BLOCK, out.size() - start);
+
+        for (int64_t i = 0; i < n; ++i) {
+          const double lon = longitude[start + i], lat = latitude[start + i];
+          inside[i] = grid.contains(lon, lat);
+          x[i] = fabs(lon - grid.xCorner) / grid.cellSize;
+          y[i] = grid.rows - fabs(lat - grid.yCorner) / grid.cellSize;
+        }
+
+        switch (mode) {
+          case Mode::NEAREST:
+            for (int64_t i = 0; i < n; ++i)
+              out[start + i] = inside[i] ? at((int32_t)y[i], (int32_t)x[i]) : noData;
+            break;
+
+          case Mode::BILINEAR: {
+            // Cell centers sit at half-integer positions
+            int32_t row0[BLOCK], col0[BLOCK];
+            for (int64_t i = 0; i < n; ++i) {
+              x[i] -= 0.5;
+              y[i] -= 0.5;
+              col0[i] = (int32_t)std::floor(x[i]);
+              row0[i] = (int32_t)std::floor(y[i]);
+              x[i] -= col0[i];
+              y[i] -= row0[i];
+            }
+
+            for (int64_t i = 0; i < n; ++i) {
+              values[0][i] = at(row0[i], col0[i]);
+              values[1][i] = at(row0[i], col0[i] + 1);
+              values[2][i] = at(row0[i] + 1, col0[i]);
+              values[3][i] = at(row0[i] + 1, col0[i] + 1);
+            }
+
+            for (int64_t i = 0; i < n; ++i) {
+              const double weights[4] = {(1 - x[i]) * (1 - y[i]), x[i] * (1 - y[i]),
+                                         (1 - x[i]) * y[i], x[i] * y[i]};
+              double sum = 0, weight = 0;
+              for (int32_t j = 0; j < 4; ++j) {
+                const bool valid = (values[j][i] != noData);
+                sum += valid ? weights[j] * values[j][i] : 0;
+                weight += valid ? weights[j] : 0;
+              }
+              out[start + i] = (inside[i] && (weight > 0)) ? sum / weight : noData;
+            }
+            break;
+          }
+
+          case Mode::FOCAL_MEAN:
+            for (int64_t i = 0; i < n; ++i) {
+              if (!inside[i]) {
+                out[start + i] = noData;
+                continue;
+              }
+
+              const int32_t row = (int32_t)y[i], col = (int32_t)x[i];
+              double sum = 0;
+              int32_t count = 0;
+              for (int32_t r = row - half; r <= row + half; ++r)
+                for (int32_t c = col - half; c <= col + half; ++c) {
+                  const double value = at(r, c);
+                  sum += (value != noData) ? value : 0;
+                  count += (value != noData);
+                }
+              out[start + i] = (count > 0) ? sum / count : noData;
+            }
+            break;
+        }
+      }
+    }
+
+    /*
+     * k x k focal mean of a whole row-major grid: out[r][c] is the mean of the cells of
+     * the window centered on (r, c) that are not noData, or noData when none is. Uses
+     * summed-area tables of the values and of the valid cells, so every window costs the
+     * same whatever k is. out may be values itself.
+     * */
+    void focalMean(const Grid &grid, const double *values, int32_t k, double *out);
+  }  // namespace sampling
+}  // namespace Utils
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * Non-owning view of `size` values spaced `stride` elements apart. A row of a
+ * row-major Dataset (or a column of a column-major one) has stride 1.
+ * */
+template <typename T> class Span {
+public:
+  Span() : _data(nullptr), _size(0), _stride(1) {}
+  Span(T *data, int64_t size, int64_t stride = 1) : _data(data), _size(size), _stride(stride) {}
+  // Span<double> --> Span<const double>
+  template <typename U>
+  Span(const Span<U> &other) : _data(other.data()), _size(other.size()), _stride(other.stride()) {}
+
+  T &operator[](int64_t i) const { return _data[i * _stride]; }
+
+  T *data() const { return _data; }
+  int64_t size() const { return _size; }
+  int64_t stride() const { return _stride; }
+  bool contiguous() const { return _stride == 1; }
+
+private:
+  T *_data;
+  int64_t _size;
+  int64_t _stride;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Utils {
+  namespace statistics {
+    /*
+     * Count, mean and sum of squared deviations (m2) of a set of values. Moments of
+     * disjoint sets merge exactly (Chan et al.), so blocks, chunks and threads can be
+     * reduced in any order without the cancellation of the sum/sum² formula.
+     * */
+    struct Moments {
+      double n, mean, m2;
+
+      double sum() const { return n * mean; }
+      double sum2() const { return m2 + n * mean * mean; }
+      double variance() const { return (n > 1) ? m2 / (n - 1) : 0; }  // Sample variance
+    };
+
+    Moments merge(const Moments &a, const Moments &b);
+
+    // Moments of `size` contiguous values.
+    Moments moments(const double *values, int64_t size);
+    // Moments of `size` contiguous values, ignoring the ones equal to noData.
+    Moments moments(const double *values, int64_t size, double noData);
+
+    /*
+     * Per column moments of a row-major block of values. Rows are consumed in blocks
+     * whose columns are reduced side by side, so the inner loops run across columns
+     * (one SIMD lane per column) instead of down a single column.
+     * */
+    class ColumnMoments {
+    public:
+      explicit ColumnMoments(int32_t columns = 0);
+
+      // Adds `rows` rows of `columns()` values, consecutive rows `stride` values apart.
+      void add(const double *first, int64_t rows, int64_t stride);
+      void merge(const ColumnMoments &other);
+
+      int32_t columns() const { return (int32_t)_moments.size(); }
+      const Moments &operator[](int32_t j) const { return _moments[j]; }
+
+    private:
+      std::vector<Moments> _moments;
+      std::vector<double> _mean, _m2;  // Scratch space of the current block
+    };
+  }  // namespace statistics
+}  // namespace Utils
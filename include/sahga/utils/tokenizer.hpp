@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Utils {
+  namespace parsing {
+    /*
+     * Splits text into lines (without '\n' or a trailing '\r'), in order. Large texts
+     * are cut into one chunk per thread; each chunk then starts at the first line
+     * beginning inside it, so no line is split or repeated.
+     * */
+    std::vector<std::string_view> lines(std::string_view text);
+
+    /*
+     * Parses a number with std::from_chars, accepting a leading '+', surrounding
+     * blanks and a decimal comma ("-58,287185"). Returns false if the token does not
+     * start with a number.
+     * */
+    bool parseNumber(std::string_view token, double &value);
+
+    // parseNumber returning 0 for tokens that are not numbers, like atof.
+    double number(std::string_view token);
+
+    /*
+     * **Tokenizer class.**
+     *
+     * Walks the fields of a line without copying them. With ' ' or '\t' as separator
+     * any run of blanks separates two fields; any other separator delimits exactly one
+     * field, so "a;;b" has an empty field. A trailing separator does not start a field.
+     * */
+    class Tokenizer {
+    public:
+      Tokenizer(std::string_view line, char separator);
+
+      bool next(std::string_view &token);  // Next field; false when there are none left
+      bool next(double &value);            // Next field as a number (see `number`)
+      bool skip(int32_t fields = 1);       // Skips fields; false if the line ended first
+
+    private:
+      std::string_view _rest;
+      char _separator;
+      bool _blank;  // Separator is a blank: runs collapse
+      bool _done;
+    };
+  }  // namespace parsing
+}  // namespace Utils
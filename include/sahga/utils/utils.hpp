@@ -1,12 +1,15 @@
 #pragma once
 
+#include <functional>
 #include <sahga/core/core.hpp>
 
 namespace Utils {
   namespace constants {
     static inline const double PI = 3.1415926535897932;
     static inline const double RADIUS = 6378.160;  // TODO: check with Adair
-  }                                                // namespace constants
+    // Length of one degree along a great circle, the scale used by `distance`.
+    static inline const double KM_PER_DEGREE = PI * RADIUS / 180;
+  }  // namespace constants
 
   namespace miscellaneous {
     std::vector<std::string> split(std::string str, char delimiter);
@@ -16,6 +19,9 @@ namespace Utils {
 
     // Converts a full string to upper case.
     std::string upperCase(std::string str);
+
+    // 64-bit FNV-1a style hash of size bytes, used as checksum of the binary formats.
+    uint64_t hash(const void *data, size_t size, uint64_t seed = 14695981039346656037ULL);
   }  // namespace miscellaneous
 
   namespace filemanagement {
@@ -23,9 +29,15 @@ namespace Utils {
     std::string getRootDirectory(const std::string &projectName);
 
     // Converts, removes and then returns the first number occurrence in the
-    // string line.
+    // string line. Each call shifts the rest of the line; readers should walk
+    // their lines with Utils::parsing::Tokenizer instead.
     double getNumber(std::string &line, char separator);
 
     std::string splitOnce(std::string &line, char separator);
+
+    // Calls write(temporary) to write a file next to fileName, then renames it over
+    // fileName, so fileName is either absent, the old file or the whole new one.
+    void writeAtomically(const std::string &fileName,
+                         const std::function<void(const std::string &temporary)> &write);
   }  // namespace filemanagement
 }  // namespace Utils
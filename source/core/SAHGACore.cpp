@@ -1,4 +1,10 @@
 #include <sahga/core/core.hpp>
+#include <sahga/core/cross_validation.hpp>
+#include <sahga/core/daemon.hpp>
+#include <sahga/core/job_runner.hpp>
+#include <sahga/core/pipeline.hpp>
+#include <sahga/utils/parallel.hpp>
+#include <sahga/utils/read.hpp>
 
 static std::string getServerPathTo(const std::string& file) {
   const std::string cd = Utils::filemanagement::getRootDirectory("sahga-api-xmake");
@@ -10,32 +16,77 @@ static std::string getUserPathTo(int32_t userId, const std::string& file) {
   return fmt::format("{}/assets/user-info/{:04}/{}", cd, userId, file);
 }
 
+// Folder the file based stages read from and write to.
+static std::string getStagePath() { return getUserPathTo(1, ""); }
+
+// Rasters, overviews and stacks converted from the layers live apart from the layers.
+static std::string getDerivedPath() { return getServerPathTo("derived"); }
+
+static std::shared_ptr<LayerCache> getLayerCache() {
+  return std::make_shared<LayerCache>(64 << 20, getDerivedPath());
+}
+
+// Predicts with the neighborhood of the MPG mergeData left in the folder of pipeline.
+static Pipeline* useFittedNeighborhood(Pipeline& pipeline) {
+  const Utils::binary::MPGHeader header = BinaryMPGFile::header(pipeline.pathTo("mergedData.mpg"));
+  return pipeline.setNeighborhood(header.radius, (Graph::MPGTypes)header.type, header.neighbors);
+}
+
 SAHGACore::SAHGACore() : _random(std::make_unique<Random>(.0, 1.)) {
   const std::string speciesPoints = getServerPathTo("PtsFurcata.txt");
   const std::string geographicalLayers = getServerPathTo("layers");
 
   const int32_t userId = 1;
 
-  const std::string generalProximationMatrix = getUserPathTo(userId, "gpm.txt");
-  const std::string geographicalVariables = getUserPathTo(userId, "layersData.txt");
-
-  const std::string mergedMatrix = getUserPathTo(userId, "mergedData.txt");
-
+  const auto mpgType = Graph::MPGTypes::HALFRADIUM;
+  const double radius = 5;
   const auto modelType = GASA::ModelType::QUADRATIC;
   const auto objectiveType = GASA::ObjectiveType::MINBOTH;
 
+  // Debug: also write train.txt, gpm.mpg, layersData.sds, ... to the user folder
+  const bool keepIntermediates = false;
+
+  // generateMPG and extractLayers only need the train split, so they run side by side
+  Pipeline pipeline(getUserPathTo(userId, ""));
+  pipeline.keepIntermediates(keepIntermediates)
+      ->useCache(getUserPathTo(userId, "cache"))
+      ->shareLayers(getLayerCache())
+      ->onRestore(
+          [](const std::string& stage) { fmt::print("{}: loaded from the cache\n", stage); });
+
+  Utils::parallel::TaskGraph stages;
+  const int32_t split
+      = stages.add("separateTrainTest", [&]() { pipeline.separateTrainTest(speciesPoints); });
+  const int32_t mpg
+      = stages.add("generateMPG", [&]() { pipeline.generateMPG(radius, mpgType); }, {split});
+  const int32_t layers = stages.add(
+      "extractLayers", [&]() { pipeline.extractLayers(geographicalLayers); }, {split});
+  const int32_t merge = stages.add("mergeData", [&]() { pipeline.mergeData(); }, {mpg, layers});
+  const int32_t fit = stages.add(
+      "adjustModel", [&]() { pipeline.adjustModel(modelType, objectiveType); }, {merge});
+  stages.add(
+      "predict",
+      [&]() {
+        pipeline.predict(geographicalLayers, getUserPathTo(userId, "suitability.asc"));
+      },
+      {fit});
+  stages.add("evaluate", [&]() { pipeline.evaluate(geographicalLayers); }, {fit});
+
   try {
-    separateTrainTest(speciesPoints)
-        ->generateMPG()
-        ->extractLayers(geographicalLayers)
-        ->mergeData(generalProximationMatrix, geographicalVariables)
-        ->adjustModel((int32_t)modelType, (int32_t)objectiveType, mergedMatrix);
+    stages.run();
   } catch (const std::exception& e) {
     fmt::print("Error\n");
     fmt::print("{}\n", e.what());
   }
+
+  fmt::print("{}", stages.report());
 }
 
+//----------------------------------------------------------------------------------------------
+// File based stages: each one reads the files the previous stage wrote to the user folder,
+// runs the Pipeline stage and writes what it produced, so they can be run one at a time.
+//----------------------------------------------------------------------------------------------
+
 /*
  * Separate original dataset in Train and Test instances.
  *
@@ -49,230 +100,194 @@ SAHGACore::SAHGACore() : _random(std::make_unique<Random>(.0, 1.)) {
  * @return
  * */
 SAHGACore* SAHGACore::separateTrainTest(const std::string& filepath, double ratio, bool stratify) {
-  const std::string cd = Utils::filemanagement::getRootDirectory("sahga-api-xmake");
-  std::string trainFilename = fmt::format("{}/assets/user-info/0001/train.txt", cd);
-  std::string testFilename = fmt::format("{}/assets/user-info/0001/test.txt", cd);
-
-  std::vector<std::string> dataPoints;
-
-  // Create all the path needed to store the train and test files
-  std::filesystem::create_directories(fmt::format("{}/assets/user-info/0001", cd));
-
-  std::filesystem::exists(trainFilename) ? std::filesystem::remove(trainFilename) : 0;
-  std::filesystem::exists(testFilename) ? std::filesystem::remove(testFilename) : 0;
-
-  // Read the file that contains the presence/absence of the species and store
-  // the data in the vector *dataPoints*
-  ReadFile::Read(dataPoints, filepath);
-
-  // Extract the header and then remove it from the vector
-  std::string header = dataPoints.front();
-  dataPoints.erase(dataPoints.begin());
-
-  auto engine = std::default_random_engine{};
-  std::vector<std::string> shuffledData(dataPoints);
-  std::shuffle(shuffledData.begin(), shuffledData.end(), engine);
-
-  int32_t trainSize = static_cast<int32_t>(shuffledData.size() * (ratio / 100));
-
-  // Write ratio percent of the data to the train file and the remaining to the
-  // test file.
-  std::ofstream os;
-  os.open(trainFilename);
-  os << header << std::endl;
-  for (uint32_t i = 0; i < trainSize; ++i) {
-    std::string line = shuffledData[i];
-    line.erase(0, line.find('\t'));
-
-    os << (i + 1) << line << "\n";
-  }
-  os.close();
-
-  os.open(testFilename);
-  os << header << std::endl;
-  for (uint32_t i = trainSize; i < shuffledData.size(); ++i) {
-    std::string line = shuffledData[i];
-    line.erase(0, line.find('\t'));
-
-    os << (i + 1 - trainSize) << line << "\n";
-  }
-  os.close();
-
+  Pipeline(getStagePath()).keepIntermediates()->separateTrainTest(filepath, ratio, stratify);
   return this;
 }
 
 SAHGACore* SAHGACore::generateMPG() {
-  const std::string filename
-      = fmt::format("{}/assets/user-info/0001/train.txt",
-                    Utils::filemanagement::getRootDirectory("sahga-api-xmake"));
-  const std::string output
-      = fmt::format("{}/assets/user-info/0001/gpm.txt",
-                    Utils::filemanagement::getRootDirectory("sahga-api-xmake"));
-
-  auto dataset = std::make_unique<Dataset>();
-  ReadFile::Read(*dataset, filename, '\t');
-
   // TODO: This need to be a input to the program
   const Graph::MPGTypes mpgType = Graph::MPGTypes::HALFRADIUM;
   const double radius = 5;
 
-  std::make_unique<Graph>()
-      ->createMPG(*dataset, radius, (int32_t)mpgType)
-      ->save(filename, radius, output);
+  Pipeline pipeline(getStagePath());
+  ReadFile::Read(pipeline.train, pipeline.pathTo("train.txt"), '\t');
+  pipeline.keepIntermediates()->generateMPG(radius, mpgType);
 
   return this;
 }
 
-SAHGACore* SAHGACore::extractLayers(const std::string& folderName) {
-  const std::string presenceAusenceFilename
-      = fmt::format("{}/assets/user-info/0001/train.txt",
-                    Utils::filemanagement::getRootDirectory("sahga-api-xmake"));
-  const std::string output
-      = fmt::format("{}/assets/user-info/0001/layersData.txt",
-                    Utils::filemanagement::getRootDirectory("sahga-api-xmake"));
-
-  auto dataset = std::make_unique<Dataset>();
-  ReadFile::Read(*dataset, presenceAusenceFilename, '\t');
-
-  // for every file in the folder (folderName)
-  std::vector<Layer*> layers;
-
-  std::for_each(std::filesystem::directory_iterator(folderName),
-                std::filesystem::directory_iterator(),
-                [&layers](const std::filesystem::directory_entry& entry) {
-                  layers.emplace_back((new Layer())->load(entry.path().string()));
-                });
-
-  auto layersData = std::make_unique<Dataset>();
-  layersData->reset(dataset->rowN, layers.size());
-
-  for (int32_t i = 0; i < dataset->rowN; ++i)
-    for (int32_t j = 0; j < layers.size(); ++j)
-      layersData->M[i][j] = layers[j]->getValue(dataset->M[i][1], dataset->M[i][2]);
-
-  std::ofstream outputStream(output.c_str());
-  outputStream << setiosflags(std::ios::fixed);
-  outputStream << "//Dados extraidos do conjunto de layers: " << presenceAusenceFilename << '\n';
-  outputStream << "//Formato dos dados --> #id;long;lat;x0;x1;x2;...;xn" << '\n';
-
-  for (int32_t i = 0; i < dataset->rowN; ++i) {
-    outputStream << std::setprecision(0) << dataset->M[i][0] << ';';  //#id
-    outputStream << std::setprecision(6) << dataset->M[i][1] << ';';  // long
-    outputStream << dataset->M[i][2] << ';';                          // lat
-    outputStream << std::setprecision(0) << dataset->M[i][3]
-                 << ';';  // 0 para ausência e 1 para presença
-    outputStream << std::setprecision(3);
-    for (int32_t j = 0; j < layers.size(); ++j) outputStream << layersData->M[i][j] << ';';
-    outputStream << '\n';
+/*
+ * Builds the overviews of the layers in folderName up to level (2x, 4x, ... 2^level x),
+ * skipping those already up to date, and reports how the last level is stored.
+ *
+ * @param { std::string } **folderName** - Folder of the layers.
+ * @param { int32_t } **levels** - Number of overview levels.
+ * @param { Encoding } **quantization** - INT16, UINT16 or FLOAT32 to quantize the layers
+ * to; FLOAT64 keeps them exact.
+ *
+ * @return
+ * */
+SAHGACore* SAHGACore::buildOverviews(const std::string& folderName, int32_t levels,
+                                     Utils::binary::Encoding quantization) {
+  const auto layers = Pipeline::buildOverviews(folderName, levels, getDerivedPath(), quantization);
+
+  for (const auto& raster : layers->rasters) {
+    const Utils::binary::RasterHeader& header = raster->header();
+    fmt::print("Layer {}: {} (scale {:g}, offset {:g}), max error {:g}, rms {:g}\n",
+               raster->layerName, Utils::quantize::name(header.encoding), header.scale,
+               header.offset, header.maxError, header.rmsError);
   }
 
-  outputStream.close();
   return this;
 }
 
-SAHGACore* SAHGACore::mergeData(const std::string& mpgFilename, const std::string& layersFilename) {
-  std::vector<std::string> mpgData, layersData;
-
-  ReadFile::Read(mpgData, mpgFilename);
-  ReadFile::Read(layersData, layersFilename);
-
-  if (mpgData.size() != layersData.size())
-    throw std::runtime_error("The files have different sizes");
-
-  for (int32_t i = 0; i < mpgData.size(); ++i) {
-    int32_t character = 0;
-    int32_t variableCounter = 0;
-
-    while (variableCounter < 3) {
-      if (layersData[i][character] == ';') ++variableCounter;
-
-      ++character;
-    }
-
-    layersData[i] = layersData[i].substr(character, layersData[i].length() - character - 1);
-  }
-
-  int32_t Nvariables = 0;
-
-  for (int32_t i = 0; i < layersData[0].length(); ++i)
-    if (layersData[0][i] == ';') ++Nvariables;
-
-  std::string mergedDataFilename
-      = fmt::format("{}/assets/user-info/0001/mergedData.txt",
-                    Utils::filemanagement::getRootDirectory("sahga-api-xmake"));
-
-  std::ofstream mergedDataStream(mergedDataFilename.c_str());
-
-  mergedDataStream << std::setiosflags(std::ios::fixed);
-  mergedDataStream << std::setprecision(0) << mpgData.size() << ';' << Nvariables << '\n';
-
-  for (int32_t i = 0; i < mpgData.size(); ++i)
-    mergedDataStream << mpgData[i] << layersData[i] << '\n';
+/*
+ * Samples every layer at the training points.
+ *
+ * @param { std::string } **folderName** - Folder of the layers.
+ * @param { int32_t } **level** - Overview level to sample (0 = full resolution).
+ *
+ * @return
+ * */
+SAHGACore* SAHGACore::extractLayers(const std::string& folderName, int32_t level) {
+  Pipeline pipeline(getStagePath());
+  ReadFile::Read(pipeline.train, pipeline.pathTo("train.txt"), '\t');
+  pipeline.keepIntermediates()->shareLayers(getLayerCache())->extractLayers(folderName, level);
 
-  mergedDataStream.close();
+  return this;
+}
 
-  mpgData.clear();
-  layersData.clear();
+SAHGACore* SAHGACore::mergeData(const std::string& mpgFilename, const std::string& layersFilename) {
+  Pipeline pipeline(getStagePath());
+  Dataset unused;
+  pipeline.graph = std::make_shared<Graph>();
+  ReadFile::Read(*pipeline.graph, unused, mpgFilename, ';');
+  ReadFile::Read(pipeline.layersData, layersFilename, ';');
+  pipeline.keepIntermediates()->mergeData();
 
   return this;
 }
 
 SAHGACore* SAHGACore::adjustModel(int32_t modelType, int32_t objectiveType,
                                   const std::string& filename, const bool& normalize) {
-  auto graph = std::make_unique<Graph>();
-  auto dataset = std::make_unique<Dataset>();
-
-  ReadFile::Read(*graph, *dataset, filename, ';');
-
-  // Atualizando as estatísticas da matriz de dados
-  dataset->updateStats();
-
-  // Armazena a média e o desvio padrão de cada coluna
-  std::vector<double> avg, stdDev;
-  for (int32_t i = 0; i < dataset->colN; ++i) {
-    avg.emplace_back(dataset->stats[i].avg);
-    stdDev.emplace_back(dataset->stats[i].stdDev);
-  }
+  Pipeline pipeline(getStagePath());
+  pipeline.graph = std::make_shared<Graph>();
+  pipeline.merged = std::make_shared<Dataset>();
+  pipeline.source = filename;
+  ReadFile::Read(*pipeline.graph, *pipeline.merged, filename, ';');
+  pipeline.adjustModel((GASA::ModelType)modelType, (GASA::ObjectiveType)objectiveType, normalize);
 
-  // Normalizando a matriz de dados
-  dataset->normalize(int32_t(normalize));
-
-  auto gasa = (std::make_unique<GASA>(*graph, *dataset, (GASA::ModelType)modelType,
-                                      (GASA::ObjectiveType)objectiveType))
-                  ->setSAHGAParameters(GASA::SAHGAParameter::HIGHPOP)
-                  ->run();
+  return this;
+}
 
-  std::string output = fmt::format("{}/assets/user-info/0001/result.txt",
-                                   Utils::filemanagement::getRootDirectory("sahga-api-xmake"));
+/*
+ * Evaluates the fitted model over the whole extent of the layers, with the neighborhood of
+ * the MPG mergeData wrote (its radius, criterion and neighbors).
+ *
+ * @param { std::string } **modelFilename** - The result.txt written by adjustModel.
+ * @param { std::string } **folderName** - Folder of the layers the model was fitted on.
+ * @param { std::string } **output** - Path of the suitability grid (ESRI ASCII).
+ * @param { int32_t } **level** - Overview level to predict on (0 = full resolution); a
+ * level n map has 2^n times coarser cells.
+ *
+ * @return
+ * */
+SAHGACore* SAHGACore::predict(const std::string& modelFilename, const std::string& folderName,
+                              const std::string& output, int32_t level) {
+  Pipeline pipeline(getStagePath());
+  pipeline.model = SuitabilityModel::load(modelFilename);
+  useFittedNeighborhood(pipeline)->shareLayers(getLayerCache())->predict(folderName, output, level);
 
-  std::ofstream outputStream(output.c_str());
+  return this;
+}
 
-  outputStream << std::setiosflags(std::ios::fixed) << std::setprecision(8);
-  outputStream << "//Modelo gerado para o arquivo de entrada: " << filename << '\n';
-  outputStream << "//Tipo do modelo ajustado:" << '\n';
+/*
+ * Scores the fitted model on the test points and writes the scores to evaluation.txt.
+ *
+ * @param { std::string } **modelFilename** - The result.txt written by adjustModel.
+ * @param { std::string } **testFilename** - The test.txt written by separateTrainTest.
+ * @param { std::string } **folderName** - Folder of the layers the model was fitted on.
+ * @param { int32_t } **level** - Overview level to predict on (0 = full resolution).
+ *
+ * @return
+ * */
+SAHGACore* SAHGACore::evaluate(const std::string& modelFilename, const std::string& testFilename,
+                               const std::string& folderName, int32_t level) {
+  Pipeline pipeline(getStagePath());
+  pipeline.model = SuitabilityModel::load(modelFilename);
+  ReadFile::Read(pipeline.test, testFilename, '\t');
+  useFittedNeighborhood(pipeline)->shareLayers(getLayerCache())->evaluate(folderName, level);
 
-  if (modelType == (int32_t)GASA::ModelType::LINEAR) outputStream << "LINEAR" << '\n';
-  if (modelType == (int32_t)GASA::ModelType::QUADRATIC) outputStream << "QUADRATIC" << '\n';
-  if (modelType == (int32_t)GASA::ModelType::LAG) outputStream << "LAG" << '\n';
+  return this;
+}
 
-  if (objectiveType == (int32_t)GASA::ObjectiveType::MINSQT)
-    outputStream << "//Aptidao final (Min SQT) = " << gasa->bestChromosome.fitness << '\n';
-  if (objectiveType == (int32_t)GASA::ObjectiveType::MINERR)
-    outputStream << "//Aptidao final (Min ERR) = " << gasa->bestChromosome.fitness << '\n';
-  if (objectiveType == (int32_t)GASA::ObjectiveType::MINBOTH)
-    outputStream << "//Aptidao final (Min SQT&ERR) = " << gasa->bestChromosome.fitness << '\n';
+/*
+ * Runs a queue of jobs for any number of users, each one writing to its own folder
+ * inside the user's folder (see JobRunner).
+ *
+ * @param { std::string } **queueFile** - The jobs, one per line (see JobRunner::readQueue).
+ * @param { int32_t } **workers** - Maximum number of jobs running at once.
+ * */
+void SAHGACore::runJobs(const std::string& queueFile, int32_t workers) {
+  const std::string cd = Utils::filemanagement::getRootDirectory("sahga-api-xmake");
+  JobRunner runner(fmt::format("{}/assets/user-info", cd), workers, 256 << 20, getDerivedPath());
 
-  outputStream << "//Saida --> c1;c2;...;cn;constante;[lambda]" << '\n';
-  for (int32_t i = 0; i < gasa->geneSize; ++i)
-    outputStream << gasa->bestChromosome.genes[i].value << ';';
-  outputStream << '\n' << "//Media das variáveis --> Media X0;Media X1;...MediaXn" << '\n';
-  for (int32_t i = 0; i < dataset->colN; ++i) outputStream << avg[i] << ';';
-  outputStream << '\n' << "//Desvio padrao das variáveis --> s0;s1;...;sn" << '\n';
-  for (int32_t i = 0; i < dataset->colN; ++i) outputStream << stdDev[i] << ';';
+  try {
+    const std::vector<JobRunner::Report> reports = runner.run(JobRunner::readQueue(queueFile));
+    fmt::print("{}", JobRunner::summary(reports));
+    fmt::print("Layer cache: {} layer sets, tiles {} hits / {} misses\n", runner.layers().size(),
+               runner.layers().tiles().hits(), runner.layers().tiles().misses());
+  } catch (const std::exception& e) {
+    fmt::print("Error\n");
+    fmt::print("{}\n", e.what());
+  }
+}
 
-  outputStream.close();
+/*
+ * Cross validates the default model (QUADRATIC, MINBOTH, HALFRADIUM MPG of 5 km) and
+ * prints the score of every fold; the model of each fold goes to the "cv" folder of the
+ * user.
+ *
+ * @param { std::string } **pointsFile** - Species points, relative to the server folder.
+ * @param { std::string } **layersFolder** - Layers, relative to the server folder.
+ * @param { int32_t } **folds** - Number of folds.
+ * @param { bool } **spatial** - Spatial block folds instead of stratified ones.
+ * */
+void SAHGACore::crossValidate(const std::string& pointsFile, const std::string& layersFolder,
+                              int32_t folds, bool spatial) {
+  try {
+    CrossValidation validation(getServerPathTo(pointsFile), getServerPathTo(layersFolder),
+                               getUserPathTo(1, "cv"));
+    validation
+        .setFolds(spatial ? CrossValidation::Scheme::SPATIAL : CrossValidation::Scheme::STRATIFIED,
+                  folds)
+        ->shareLayers(getLayerCache())
+        ->setMPG(5, Graph::MPGTypes::HALFRADIUM)
+        ->setModel(GASA::ModelType::QUADRATIC, GASA::ObjectiveType::MINBOTH);
+    fmt::print("{}", CrossValidation::summary(validation.run()));
+  } catch (const std::exception& e) {
+    fmt::print("Error\n");
+    fmt::print("{}\n", e.what());
+  }
+}
 
-  return this;
+/*
+ * Runs as a daemon that keeps the layers and the results of recent stages in memory
+ * between requests (see Daemon), with paths relative to the server folder.
+ *
+ * @param { std::string } **socketPath** - Unix socket to listen on.
+ * @param { size_t } **memoryBudget** - Bytes for cached tiles and stage results.
+ * */
+void SAHGACore::serve(const std::string& socketPath, size_t memoryBudget) {
+  const std::string cd = Utils::filemanagement::getRootDirectory("sahga-api-xmake");
+  try {
+    Daemon daemon(socketPath, fmt::format("{}/assets/user-info", cd), getServerPathTo(""),
+                  memoryBudget, getDerivedPath());
+    daemon.serve();
+  } catch (const std::exception& e) {
+    fmt::print("Error\n");
+    fmt::print("{}\n", e.what());
+  }
 }
 
 SAHGACore::~SAHGACore() { fmt::print("SAHGACore::~SAHGACore()\n"); }
@@ -0,0 +1,98 @@
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <sahga/core/bootstrap.hpp>
+#include <sahga/utils/parallel.hpp>
+#include <stdexcept>
+
+Bootstrap::Bootstrap(std::shared_ptr<const Graph> graph, std::shared_ptr<const Dataset> dataset,
+                     GASA::ModelType modelType, GASA::ObjectiveType objectiveType)
+    : _graph(std::move(graph)),
+      _dataset(std::move(dataset)),
+      _modelType(modelType),
+      _objectiveType(objectiveType),
+      _parameters(GASA::SAHGAParameter::HIGHPOP),
+      _generations(0),
+      _count(200),
+      _confidence(95),
+      _seed(std::default_random_engine::default_seed) {
+  if (!_graph || !_dataset || (_graph->nNodes != _dataset->rowN))
+    throw std::runtime_error("The bootstrap needs the MPG and the data it was fitted on");
+}
+
+Bootstrap *Bootstrap::setReplicates(int32_t replicates) {
+  if (replicates < 2) throw std::runtime_error("The bootstrap needs at least 2 replicates");
+  _count = replicates;
+  return this;
+}
+
+Bootstrap *Bootstrap::setConfidence(double confidence) {
+  if ((confidence <= 0) || (confidence >= 100))
+    throw std::runtime_error(fmt::format("Confidence of {}% is not between 0 and 100", confidence));
+  _confidence = confidence;
+  return this;
+}
+
+Bootstrap *Bootstrap::setSeed(uint32_t seed) {
+  _seed = seed;
+  return this;
+}
+
+Bootstrap *Bootstrap::setParameters(GASA::SAHGAParameter parameters, int32_t generations) {
+  _parameters = parameters;
+  _generations = generations;
+  return this;
+}
+
+// The value below which a share p of the sorted values lie, interpolating between them.
+static double percentile(const std::vector<double> &sorted, double p) {
+  const double position = p * (sorted.size() - 1);
+  const size_t below = (size_t)std::floor(position);
+  const size_t above = std::min(below + 1, sorted.size() - 1);
+  return sorted[below] + (position - below) * (sorted[above] - sorted[below]);
+}
+
+/*
+ * Fits every replicate and takes the percentile intervals of the coefficients.
+ *
+ * @param { std::vector<double> } estimate - Coefficients fitted on all the rows.
+ *
+ * @return { std::vector<Interval> } The interval of every coefficient, in model order.
+ * */
+std::vector<Bootstrap::Interval> Bootstrap::run(const std::vector<double> &estimate) {
+  const int32_t rows = _dataset->rowN;
+  _replicates.assign(_count, {});
+
+  Utils::parallel::TaskGroup group;
+  for (int32_t b = 0; b < _count; ++b)
+    group.run([this, b, rows, &estimate]() {
+      // Every replicate draws from its own engine, so the draws do not depend on the order
+      // the replicates run in
+      std::default_random_engine engine(_seed + b);
+      std::uniform_int_distribution<int32_t> draw(0, rows - 1);
+      auto weights = std::make_shared<std::vector<double>>(rows, 0.0);
+      for (int32_t i = 0; i < rows; ++i) ++(*weights)[draw(engine)];
+
+      GASA gasa(_graph, _dataset, _modelType, _objectiveType);
+      gasa.setSAHGAParameters(_parameters);
+      gasa.setGenerations((_generations > 0) ? _generations : std::max(1, gasa.maxGenerations / 4))
+          ->setWeights(weights)
+          ->setInitialChromosome(estimate)
+          ->run();
+
+      for (const Gene &gene : gasa.bestChromosome.genes) _replicates[b].push_back(gene.value);
+    });
+  group.wait();
+
+  const double tail = (1 - _confidence / 100) / 2;
+  std::vector<Interval> intervals(estimate.size());
+  std::vector<double> values(_count);
+  for (size_t c = 0; c < estimate.size(); ++c) {
+    for (int32_t b = 0; b < _count; ++b) values[b] = _replicates[b][c];
+    std::sort(values.begin(), values.end());
+    intervals[c] = {estimate[c], percentile(values, tail), percentile(values, 1 - tail)};
+  }
+
+  return intervals;
+}
@@ -0,0 +1,296 @@
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <sahga/core/cross_validation.hpp>
+#include <sahga/core/pipeline.hpp>
+#include <sahga/core/predict.hpp>
+#include <sahga/utils/mapped_file.hpp>
+#include <sahga/utils/parallel.hpp>
+#include <sahga/utils/tokenizer.hpp>
+#include <sahga/utils/utils.hpp>
+#include <stdexcept>
+
+// #id;long;lat;presence of every point of fileName (#id, label, long, lat, presence).
+static Dataset readPoints(const std::string &fileName) {
+  MappedFile file(fileName);
+  std::vector<std::string_view> lines
+      = Utils::parsing::lines(std::string_view(file.data(), file.size()));
+  if (lines.empty()) throw std::runtime_error(fmt::format("{} is empty", fileName));
+
+  // Drop the header and the blank lines
+  lines.erase(lines.begin());
+  lines.erase(std::remove_if(lines.begin(), lines.end(),
+                             [](std::string_view line) { return line.empty(); }),
+              lines.end());
+
+  Dataset points;
+  points.reset(lines.size(), 4);
+  points.names = {"id", "long", "lat", "presence"};
+  for (size_t i = 0; i < lines.size(); ++i) {
+    Utils::parsing::Tokenizer tokens(lines[i], '\t');
+    double value;
+
+    points.M[i][0] = (double)(i + 1);
+    tokens.skip(2);
+    for (int32_t j = 1; (j < 4) && tokens.next(value); ++j) points.M[i][j] = value;
+  }
+
+  return points;
+}
+
+// The rows of source, in that order and in its layout, numbered again from 1.
+static Dataset subset(const Dataset &source, const std::vector<int32_t> &rows) {
+  Dataset out;
+  out.reset(rows.size(), source.colN, source.layout());
+  out.names = source.names;
+
+  for (int32_t j = 0; j < source.colN; ++j)
+    for (size_t k = 0; k < rows.size(); ++k) out.at(k, j) = source.at(rows[k], j);
+  for (size_t k = 0; k < rows.size(); ++k) out.at(k, 0) = (double)(k + 1);
+
+  return out;
+}
+
+CrossValidation::CrossValidation(const std::string &pointsFile, const std::string &layersFolder,
+                                 const std::string &folder)
+    : _pointsFile(pointsFile),
+      _layersFolder(layersFolder),
+      _folder(folder),
+      _points(readPoints(pointsFile)),
+      _scheme(Scheme::STRATIFIED),
+      _k(5),
+      _seed(std::default_random_engine::default_seed),
+      _blockSize(100),
+      _radius(5),
+      _mpgType(Graph::MPGTypes::HALFRADIUM),
+      _modelType(GASA::ModelType::QUADRATIC),
+      _objectiveType(GASA::ObjectiveType::MINBOTH),
+      _parameters(GASA::SAHGAParameter::HIGHPOP),
+      _level(0),
+      _quantization(Utils::binary::Encoding::FLOAT64),
+      _layers(std::make_shared<LayerCache>()) {
+  std::filesystem::create_directories(folder);
+}
+
+CrossValidation *CrossValidation::setFolds(Scheme scheme, int32_t k, uint32_t seed) {
+  if (k < 2) throw std::runtime_error("Cross validation needs at least 2 folds");
+  _scheme = scheme;
+  _k = k;
+  _seed = seed;
+  return this;
+}
+
+CrossValidation *CrossValidation::setBlockSize(double km) {
+  if (km <= 0) throw std::runtime_error("The block size must be positive");
+  _blockSize = km;
+  return this;
+}
+
+CrossValidation *CrossValidation::setMPG(double radius, Graph::MPGTypes type) {
+  // The folds are cut out of one neighbor table, which needs a finite radius
+  if (radius <= 0) throw std::runtime_error("Cross validation needs a positive MPG radius");
+  _radius = radius;
+  _mpgType = type;
+  return this;
+}
+
+CrossValidation *CrossValidation::setModel(GASA::ModelType modelType,
+                                           GASA::ObjectiveType objectiveType,
+                                           GASA::SAHGAParameter parameters) {
+  _modelType = modelType;
+  _objectiveType = objectiveType;
+  _parameters = parameters;
+  return this;
+}
+
+CrossValidation *CrossValidation::setLevel(int32_t level,
+                                           Utils::binary::Encoding quantization) {
+  _level = level;
+  _quantization = quantization;
+  return this;
+}
+
+CrossValidation *CrossValidation::shareLayers(std::shared_ptr<LayerCache> layers) {
+  _layers = std::move(layers);
+  return this;
+}
+
+//----------------------------------------------------------------------------------------------
+// Folds
+//----------------------------------------------------------------------------------------------
+
+std::vector<CrossValidation::Fold> CrossValidation::folds() const {
+  if (_points.rowN < _k)
+    throw std::runtime_error(
+        fmt::format("{} points are not enough for {} folds", _points.rowN, _k));
+
+  std::vector<Fold> folds = (_scheme == Scheme::STRATIFIED) ? stratifiedFolds() : spatialFolds();
+
+  // Every fold trains on the points the others hold out
+  for (size_t f = 0; f < folds.size(); ++f) {
+    std::sort(folds[f].test.begin(), folds[f].test.end());
+    for (size_t g = 0; g < folds.size(); ++g)
+      if (g != f) folds[f].train.insert(folds[f].train.end(), folds[g].test.begin(),
+                                        folds[g].test.end());
+    std::sort(folds[f].train.begin(), folds[f].train.end());
+  }
+
+  return folds;
+}
+
+// The points of every class are shuffled and dealt to the folds in turn.
+std::vector<CrossValidation::Fold> CrossValidation::stratifiedFolds() const {
+  std::map<double, std::vector<int32_t>> classes;
+  for (int32_t i = 0; i < _points.rowN; ++i) classes[_points.M[i][3]].push_back(i);
+
+  auto engine = std::default_random_engine{_seed};
+  std::vector<Fold> folds(_k);
+  int32_t dealt = 0;
+  for (auto &members : classes) {
+    std::shuffle(members.second.begin(), members.second.end(), engine);
+    for (int32_t row : members.second) folds[dealt++ % _k].test.push_back(row);
+  }
+
+  return folds;
+}
+
+// Whole blocks go to the fold holding the fewest points so far, largest blocks first.
+std::vector<CrossValidation::Fold> CrossValidation::spatialFolds() const {
+  const double side = _blockSize / Utils::constants::KM_PER_DEGREE;
+
+  std::map<std::pair<int64_t, int64_t>, std::vector<int32_t>> cells;
+  for (int32_t i = 0; i < _points.rowN; ++i)
+    cells[{(int64_t)std::floor(_points.M[i][1] / side),
+           (int64_t)std::floor(_points.M[i][2] / side)}]
+        .push_back(i);
+
+  if ((int32_t)cells.size() < _k)
+    throw std::runtime_error(fmt::format("The points fall in {} blocks of {} km, fewer than {}",
+                                         cells.size(), _blockSize, _k));
+
+  std::vector<std::vector<int32_t>> blocks;
+  for (auto &cell : cells) blocks.push_back(std::move(cell.second));
+
+  // Shuffled first so that blocks of the same size are taken in a random order
+  auto engine = std::default_random_engine{_seed};
+  std::shuffle(blocks.begin(), blocks.end(), engine);
+  std::stable_sort(blocks.begin(), blocks.end(),
+                   [](const std::vector<int32_t> &a, const std::vector<int32_t> &b) {
+                     return a.size() > b.size();
+                   });
+
+  std::vector<Fold> folds(_k);
+  for (const std::vector<int32_t> &block : blocks) {
+    Fold &smallest = *std::min_element(
+        folds.begin(), folds.end(),
+        [](const Fold &a, const Fold &b) { return a.test.size() < b.test.size(); });
+    smallest.test.insert(smallest.test.end(), block.begin(), block.end());
+  }
+
+  return folds;
+}
+
+//----------------------------------------------------------------------------------------------
+// Run
+//----------------------------------------------------------------------------------------------
+
+/*
+ * Fits and scores every fold.
+ *
+ * @return { std::vector<Score> } The score of each fold, in fold order.
+ * */
+std::vector<CrossValidation::Score> CrossValidation::run() {
+  const std::vector<Fold> folds = this->folds();
+
+  // Shared by every fold: the layers sampled at all points and their neighbor table
+  Pipeline sampler(_folder);
+  sampler.train = _points;
+  sampler.shareLayers(_layers)
+      ->quantizeLayers(_quantization)
+      ->extractLayers(_layersFolder, _level);
+  const Dataset &sampled = sampler.layersData;
+
+  std::shared_ptr<const LayerCache::Layers> layers
+      = _layers->get(_layersFolder, _level, _quantization);
+  if (!layers->stack)
+    throw std::runtime_error(fmt::format("The layers of {} are not on one grid", _layersFolder));
+
+  const TNeighborTable table = Graph::findNeighbors(_points, _radius);
+
+  std::vector<Score> scores(folds.size());
+  Utils::parallel::TaskGroup group;
+  for (size_t f = 0; f < folds.size(); ++f)
+    group.run([&, f]() {
+      using Clock = std::chrono::steady_clock;
+      const Clock::time_point start = Clock::now();
+      const Fold &fold = folds[f];
+
+      Pipeline pipeline((std::filesystem::path(_folder) / fmt::format("fold{}", f + 1)).string());
+      pipeline.source = fmt::format("{} (fold {} of {})", _pointsFile, f + 1, folds.size());
+      pipeline.train = subset(_points, fold.train);
+      pipeline.layersData = subset(sampled, fold.train);
+      pipeline.graph = std::make_shared<Graph>();
+      pipeline.graph->createMPG(_points, table, fold.train, _radius, (int32_t)_mpgType);
+
+      Score &score = scores[f];
+      score.fold = (int32_t)f + 1;
+      score.trainPoints = (int32_t)fold.train.size();
+      score.testPoints = (int32_t)fold.test.size();
+      score.fitness = 0;
+      pipeline.onGeneration([&score](int32_t, int32_t, double best) { score.fitness = best; })
+          ->mergeData()
+          ->adjustModel(_modelType, _objectiveType, true, _parameters);
+
+      // The map value at the held out points against their presence
+      const Predictor predictor(pipeline.model, _radius, _mpgType);
+      score.evaluation = Evaluation::score(predictor, *layers->stack, subset(_points, fold.test));
+      score.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    });
+  group.wait();
+
+  return scores;
+}
+
+std::string CrossValidation::summary(const std::vector<Score> &scores) {
+  std::string text
+      = fmt::format("{:>4}  {:>5}  {:>4}  {:>10}  {:>6}  {:>6}  {:>6}  {:>6}  {:>8}\n", "Fold",
+                    "Train", "Test", "Fitness", "AUC", "TSS", "Kappa", "RMSE", "Time (s)");
+  for (const Score &score : scores) {
+    const Evaluation &evaluation = score.evaluation;
+    text += fmt::format("{:>4}  {:>5}  {:>4}  {:>10.4f}  {:>6.3f}  {:>6.3f}  {:>6.3f}  {:>6.3f}  "
+                        "{:>8.3f}\n",
+                        score.fold, score.trainPoints, score.testPoints, score.fitness,
+                        evaluation.auc, evaluation.confusion.tss(), evaluation.confusion.kappa(),
+                        evaluation.rmse, score.seconds);
+  }
+
+  // Mean and sample standard deviation over the folds
+  auto spread = [&scores](const std::function<double(const Score &)> &value) {
+    double sum = 0, sum2 = 0;
+    for (const Score &score : scores) sum += value(score);
+    const double mean = sum / scores.size();
+    for (const Score &score : scores) sum2 += (value(score) - mean) * (value(score) - mean);
+    const double stdDev = (scores.size() > 1) ? std::sqrt(sum2 / (scores.size() - 1)) : 0;
+    return std::make_pair(mean, stdDev);
+  };
+
+  const std::pair<double, double> spreads[] = {
+      spread([](const Score &score) { return score.fitness; }),
+      spread([](const Score &score) { return score.evaluation.auc; }),
+      spread([](const Score &score) { return score.evaluation.confusion.tss(); }),
+      spread([](const Score &score) { return score.evaluation.confusion.kappa(); }),
+      spread([](const Score &score) { return score.evaluation.rmse; })};
+
+  text += fmt::format("{:<17}  {:>10.4f}  {:>6.3f}  {:>6.3f}  {:>6.3f}  {:>6.3f}\n", "Mean",
+                      spreads[0].first, spreads[1].first, spreads[2].first, spreads[3].first,
+                      spreads[4].first);
+  text += fmt::format("{:<17}  {:>10.4f}  {:>6.3f}  {:>6.3f}  {:>6.3f}  {:>6.3f}\n", "SD",
+                      spreads[0].second, spreads[1].second, spreads[2].second, spreads[3].second,
+                      spreads[4].second);
+  return text;
+}
@@ -0,0 +1,325 @@
+#include <fmt/format.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <sahga/core/daemon.hpp>
+#include <sahga/core/job_runner.hpp>
+#include <sahga/core/predict.hpp>
+#include <sahga/utils/json.hpp>
+#include <sahga/utils/parallel.hpp>
+#include <stdexcept>
+#include <thread>
+
+// A fitted model and the neighborhood it was fitted with, kept for predict requests.
+struct FittedModel {
+  SuitabilityModel model;
+  double radius;
+  Graph::MPGTypes mpgType;
+};
+
+static sockaddr_un socketAddress(const std::string &socketPath) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(address.sun_path))
+    throw std::runtime_error(fmt::format("Socket path too long: {}", socketPath));
+  std::strcpy(address.sun_path, socketPath.c_str());
+
+  return address;
+}
+
+Daemon::Daemon(const std::string &socketPath, const std::string &usersFolder,
+               const std::string &serverFolder, size_t memoryBudget,
+               const std::string &derivedFolder)
+    : _socketPath(socketPath),
+      _usersFolder(usersFolder),
+      _serverFolder(serverFolder),
+      _listener(-1),
+      _stopping(false),
+      _fits(0),
+      _layers(std::make_shared<LayerCache>(memoryBudget / 2, derivedFolder)),
+      _memory(std::make_shared<MemoryCache>(memoryBudget / 2)) {
+  const sockaddr_un address = socketAddress(socketPath);
+
+  // A socket file nobody answers on is left over from a daemon that did not exit cleanly
+  const int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+  const bool running
+      = (probe >= 0) && (connect(probe, (const sockaddr *)&address, sizeof(address)) == 0);
+  if (probe >= 0) close(probe);
+  if (running) throw std::runtime_error(fmt::format("A daemon is already on {}", socketPath));
+  unlink(socketPath.c_str());
+
+  _listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if ((_listener < 0) || (bind(_listener, (const sockaddr *)&address, sizeof(address)) != 0)
+      || (listen(_listener, 16) != 0)) {
+    const std::string error = std::strerror(errno);
+    if (_listener >= 0) close(_listener);
+    throw std::runtime_error(fmt::format("Failed to listen on {}: {}", socketPath, error));
+  }
+}
+
+Daemon::~Daemon() {
+  stop();
+  std::unique_lock<std::mutex> lock(_mutex);
+  _idle.wait(lock, [this]() { return _clients.empty(); });
+
+  close(_listener);
+  unlink(_socketPath.c_str());
+}
+
+void Daemon::serve() {
+  fmt::print("Listening on {}\n", _socketPath);
+
+  while (!_stopping) {
+    const int client = accept(_listener, nullptr, nullptr);
+    if (client < 0) {
+      if (_stopping) break;
+      if (errno == EINTR) continue;
+      throw std::runtime_error(fmt::format("accept: {}", std::strerror(errno)));
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _clients.insert(client);
+    }
+    std::thread(&Daemon::handle, this, client).detach();
+  }
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  _idle.wait(lock, [this]() { return _clients.empty(); });
+}
+
+void Daemon::stop() {
+  if (_stopping.exchange(true)) return;
+
+  // Wakes accept, and the clients waiting for their next request
+  shutdown(_listener, SHUT_RDWR);
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (int client : _clients) shutdown(client, SHUT_RD);
+}
+
+//----------------------------------------------------------------------------------------------
+// Connections
+//----------------------------------------------------------------------------------------------
+
+void Daemon::handle(int client) {
+  // Progress comes from the threads running the stages, so lines are sent one at a time
+  std::mutex sending;
+  const Send send = [&](const std::string &line) {
+    std::lock_guard<std::mutex> lock(sending);
+    const std::string data = line + '\n';
+    for (size_t sent = 0; sent < data.size();) {
+      const ssize_t count = ::send(client, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+      if (count <= 0) return;  // The client left; the request still runs to the end
+      sent += count;
+    }
+  };
+
+  std::string buffer;
+  char chunk[4096];
+  while (true) {
+    const ssize_t count = recv(client, chunk, sizeof(chunk), 0);
+    if (count < 0 && errno == EINTR) continue;
+    if (count <= 0) break;
+    buffer.append(chunk, count);
+
+    size_t newline;
+    while ((newline = buffer.find('\n')) != std::string::npos) {
+      const std::string line = buffer.substr(0, newline);
+      buffer.erase(0, newline + 1);
+      if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+      try {
+        request(Utils::json::parseObject(line), send);
+      } catch (const std::exception &e) {
+        send(Utils::json::Object().add("event", "error").add("message", e.what()).str());
+      }
+    }
+  }
+
+  close(client);
+  std::lock_guard<std::mutex> lock(_mutex);
+  _clients.erase(client);
+  _idle.notify_all();
+}
+
+void Daemon::request(const std::map<std::string, std::string> &fields, const Send &send) {
+  auto op = fields.find("op");
+  if (op == fields.end()) throw std::runtime_error("The request has no op");
+
+  if (op->second == "fit") {
+    fit(fields, send);
+    _layers->trim();  // Sets no other request holds; reopening one only maps its files
+  } else if (op->second == "predict") {
+    predict(fields, send);
+    _layers->trim();
+  } else if (op->second == "status") {
+    send(status());
+  } else if (op->second == "shutdown") {
+    send(Utils::json::Object().add("event", "done").str());
+    stop();
+  } else {
+    throw std::runtime_error(fmt::format("Unknown op {}", op->second));
+  }
+}
+
+//----------------------------------------------------------------------------------------------
+// Requests
+//----------------------------------------------------------------------------------------------
+
+// The job of a request: every field but op and predict is a JobRunner field.
+static JobRunner::Job jobOf(const std::map<std::string, std::string> &fields,
+                            const std::string &serverFolder, const std::string &name) {
+  JobRunner::Job job;
+  job.name = name;
+  for (const auto &field : fields)
+    if ((field.first != "op") && (field.first != "predict"))
+      JobRunner::setField(job, field.first, field.second, serverFolder);
+
+  return job;
+}
+
+static StageCache::Key modelKey(const JobRunner::Job &job) {
+  return StageCache::Key("model").add(job.userId).add(job.name);
+}
+
+void Daemon::fit(const std::map<std::string, std::string> &fields, const Send &send) {
+  using Clock = std::chrono::steady_clock;
+  const Clock::time_point start = Clock::now();
+
+  // Unnamed fits get a folder and a model of their own, however many run at once
+  const int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::system_clock::now().time_since_epoch())
+                          .count();
+  const JobRunner::Job job = jobOf(fields, _serverFolder, fmt::format("fit-{}-{}", now, ++_fits));
+  if (job.points.empty() || job.layers.empty())
+    throw std::runtime_error("fit needs points and layers");
+
+  auto predict = fields.find("predict");
+  const bool predicts = (predict != fields.end()) && (predict->second == "true");
+
+  const std::filesystem::path user
+      = std::filesystem::path(_usersFolder) / fmt::format("{:04}", job.userId);
+  const std::filesystem::path folder = user / "jobs" / job.name;
+  const std::string output = predicts ? (folder / "suitability.asc").string() : "";
+
+  double fitness = 0;
+  Pipeline pipeline(folder.string());
+  pipeline.useCache((user / "cache").string())
+      ->shareLayers(_layers)
+      ->useMemory(_memory)
+      ->onGeneration([&](int32_t generation, int32_t generations, double best) {
+        fitness = best;
+        send(Utils::json::Object()
+                 .add("event", "generation")
+                 .add("generation", generation)
+                 .add("generations", generations)
+                 .add("fitness", best)
+                 .str());
+      });
+
+  Utils::parallel::TaskGraph stages;
+  stages.listen([&send](const std::string &task, const std::string &event, double seconds) {
+    send(Utils::json::Object()
+             .add("event", "stage")
+             .add("stage", task)
+             .add("state", event)
+             .add("seconds", seconds)
+             .str());
+  });
+  JobRunner::addStages(stages, pipeline, job, output);
+  stages.run();
+
+  const size_t bytes = sizeof(FittedModel)
+                       + (pipeline.model.coefficients.size() + 2 * pipeline.model.avg.size())
+                             * sizeof(double);
+  _memory->put(modelKey(job).value(),
+               std::make_shared<const FittedModel>(
+                   FittedModel{pipeline.model, job.radius, job.mpgType}),
+               bytes);
+
+  Utils::json::Object done;
+  done.add("event", "done")
+      .add("name", job.name)
+      .add("seconds", std::chrono::duration<double>(Clock::now() - start).count())
+      .add("fitness", fitness)
+      .add("coefficients", pipeline.model.coefficients)
+      .add("auc", pipeline.evaluation.auc)
+      .add("tss", pipeline.evaluation.confusion.tss())
+      .add("kappa", pipeline.evaluation.confusion.kappa())
+      .add("result", pipeline.pathTo("result.txt"));
+  if (predicts) done.add("suitability", output);
+  send(done.str());
+}
+
+void Daemon::predict(const std::map<std::string, std::string> &fields, const Send &send) {
+  using Clock = std::chrono::steady_clock;
+  const Clock::time_point start = Clock::now();
+  auto elapsed = [&start]() {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  };
+
+  const JobRunner::Job job = jobOf(fields, _serverFolder, "");
+  if (job.name.empty() || job.layers.empty())
+    throw std::runtime_error("predict needs the name of a job and layers");
+
+  const std::filesystem::path folder = std::filesystem::path(_usersFolder)
+                                       / fmt::format("{:04}", job.userId) / "jobs" / job.name;
+
+  // A model fitted by this daemon, or else the result.txt of the job with the request's
+  // neighborhood
+  std::shared_ptr<const FittedModel> fitted = _memory->get<FittedModel>(modelKey(job).value());
+  if (!fitted) {
+    const std::string model = (folder / "result.txt").string();
+    if (!std::filesystem::exists(model))
+      throw std::runtime_error(fmt::format("Job {} of user {} has no model", job.name, job.userId));
+    fitted = std::make_shared<const FittedModel>(
+        FittedModel{SuitabilityModel::load(model), job.radius, job.mpgType});
+  }
+
+  auto event = [&](const char *state) {
+    send(Utils::json::Object()
+             .add("event", "stage")
+             .add("stage", "predict")
+             .add("state", state)
+             .add("seconds", elapsed())
+             .str());
+  };
+
+  event("started");
+  std::shared_ptr<const LayerCache::Layers> layers
+      = _layers->get(job.layers, job.level, job.quantization);
+  if (!layers->stack)
+    throw std::runtime_error(fmt::format("The layers of {} are not on one grid", job.layers));
+
+  const std::string output = (folder / "suitability.asc").string();
+  Predictor(fitted->model, fitted->radius, fitted->mpgType).predict(*layers->stack, output);
+  event("done");
+
+  send(Utils::json::Object()
+           .add("event", "done")
+           .add("seconds", elapsed())
+           .add("suitability", output)
+           .str());
+}
+
+std::string Daemon::status() const {
+  const TileCache &tiles = _layers->tiles();
+  return Utils::json::Object()
+      .add("event", "done")
+      .add("memoryBytes", _memory->size())
+      .add("memoryBudget", _memory->budget())
+      .add("memoryEntries", _memory->count())
+      .add("memoryHits", _memory->hits())
+      .add("memoryMisses", _memory->misses())
+      .add("tileBytes", tiles.size())
+      .add("tileBudget", tiles.capacity())
+      .add("tileHits", tiles.hits())
+      .add("tileMisses", tiles.misses())
+      .add("layerSets", _layers->size())
+      .str();
+}
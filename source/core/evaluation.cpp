@@ -0,0 +1,197 @@
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <sahga/core/evaluation.hpp>
+#include <sahga/utils/parallel.hpp>
+#include <stdexcept>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------
+// Confusion matrix
+//----------------------------------------------------------------------------------------------
+
+static double ratio(int64_t part, int64_t whole) {
+  return (whole > 0) ? (double)part / whole : NAN;
+}
+
+double Evaluation::Confusion::sensitivity() const {
+  return ratio(truePositives, truePositives + falseNegatives);
+}
+
+double Evaluation::Confusion::specificity() const {
+  return ratio(trueNegatives, trueNegatives + falsePositives);
+}
+
+double Evaluation::Confusion::accuracy() const {
+  return ratio(truePositives + trueNegatives, total());
+}
+
+double Evaluation::Confusion::tss() const { return sensitivity() + specificity() - 1; }
+
+// Agreement beyond the one expected from how often each class is observed and predicted.
+double Evaluation::Confusion::kappa() const {
+  const double n = (double)total();
+  if (n == 0) return NAN;
+
+  const double predictedPresent = (double)(truePositives + falsePositives) / n;
+  const double observedPresent = (double)(truePositives + falseNegatives) / n;
+  const double observed = (truePositives + trueNegatives) / n;
+  const double expected = predictedPresent * observedPresent
+                          + (1 - predictedPresent) * (1 - observedPresent);
+  return (expected == 1) ? NAN : (observed - expected) / (1 - expected);
+}
+
+//----------------------------------------------------------------------------------------------
+// Scores
+//----------------------------------------------------------------------------------------------
+
+Evaluation Evaluation::score(Span<const double> predicted, Span<const double> observed,
+                             double threshold, double noData) {
+  if (predicted.size() != observed.size())
+    throw std::runtime_error(fmt::format("{} predictions for {} observations", predicted.size(),
+                                         observed.size()));
+
+  Evaluation evaluation;
+  evaluation.points = predicted.size();
+  evaluation.threshold = threshold;
+  if (predicted.size() == 0) return evaluation;
+
+  // Every chunk counts on its own, then the counts are added up
+  struct Partial {
+    Confusion confusion;
+    double squares = 0;
+  };
+  const int64_t n = predicted.size(), grain = 1 << 16;
+  std::vector<Partial> partials(Utils::parallel::chunkCount(n, grain));
+
+  Utils::parallel::forChunks(0, n, grain, [&](int32_t chunk, int64_t begin, int64_t end) {
+    Confusion &confusion = partials[chunk].confusion;
+    for (int64_t i = begin; i < end; ++i) {
+      if (predicted[i] == noData) continue;
+
+      const double error = observed[i] - predicted[i];
+      partials[chunk].squares += error * error;
+
+      const bool presence = (predicted[i] >= threshold);
+      if (observed[i] == 1) {
+        ++(presence ? confusion.truePositives : confusion.falseNegatives);
+      } else {
+        ++(presence ? confusion.falsePositives : confusion.trueNegatives);
+      }
+    }
+  });
+
+  double squares = 0;
+  Confusion &confusion = evaluation.confusion;
+  for (const Partial &partial : partials) {
+    confusion.truePositives += partial.confusion.truePositives;
+    confusion.falsePositives += partial.confusion.falsePositives;
+    confusion.falseNegatives += partial.confusion.falseNegatives;
+    confusion.trueNegatives += partial.confusion.trueNegatives;
+    squares += partial.squares;
+  }
+
+  evaluation.scored = confusion.total();
+  if (evaluation.scored > 0) evaluation.rmse = std::sqrt(squares / evaluation.scored);
+  evaluation.auc = areaUnderCurve(predicted, observed, noData);
+
+  return evaluation;
+}
+
+Evaluation Evaluation::score(const Predictor &predictor, const LayerStack &stack,
+                             const Dataset &points, double threshold) {
+  const std::vector<double> predicted
+      = predictor.predictPoints(stack, points.column(1), points.column(2));
+  return score(Span<const double>(predicted.data(), predicted.size()), points.column(3),
+               threshold, predictor.noDataValue());
+}
+
+/*
+ * Area under the ROC curve: the chance that a presence is predicted above an absence,
+ * ties counting as half. NaN unless there are both presences and absences.
+ * */
+double Evaluation::areaUnderCurve(Span<const double> predicted, Span<const double> observed,
+                                  double noData) {
+  const int64_t n = predicted.size();
+  double lowest = HUGE_VAL, highest = -HUGE_VAL;
+  int64_t scored = 0;
+  for (int64_t i = 0; i < n; ++i) {
+    if (predicted[i] == noData) continue;
+    lowest = std::min(lowest, predicted[i]);
+    highest = std::max(highest, predicted[i]);
+    ++scored;
+  }
+
+  // Presences and absences at each distinct prediction (or bin), lowest first. Every
+  // presence beats the absences below it and ties with those at its own value.
+  double wins = 0;
+  int64_t presences = 0, absences = 0;
+  auto tally = [&](int64_t present, int64_t absent) {
+    wins += present * (absences + 0.5 * absent);
+    presences += present;
+    absences += absent;
+  };
+
+  if (scored <= exactLimit) {
+    std::vector<std::pair<double, bool>> ranked;
+    ranked.reserve(scored);
+    for (int64_t i = 0; i < n; ++i)
+      if (predicted[i] != noData) ranked.emplace_back(predicted[i], observed[i] == 1);
+    std::sort(ranked.begin(), ranked.end());
+
+    for (size_t first = 0; first < ranked.size();) {
+      size_t last = first;
+      int64_t present = 0;
+      while ((last < ranked.size()) && (ranked[last].first == ranked[first].first))
+        present += ranked[last++].second;
+      tally(present, (int64_t)(last - first) - present);
+      first = last;
+    }
+  } else {
+    // Presences and absences per bin, counted by every chunk on its own
+    const double width = (highest > lowest) ? (highest - lowest) / bins : 1;
+    const int64_t grain = 1 << 16;
+    std::vector<std::vector<int64_t>> counts(Utils::parallel::chunkCount(n, grain),
+                                             std::vector<int64_t>(2 * bins, 0));
+
+    Utils::parallel::forChunks(0, n, grain, [&](int32_t chunk, int64_t begin, int64_t end) {
+      int64_t *count = counts[chunk].data();
+      for (int64_t i = begin; i < end; ++i) {
+        if (predicted[i] == noData) continue;
+        const int64_t bin = (int64_t)((predicted[i] - lowest) / width);
+        ++count[2 * std::min<int64_t>(bin, bins - 1) + (observed[i] == 1)];
+      }
+    });
+
+    for (int32_t bin = 0; bin < bins; ++bin) {
+      int64_t present = 0, absent = 0;
+      for (const std::vector<int64_t> &count : counts) {
+        absent += count[2 * bin];
+        present += count[2 * bin + 1];
+      }
+      tally(present, absent);
+    }
+  }
+
+  return ((presences > 0) && (absences > 0)) ? wins / ((double)presences * absences) : NAN;
+}
+
+std::string Evaluation::report() const {
+  std::string text = fmt::format("Points: {} ({} inside the layers)\n", points, scored);
+  text += fmt::format("AUC: {:.4f}\n", auc);
+  text += fmt::format("TSS: {:.4f}\n", confusion.tss());
+  text += fmt::format("Kappa: {:.4f}\n", confusion.kappa());
+  text += fmt::format("RMSE: {:.4f}\n", rmse);
+  text += fmt::format("Accuracy: {:.4f}\n", confusion.accuracy());
+  text += fmt::format("Sensitivity: {:.4f}\n", confusion.sensitivity());
+  text += fmt::format("Specificity: {:.4f}\n", confusion.specificity());
+
+  text += fmt::format("\nConfusion matrix (threshold {}):\n", threshold);
+  text += fmt::format("{:>11}  {:>10}  {:>10}\n", "", "Observed 1", "Observed 0");
+  text += fmt::format("{:>11}  {:>10}  {:>10}\n", "Predicted 1", confusion.truePositives,
+                      confusion.falsePositives);
+  text += fmt::format("{:>11}  {:>10}  {:>10}\n", "Predicted 0", confusion.falseNegatives,
+                      confusion.trueNegatives);
+  return text;
+}
@@ -1,8 +1,35 @@
+#include <fmt/format.h>
+
 #include <cmath>
 #include <iostream>
 #include <sahga/core/gasa.hpp>
 #include <sahga/utils/random.hpp>
 #include <sahga/utils/utils.hpp>
+#include <stdexcept>
+
+//----------------------------------------------------------------------------------------------
+// Erro de uma amostra segundo a função objetivo
+//----------------------------------------------------------------------------------------------
+double GASA::sampleError(const double &observed, const double &estimation) const {
+  // Avaliado como ausência mas era presença (False Negative = Omission Error) ou Avaliado
+  // como presença mas era ausência (False Positive = Comission Error)
+  const bool wrong
+      = ((estimation < 0.5) && (observed == 1)) || ((estimation >= 0.5) && (observed == 0));
+
+  switch (objectiveFunction) {
+    case ObjectiveType::MINSQT:  // MINSQT = Minimizar a soma do quadrado dos desvios (todos os
+                                 // modelos)
+      return pow((observed - estimation), 2);
+    case ObjectiveType::MINERR:  // MINERR = Minimizar a quantidade de erros de
+                                 // Omissão/Comissão (Dist. de espécies)
+      return wrong ? 1 : 0;
+    case ObjectiveType::MINBOTH:  // MINBOTH = Minimizar tanto o SQT quanto os erros de
+                                  // Omissão/Comissão (Dist. de espécies)
+      return pow((observed - estimation), 2) + (wrong ? epsilon : 0);
+  }
+
+  return 0;
+}
 
 //----------------------------------------------------------------------------------------------
 // Fitness calculation for the chromossome
@@ -14,7 +41,8 @@ double GASA::calculateChromosomeFitness(const Chromosome &chromosome) {
   double sumN, sumD;  // TODO: Detail this.
   double average;
 
-  double fitness = 0;
+  double fitness = 0, error;
+  const double *weight = weights ? weights->data() : nullptr;  // Pesos das amostras, ou 1
 
   switch (modelType) {
     case ModelType::LINEAR:
@@ -22,6 +50,7 @@ double GASA::calculateChromosomeFitness(const Chromosome &chromosome) {
 
       // Para todos os dados de entrada
       for (int32_t i = 0; i < dataset->rowN; ++i) {
+        if (weight && (weight[i] == 0)) continue;  // Fora da reamostragem
         chromosomeEstimation = 0;
 
         // Para todas as variáveis independentes
@@ -48,29 +77,10 @@ double GASA::calculateChromosomeFitness(const Chromosome &chromosome) {
         // Acumula a constante do modelo
         chromosomeEstimation += chromosome.genes[geneSize - 1].value;
 
-        // Incrementa em fitness a parcela de erro ocorrido na amostra i
-        switch (objectiveFunction) {
-          case ObjectiveType::MINSQT:  // MINSQT = Minimizar a soma do quadrado dos desvios (todos
-                                       // os modelos)
-            fitness += pow((dataset->M[i][0] - chromosomeEstimation), 2);
-            break;
-          case ObjectiveType::MINERR:  // MINERR = Minimizar a quantidade de erros de
-                                       // Omissão/Comissão (Dist. de espécies)
-            // Avaliado como ausência mas era presença (False Negative = Omission
-            // Error) ou Avaliado como presença mas era ausência ((False Positive =
-            // Comission Error)
-            if (((chromosomeEstimation < 0.5) && (dataset->M[i][0] == 1))
-                || ((chromosomeEstimation >= 0.5) && (dataset->M[i][0] == 0)))
-              ++fitness;
-            break;
-          case ObjectiveType::MINBOTH:  // MINBOTH = Minimizar tanto o SQT quanto os erros de
-                                        // Omissão/Comissão (Dist. de espécies)
-            fitness += pow((dataset->M[i][0] - chromosomeEstimation), 2);
-            if (((chromosomeEstimation < 0.5) && (dataset->M[i][0] == 1))
-                || ((chromosomeEstimation >= 0.5) && (dataset->M[i][0] == 0)))
-              fitness += epsilon;
-            break;
-        }
+        // Incrementa em fitness a parcela de erro ocorrido na amostra i, tantas vezes
+        // quanto o seu peso
+        error = sampleError(dataset->M[i][0], chromosomeEstimation);
+        fitness += weight ? weight[i] * error : error;
       }
       break;  // case ModelType::LINEAR
 
@@ -79,6 +89,7 @@ double GASA::calculateChromosomeFitness(const Chromosome &chromosome) {
       independentVariablesNumber = (geneSize - 1) / 2;
 
       for (int32_t i = 0; i < dataset->rowN; ++i) {
+        if (weight && (weight[i] == 0)) continue;  // Fora da reamostragem
         chromosomeEstimation = 0;
 
         // Para todas as variáveis independentes
@@ -113,29 +124,10 @@ double GASA::calculateChromosomeFitness(const Chromosome &chromosome) {
         // fmt::print("({}) Chromosome estimation: {}\n", graph->node[i].nodeId,
         // chromosomeEstimation);
 
-        // Incrementa em fitness a parcela de erro ocorrido na amostra i
-        switch (objectiveFunction) {
-          case ObjectiveType::MINSQT:  // MINSQT = Minimizar a soma do quadrado dos desvios (todos
-                                       // os modelos)
-            fitness += pow((dataset->M[i][0] - chromosomeEstimation), 2);
-            break;
-          case ObjectiveType::MINERR:  // MINERR = Minimizar a quantidade de erros de
-                                       // Omissão/Comissão (Dist. de espécies)
-            // Avaliado como ausência mas era presença (False Negative = Omission
-            // Error) ou Avaliado como presença mas era ausência ((False Positive =
-            // Comission Error)
-            if (((chromosomeEstimation < 0.5) && (dataset->M[i][0] == 1))
-                || ((chromosomeEstimation >= 0.5) && (dataset->M[i][0] == 0)))
-              ++fitness;
-            break;
-          case ObjectiveType::MINBOTH:  // MINBOTH = Minimizar tanto o SQT quanto os erros de
-                                        // Omissão/Comissão (Dist. de espécies)
-            fitness += pow((dataset->M[i][0] - chromosomeEstimation), 2);
-            if (((chromosomeEstimation < 0.5) && (dataset->M[i][0] == 1))
-                || ((chromosomeEstimation >= 0.5) && (dataset->M[i][0] == 0)))
-              fitness += epsilon;
-            break;
-        }
+        // Incrementa em fitness a parcela de erro ocorrido na amostra i, tantas vezes
+        // quanto o seu peso
+        error = sampleError(dataset->M[i][0], chromosomeEstimation);
+        fitness += weight ? weight[i] * error : error;
       }
       break;  // case ModelType::QUADRATIC
 
@@ -146,6 +138,7 @@ double GASA::calculateChromosomeFitness(const Chromosome &chromosome) {
 
       // Para todos os dados de entrada
       for (int32_t i = 0; i < dataset->rowN; ++i) {
+        if (weight && (weight[i] == 0)) continue;  // Fora da reamostragem
         chromosomeEstimation = 0;
         // Acumulando as contribuições em Y = (Coeficiente * Variável
         // Independente)
@@ -177,29 +170,10 @@ double GASA::calculateChromosomeFitness(const Chromosome &chromosome) {
         // Acumula a contribuição do termo espacial --> lambda * average dos Y[i]
         chromosomeEstimation += (chromosome.genes[geneSize - 1].value * average);
 
-        // Incrementa em fitness a parcela de erro ocorrido na amostra i
-        switch (objectiveFunction) {
-          case ObjectiveType::MINSQT:  // MINSQT = Minimizar a soma do quadrado dos desvios (todos
-                                       // os modelos)
-            fitness += pow((dataset->M[i][0] - chromosomeEstimation), 2);
-            break;
-          case ObjectiveType::MINERR:  // MINERR = Minimizar a quantidade de erros de
-                                       // Omissão/Comissão (Dist. de espécies)
-            // Avaliado como ausência mas era presença (False Negative = Omission
-            // Error) ou Avaliado como presença mas era ausência ((False Positive =
-            // Comission Error)
-            if (((chromosomeEstimation < 0.5) && (dataset->M[i][0] == 1))
-                || ((chromosomeEstimation >= 0.5) && (dataset->M[i][0] == 0)))
-              ++fitness;
-            break;
-          case ObjectiveType::MINBOTH:  // MINBOTH = Minimizar tanto o SQT quanto os erros de
-                                        // Omissão/Comissão (Dist. de espécies)
-            fitness += pow((dataset->M[i][0] - chromosomeEstimation), 2);
-            if (((chromosomeEstimation < 0.5) && (dataset->M[i][0] == 1))
-                || ((chromosomeEstimation >= 0.5) && (dataset->M[i][0] == 0)))
-              fitness += epsilon;
-            break;
-        }
+        // Incrementa em fitness a parcela de erro ocorrido na amostra i, tantas vezes
+        // quanto o seu peso
+        error = sampleError(dataset->M[i][0], chromosomeEstimation);
+        fitness += weight ? weight[i] * error : error;
       }
       break;  // case LAG
   }           // end switch
@@ -526,6 +500,9 @@ void GASA::createPopulation() {
   population.resize(populationSize);
   for (int32_t i = 0; i < populationSize; ++i)
     population[i] = createChromosome(geneSize, chromosomeFormat);
+
+  // Partida a quente: o primeiro indivíduo é a solução informada
+  for (size_t i = 0; i < initialGenes.size(); ++i) population[0].genes[i].value = initialGenes[i];
 }
 
 //----------------------------------------------------------------------------------------------
@@ -547,6 +524,8 @@ GASA *GASA::run() {
 
     population[0] = bestChromosome;  // Restaura o melhor indivíduo pois o SA pode tê-lo modificado
     resetCurrentTemperature();       // Reinicializa --> TAtual = TMax
+
+    if (progress) progress(i + 1, maxGenerations, bestChromosome.fitness);
   }
 
   return this;
@@ -561,6 +540,36 @@ GASA *GASA::setEpsilon(const float &epsilon) {
   return (this);
 }
 
+//----------------------------------------------------------------------------------------------
+// Weight of every row of the dataset in the fitness, e.g. how many times a bootstrap sample
+// drew it. Rows weighing 0 are left out but still count as neighbors in the MPG.
+//----------------------------------------------------------------------------------------------
+GASA *GASA::setWeights(std::shared_ptr<const std::vector<double>> weights) {
+  if (weights && ((int32_t)weights->size() != dataset->rowN))
+    throw std::runtime_error(fmt::format("{} weights for {} rows", weights->size(), dataset->rowN));
+  this->weights = std::move(weights);
+  return (this);
+}
+
+//----------------------------------------------------------------------------------------------
+// Starts the search from a known solution (warm start), which joins the initial population.
+//----------------------------------------------------------------------------------------------
+GASA *GASA::setInitialChromosome(const std::vector<double> &genes) {
+  if ((int32_t)genes.size() != geneSize)
+    throw std::runtime_error(
+        fmt::format("{} genes for a chromosome of {}", genes.size(), geneSize));
+  initialGenes = genes;
+  return (this);
+}
+
+//----------------------------------------------------------------------------------------------
+// Function called after every generation, e.g. to report the progress of long runs.
+//----------------------------------------------------------------------------------------------
+GASA *GASA::setProgress(Progress progress) {
+  this->progress = std::move(progress);
+  return (this);
+}
+
 //----------------------------------------------------------------------------------------------
 // Ajusta o parâmetro taxa de mutação utilizado no AG.
 //----------------------------------------------------------------------------------------------
@@ -738,14 +747,13 @@ GASA *GASA::setSAHGAParameters(const SAHGAParameter &parameters) {
 
 //----------------------------------------------------------------------------------------------
 // Construtor do Algoritmo Híbrido (AG/SA). Prepara variáveis de controle.
+// graph and dataset are only read, so any number of runs may share them.
 //----------------------------------------------------------------------------------------------
-GASA::GASA(const Graph &graph, const Dataset &dataset, const ModelType &modelType,
-           const ObjectiveType &objectiveFunction)
-    : _random(std::make_unique<Random>(.0, 1.)) {
-  this->graph = new Graph();
-  this->graph->copy(graph);
-  this->dataset = new Dataset();
-  this->dataset->copy(dataset);
+GASA::GASA(std::shared_ptr<const Graph> graph, std::shared_ptr<const Dataset> dataset,
+           const ModelType &modelType, const ObjectiveType &objectiveFunction)
+    : _random(std::make_unique<Random>(.0, 1.)),
+      graph(std::move(graph)),
+      dataset(std::move(dataset)) {
   this->modelType = modelType;
   this->objectiveFunction = objectiveFunction;
   bestChromosome.fitness = 1e100;  // Para maximizar (-1e100); Para minimizar (1e100)
@@ -753,28 +761,42 @@ GASA::GASA(const Graph &graph, const Dataset &dataset, const ModelType &modelTyp
   switch (modelType) {
     case ModelType::LINEAR: {  // Modelo linear --> sem vizinhança
       // #Variáveis independentes + 1 --> (#coeficientes + constante) do modelo
-      geneSize = dataset.colN;
+      geneSize = this->dataset->colN;
       break;
     }
     case ModelType::QUADRATIC: {  // Modelo quadrático --> sem vizinhança
       //(2 * #Variáveis independentes + 1)
-      geneSize = 2 * dataset.colN - 1;
+      geneSize = 2 * this->dataset->colN - 1;
       break;
     }
     case ModelType::LAG: {  // Modelo de Regressão Espacial
       //#Variáveis independentes + 2 --> #coeficientes + constante + lambda
-      geneSize = dataset.colN + 1;
+      geneSize = this->dataset->colN + 1;
       break;
     }
   }
 }
 
+//----------------------------------------------------------------------------------------------
+// Construtor do Algoritmo Híbrido (AG/SA) que assume a posse do grafo e dos dados.
+//----------------------------------------------------------------------------------------------
+GASA::GASA(Graph &&graph, Dataset &&dataset, const ModelType &modelType,
+           const ObjectiveType &objectiveFunction)
+    : GASA(std::make_shared<const Graph>(std::move(graph)),
+           std::make_shared<const Dataset>(std::move(dataset)), modelType, objectiveFunction) {}
+
+//----------------------------------------------------------------------------------------------
+// Construtor do Algoritmo Híbrido (AG/SA) que trabalha sobre cópias do grafo e dos dados.
+//----------------------------------------------------------------------------------------------
+GASA::GASA(const Graph &graph, const Dataset &dataset, const ModelType &modelType,
+           const ObjectiveType &objectiveFunction)
+    : GASA(std::make_shared<const Graph>(graph), std::make_shared<const Dataset>(dataset),
+           modelType, objectiveFunction) {}
+
 //----------------------------------------------------------------------------------------------
 // Destrutor do Algoritmo Híbrido (AG/SA).
 //----------------------------------------------------------------------------------------------
 GASA::~GASA() {
   chromosomeFormat.clear();
   population.clear();
-  delete dataset;
-  delete graph;
 }
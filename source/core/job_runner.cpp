@@ -0,0 +1,279 @@
+#include <fmt/format.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sahga/core/job_runner.hpp>
+#include <sahga/utils/mapped_file.hpp>
+#include <sahga/utils/parallel.hpp>
+#include <sahga/utils/tokenizer.hpp>
+#include <sahga/utils/utils.hpp>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+// Peak resident memory of the process so far.
+static size_t peakMemory() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+  return (size_t)usage.ru_maxrss * 1024;  // Kilobytes on Linux
+}
+
+//----------------------------------------------------------------------------------------------
+// Queue
+//----------------------------------------------------------------------------------------------
+
+// The value of names matching text (case insensitive), or throws naming the field.
+template <typename T>
+static T parseName(const std::map<std::string, T> &names, const std::string &text,
+                   const std::string &field) {
+  auto found = names.find(Utils::miscellaneous::upperCase(text));
+  if (found == names.end()) throw std::runtime_error(fmt::format("Unknown {} {}", field, text));
+  return found->second;
+}
+
+void JobRunner::setField(Job &job, const std::string &key, const std::string &value,
+                         const std::string &folder) {
+  static const std::map<std::string, GASA::ModelType> modelTypes
+      = {{"LINEAR", GASA::ModelType::LINEAR},
+         {"QUADRATIC", GASA::ModelType::QUADRATIC},
+         {"LAG", GASA::ModelType::LAG}};
+  static const std::map<std::string, GASA::ObjectiveType> objectiveTypes
+      = {{"MINSQT", GASA::ObjectiveType::MINSQT},
+         {"MINERR", GASA::ObjectiveType::MINERR},
+         {"MINBOTH", GASA::ObjectiveType::MINBOTH}};
+  static const std::map<std::string, GASA::SAHGAParameter> parameters
+      = {{"DEFAULT", GASA::SAHGAParameter::DEFAULT}, {"FAST", GASA::SAHGAParameter::FAST},
+         {"HARD", GASA::SAHGAParameter::HARD},       {"ULTRA", GASA::SAHGAParameter::ULTRA},
+         {"HIGHPOP", GASA::SAHGAParameter::HIGHPOP}};
+  static const std::map<std::string, Graph::MPGTypes> mpgTypes
+      = {{"HALFRADIUM", Graph::MPGTypes::HALFRADIUM},
+         {"UMBD", Graph::MPGTypes::UMBD},
+         {"UMBD2", Graph::MPGTypes::UMBD2},
+         {"KNN", Graph::MPGTypes::KNN},
+         {"KNNIDW", Graph::MPGTypes::KNNIDW}};
+  static const std::map<std::string, Utils::binary::Encoding> encodings
+      = {{"FLOAT64", Utils::binary::Encoding::FLOAT64},
+         {"FLOAT32", Utils::binary::Encoding::FLOAT32},
+         {"INT16", Utils::binary::Encoding::INT16},
+         {"UINT16", Utils::binary::Encoding::UINT16}};
+
+  auto resolve = [&folder](const std::string &path) {
+    if (std::filesystem::path(path).is_absolute()) return path;
+    return (std::filesystem::path(folder) / path).string();
+  };
+
+  try {
+    if (key == "name") {
+      // A folder of its own inside the user's jobs folder, never a path out of it
+      if (value.empty() || (value == ".") || (value.find_first_of("/\\") != std::string::npos)
+          || (value.find("..") != std::string::npos))
+        throw std::runtime_error(fmt::format("Bad name {}", value));
+      job.name = value;
+    } else if (key == "user") {
+      if (value.empty() || (value.find_first_not_of("0123456789") != std::string::npos))
+        throw std::runtime_error(fmt::format("Bad user {}", value));
+      job.userId = std::stoi(value);
+    } else if (key == "points") {
+      job.points = resolve(value);
+    } else if (key == "layers") {
+      job.layers = resolve(value);
+    } else if (key == "model") {
+      job.modelType = parseName(modelTypes, value, "model");
+    } else if (key == "objective") {
+      job.objectiveType = parseName(objectiveTypes, value, "objective");
+    } else if (key == "parameters") {
+      job.parameters = parseName(parameters, value, "parameters");
+    } else if (key == "mpg") {
+      job.mpgType = parseName(mpgTypes, value, "MPG");
+    } else if (key == "radius") {
+      job.radius = std::stod(value);
+    } else if (key == "ratio") {
+      job.ratio = std::stod(value);
+    } else if (key == "level") {
+      job.level = std::stoi(value);
+    } else if (key == "quantization") {
+      job.quantization = parseName(encodings, value, "quantization");
+    } else if (key == "bootstrap") {
+      job.bootstrap = std::stoi(value);
+    } else {
+      throw std::runtime_error(fmt::format("Unknown key {}", key));
+    }
+  } catch (const std::logic_error &) {  // stoi/stod
+    throw std::runtime_error(fmt::format("Bad {} {}", key, value));
+  }
+}
+
+std::vector<JobRunner::Job> JobRunner::readQueue(const std::string &fileName) {
+  const std::string folder = std::filesystem::path(fileName).parent_path().string();
+
+  MappedFile file(fileName);
+  const std::vector<std::string_view> lines
+      = Utils::parsing::lines(std::string_view(file.data(), file.size()));
+
+  std::vector<Job> jobs;
+  for (size_t i = 0; i < lines.size(); ++i) {
+    Utils::parsing::Tokenizer tokens(lines[i], ' ');
+    std::string_view token;
+    if (!tokens.next(token) || (token[0] == '#')) continue;
+
+    Job job;
+    job.name = fmt::format("job-{:03}", jobs.size() + 1);
+    do {
+      const size_t equals = token.find('=');
+      if (equals == std::string_view::npos)
+        throw std::runtime_error(
+            fmt::format("{}:{}: expected key=value, got {}", fileName, i + 1, token));
+
+      const std::string key(token.substr(0, equals)), value(token.substr(equals + 1));
+      try {
+        setField(job, key, value, folder);
+      } catch (const std::runtime_error &e) {
+        throw std::runtime_error(fmt::format("{}:{}: {}", fileName, i + 1, e.what()));
+      }
+    } while (tokens.next(token));
+
+    if (job.points.empty() || job.layers.empty())
+      throw std::runtime_error(
+          fmt::format("{}:{}: a job needs points and layers", fileName, i + 1));
+    jobs.push_back(job);
+  }
+
+  return jobs;
+}
+
+//----------------------------------------------------------------------------------------------
+// Runner
+//----------------------------------------------------------------------------------------------
+
+JobRunner::JobRunner(const std::string &usersFolder, int32_t workers, size_t tileCapacity,
+                     const std::string &derivedFolder)
+    : _usersFolder(usersFolder),
+      _workers(std::max(workers, 1)),
+      _layers(std::make_shared<LayerCache>(tileCapacity, derivedFolder)) {}
+
+std::vector<JobRunner::Report> JobRunner::run(const std::vector<Job> &jobs) {
+  std::set<std::pair<int32_t, std::string>> names;
+  for (const Job &job : jobs)
+    if (!names.insert({job.userId, job.name}).second)
+      throw std::runtime_error(fmt::format("Job {} of user {} is queued twice", job.name,
+                                           job.userId));
+
+  // Each worker takes the next job until none is left, so at most _workers run at once.
+  // The stages of the jobs still share the global executor.
+  std::vector<Report> reports(jobs.size());
+  std::atomic<size_t> next(0);
+  auto work = [&]() {
+    for (size_t i = next++; i < jobs.size(); i = next++) reports[i] = runJob(jobs[i]);
+  };
+
+  std::vector<std::thread> workers;
+  for (int32_t i = 1; i < std::min<int64_t>(_workers, jobs.size()); ++i) workers.emplace_back(work);
+  work();
+  for (std::thread &worker : workers) worker.join();
+
+  return reports;
+}
+
+void JobRunner::addStages(Utils::parallel::TaskGraph &stages, Pipeline &pipeline, const Job &job,
+                          const std::string &output) {
+  // The same stages as SAHGACore, generateMPG and extractLayers side by side
+  const int32_t split = stages.add("separateTrainTest", [&pipeline, &job]() {
+    pipeline.separateTrainTest(job.points, job.ratio);
+  });
+  const int32_t mpg = stages.add(
+      "generateMPG", [&pipeline, &job]() { pipeline.generateMPG(job.radius, job.mpgType); },
+      {split});
+  const int32_t layers = stages.add(
+      "extractLayers", [&pipeline, &job]() { pipeline.extractLayers(job.layers, job.level); },
+      {split});
+  const int32_t merge
+      = stages.add("mergeData", [&pipeline]() { pipeline.mergeData(); }, {mpg, layers});
+  const int32_t fit = stages.add(
+      "adjustModel",
+      [&pipeline, &job]() {
+        pipeline.adjustModel(job.modelType, job.objectiveType, true, job.parameters);
+      },
+      {merge});
+  if (!output.empty())
+    stages.add(
+        "predict",
+        [&pipeline, &job, output]() { pipeline.predict(job.layers, output, job.level); }, {fit});
+  stages.add(
+      "evaluate", [&pipeline, &job]() { pipeline.evaluate(job.layers, job.level); }, {fit});
+  if (job.bootstrap > 0)
+    stages.add("bootstrap", [&pipeline, &job]() { pipeline.bootstrap(job.bootstrap); }, {fit});
+}
+
+JobRunner::Report JobRunner::runJob(const Job &job) const {
+  using Clock = std::chrono::steady_clock;
+  const Clock::time_point start = Clock::now();
+
+  const std::filesystem::path user = std::filesystem::path(_usersFolder)
+                                     / fmt::format("{:04}", job.userId);
+  const std::filesystem::path folder = user / "jobs" / job.name;
+
+  Report report{job.name, folder.string(), job.userId, true, "", 0, 0, 0, NAN, ""};
+
+  Utils::parallel::TaskGraph stages;
+  std::unique_ptr<Pipeline> pipeline;
+  try {
+    pipeline = std::make_unique<Pipeline>(folder.string());
+    pipeline->useCache((user / "cache").string())
+        ->shareLayers(_layers)
+        ->quantizeLayers(job.quantization);
+
+    addStages(stages, *pipeline, job, (folder / "suitability.asc").string());
+    stages.run();
+  } catch (const std::exception &e) {
+    report.ok = false;
+    report.error = e.what();
+  }
+
+  report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  report.dataBytes = pipeline ? pipeline->bytes() : 0;
+  report.peakBytes = peakMemory();
+  report.stages = stages.report();
+  if (report.ok) report.auc = pipeline->evaluation.auc;
+
+  if (pipeline) {
+    std::ofstream os((folder / "report.txt").string());
+    os << fmt::format("Job {} of user {}: {}\n", job.name, job.userId,
+                      report.ok ? "done" : "failed: " + report.error);
+    os << fmt::format("Wall {:.3f} s, data {:.1f} KB, process peak {:.1f} MB\n\n",
+                      report.seconds, report.dataBytes / 1024.0, report.peakBytes / 1048576.0);
+    os << report.stages;
+    if (report.ok) os << '\n' << pipeline->evaluation.report();
+  }
+
+  // Layer sets no other job holds are opened again by the next job that needs them
+  pipeline.reset();
+  _layers->trim();
+
+  return report;
+}
+
+std::string JobRunner::summary(const std::vector<Report> &reports) {
+  size_t width = 3;
+  for (const Report &report : reports) width = std::max(width, report.name.size());
+
+  std::string text
+      = fmt::format("{:<{}}  {:>4}  {:>9}  {:>9}  {:>9}  {:>6}  {}\n", "Job", width, "User",
+                    "Time (s)", "Data (KB)", "Peak (MB)", "AUC", "Status");
+  int32_t failed = 0;
+  for (const Report &report : reports) {
+    failed += !report.ok;
+    text += fmt::format("{:<{}}  {:>4}  {:>9.3f}  {:>9.1f}  {:>9.1f}  {:>6.3f}  {}\n", report.name,
+                        width, report.userId, report.seconds, report.dataBytes / 1024.0,
+                        report.peakBytes / 1048576.0, report.auc,
+                        report.ok ? "done" : report.error);
+  }
+
+  text += fmt::format("{} jobs, {} failed\n", reports.size(), failed);
+  return text;
+}
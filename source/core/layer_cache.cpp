@@ -0,0 +1,268 @@
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <sahga/core/layer_cache.hpp>
+#include <sahga/utils/parallel.hpp>
+#include <sahga/utils/quantize.hpp>
+#include <sahga/utils/utils.hpp>
+
+std::map<std::string, std::filesystem::path> LayerCache::sources(const std::string &folderName) {
+  std::map<std::string, std::filesystem::path> layerFiles;
+  for (const auto &entry : std::filesystem::directory_iterator(folderName)) {
+    const std::filesystem::path &path = entry.path();
+    const std::string extension = Utils::miscellaneous::upperCase(path.extension().string());
+    if (extension == ".ASC") {
+      layerFiles[path.stem().string()] = path;
+    } else if (extension == ".SDR") {
+      layerFiles.emplace(path.stem().string(), path);
+    }
+  }
+
+  return layerFiles;
+}
+
+/*
+ * Folder of the rasters, overviews and stacks derived from the layers in folderName:
+ * folderName itself, or one of its own in the derived folder of the cache (named after
+ * folderName and a hash of its full path, so folders of the same name do not mix).
+ * Quantized layers go to a subfolder named after their encoding, e.g. `INT16`.
+ * */
+std::filesystem::path LayerCache::derivedFolder(const std::string &folderName,
+                                                Utils::binary::Encoding quantization) const {
+  std::filesystem::path folder = folderName;
+  if (!_derivedFolder.empty()) {
+    const std::string canonical = std::filesystem::canonical(folderName).string();
+    folder = std::filesystem::path(_derivedFolder)
+             / fmt::format("{}-{:016x}", std::filesystem::path(canonical).filename().string(),
+                           Utils::miscellaneous::hash(canonical.data(), canonical.size()));
+  }
+
+  if (quantization == Utils::binary::Encoding::FLOAT64) return folder;
+  return folder / Utils::quantize::name(quantization);
+}
+
+/*
+ * Folder of the overviews of the layers in folderName at level (1 = 2x, 2 = 4x, ...);
+ * level 0 is the derived folder itself. Every level is a layers folder of its own, so it
+ * is sampled and stacked like the base one.
+ * */
+std::filesystem::path LayerCache::overviewFolder(const std::string &folderName, int32_t level,
+                                                 Utils::binary::Encoding quantization) const {
+  const std::filesystem::path derived = derivedFolder(folderName, quantization);
+  if (level <= 0) return derived;
+  return derived / "overviews" / fmt::format("{}x", 1 << level);
+}
+
+/*
+ * The tiled raster fileName, written again by make when it is missing, older than the
+ * source it comes from, unreadable (e.g. from an older version of the format) or written
+ * with another quantization.
+ * */
+static std::unique_ptr<TiledRaster> openRaster(const std::filesystem::path &source,
+                                               const std::filesystem::path &fileName,
+                                               std::shared_ptr<TileCache> cache,
+                                               Utils::binary::Encoding quantization,
+                                               const std::function<void()> &make) {
+  std::error_code error;
+  const auto written = std::filesystem::last_write_time(fileName, error);
+  if (!error && !(written < std::filesystem::last_write_time(source))) {
+    try {
+      auto raster = std::make_unique<TiledRaster>(fileName.string(), cache);
+      if (raster->header().quantization == quantization) return raster;
+    } catch (const std::runtime_error &) {
+      // Rebuilt below
+    }
+  }
+
+  make();
+  return std::make_unique<TiledRaster>(fileName.string(), cache);
+}
+
+/*
+ * Every layer in folderName as a tiled raster (.sdr), in name order. ASCII grids are
+ * converted into the derived folder the first time, whenever the grid is newer than its
+ * raster or when the raster does not open. Layers are converted and opened concurrently
+ * and share cache, so memory does not grow with the number or size of the layers.
+ * */
+static std::vector<std::unique_ptr<TiledRaster>> openLayers(
+    const LayerCache &layerCache, const std::string &folderName, std::shared_ptr<TileCache> cache,
+    Utils::binary::Encoding quantization) {
+  std::vector<std::filesystem::path> paths;
+  for (const auto &layerFile : LayerCache::sources(folderName)) paths.push_back(layerFile.second);
+
+  const std::filesystem::path folder = layerCache.derivedFolder(folderName, quantization);
+  std::filesystem::create_directories(folder);
+
+  std::vector<std::unique_ptr<TiledRaster>> layers(paths.size());
+  Utils::parallel::forChunks(0, paths.size(), 1, [&](int32_t, int64_t begin, int64_t end) {
+    for (int64_t j = begin; j < end; ++j) {
+      // Layers given as tiled rasters are used as they are
+      if (Utils::miscellaneous::upperCase(paths[j].extension().string()) == ".SDR") {
+        layers[j] = std::make_unique<TiledRaster>(paths[j].string(), cache);
+        continue;
+      }
+
+      const std::filesystem::path tiled = folder / (paths[j].stem().string() + ".sdr");
+      layers[j] = openRaster(paths[j], tiled, cache, quantization, [&]() {
+        TiledRaster::convert(paths[j].string(), tiled.string(), 256, true, quantization);
+      });
+    }
+  });
+
+  return layers;
+}
+
+/*
+ * The overviews at level of the layers in folderName, each one built from its layer one
+ * level below when it is missing, older than it or unreadable.
+ * */
+static std::vector<std::unique_ptr<TiledRaster>> openOverviews(
+    const LayerCache &layerCache, const std::string &folderName,
+    const std::vector<std::unique_ptr<TiledRaster>> &below, std::shared_ptr<TileCache> cache,
+    int32_t level, Utils::binary::Encoding quantization) {
+  const std::filesystem::path folder = layerCache.overviewFolder(folderName, level, quantization);
+  std::filesystem::create_directories(folder);
+
+  std::vector<std::unique_ptr<TiledRaster>> layers(below.size());
+  Utils::parallel::forChunks(0, layers.size(), 1, [&](int32_t, int64_t begin, int64_t end) {
+    for (int64_t j = begin; j < end; ++j) {
+      const std::string source = below[j]->fileName();
+      const std::filesystem::path target = folder / (below[j]->layerName + ".sdr");
+      layers[j] = openRaster(source, target, cache, quantization, [&]() {
+        TiledRaster::overview(source, target.string(), true, quantization);
+      });
+    }
+  });
+
+  return layers;
+}
+
+/*
+ * The layer stack of layers stored in fileName, built again when it is missing, older
+ * than any of the layers, unreadable or holding other bands.
+ * */
+static std::unique_ptr<LayerStack> openLayerStack(
+    const std::vector<std::unique_ptr<TiledRaster>> &layers, const std::string &fileName) {
+  std::vector<std::string> names;
+  bool stale = !std::filesystem::exists(fileName);
+  for (const auto &layer : layers) {
+    names.push_back(layer->layerName);
+    if (!stale)
+      stale = std::filesystem::last_write_time(fileName)
+              < std::filesystem::last_write_time(layer->fileName());
+  }
+
+  if (!stale) {
+    try {
+      auto stack = std::make_unique<LayerStack>(fileName);
+      if (stack->names() == names) return stack;
+    } catch (const std::runtime_error &) {
+      // An older version or a damaged stack: built again below
+    }
+  }
+
+  std::vector<const TiledRaster *> bands;
+  for (const auto &layer : layers) bands.push_back(layer.get());
+  LayerStack::build(bands, fileName);
+
+  return std::make_unique<LayerStack>(fileName);
+}
+
+//----------------------------------------------------------------------------------------------
+// Cache
+//----------------------------------------------------------------------------------------------
+
+LayerCache::LayerCache(size_t tileCapacity, const std::string &derivedFolder)
+    : _tiles(std::make_shared<TileCache>(tileCapacity)), _derivedFolder(derivedFolder) {}
+
+/*
+ * The layers of folderName at level, quantized as asked. Every set is loaded once: the
+ * first get of a set loads it, and the others wait for that one, holding no lock
+ * meanwhile, so loading may spread over the executor however many jobs ask for the same
+ * layers. A set that fails
+ * to load is forgotten, and the next get tries again.
+ * */
+std::shared_ptr<const LayerCache::Layers> LayerCache::get(const std::string &folderName,
+                                                          int32_t level,
+                                                          Utils::binary::Encoding quantization) {
+  const Key key(std::filesystem::canonical(folderName).string(), level, quantization);
+  std::promise<std::shared_ptr<const Layers>> promise;
+  std::shared_future<std::shared_ptr<const Layers>> loading;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto found = _sets.find(key);
+    if (found != _sets.end()) {
+      loading = found->second;
+    } else {
+      _sets.emplace(key, promise.get_future().share());
+    }
+  }
+  if (loading.valid()) return loading.get();
+
+  try {
+    std::shared_ptr<const Layers> loaded = load(folderName, level, quantization);
+    promise.set_value(loaded);
+    return loaded;
+  } catch (...) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _sets.erase(key);
+    }
+    promise.set_exception(std::current_exception());
+    throw;
+  }
+}
+
+/*
+ * Opens the layers of folderName at level, the overviews from the set one level below,
+ * and stacks them when they share their grid.
+ * */
+std::shared_ptr<const LayerCache::Layers> LayerCache::load(const std::string &folderName,
+                                                           int32_t level,
+                                                           Utils::binary::Encoding quantization) {
+  auto loaded = std::make_shared<Layers>();
+  if (level > 0) {
+    const std::shared_ptr<const Layers> below = get(folderName, level - 1, quantization);
+    loaded->rasters
+        = openOverviews(*this, folderName, below->rasters, _tiles, level, quantization);
+  } else {
+    loaded->rasters = openLayers(*this, folderName, _tiles, quantization);
+  }
+
+  const auto &rasters = loaded->rasters;
+  const bool stacked
+      = !rasters.empty() && std::all_of(rasters.begin(), rasters.end(), [&](const auto &raster) {
+          return LayerStack::sameGrid(rasters[0]->header(), raster->header());
+        });
+  if (stacked) {
+    const std::filesystem::path folder = overviewFolder(folderName, level, quantization);
+    loaded->stack = openLayerStack(rasters, (folder / "layers.sdc").string());
+  }
+
+  return loaded;
+}
+
+// Sets still loading are kept, as are those a pipeline holds.
+size_t LayerCache::trim() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  size_t dropped = 0;
+  for (auto it = _sets.begin(); it != _sets.end();) {
+    const bool ready
+        = it->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    if (ready && (it->second.get().use_count() == 1)) {
+      it = _sets.erase(it);
+      ++dropped;
+    } else {
+      ++it;
+    }
+  }
+
+  return dropped;
+}
+
+size_t LayerCache::size() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _sets.size();
+}
@@ -0,0 +1,48 @@
+#include <sahga/core/memory_cache.hpp>
+
+MemoryCache::MemoryCache(size_t budget) : _budget(budget), _size(0), _hits(0), _misses(0) {}
+
+std::shared_ptr<const void> MemoryCache::find(uint64_t key) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto it = _entries.find(key);
+  if (it == _entries.end()) {
+    ++_misses;
+    return nullptr;
+  }
+
+  _order.splice(_order.begin(), _order, it->second.order);
+  ++_hits;
+  return it->second.value;
+}
+
+void MemoryCache::insert(uint64_t key, std::shared_ptr<const void> value, size_t bytes) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto it = _entries.find(key);
+  if (it != _entries.end()) {
+    _size -= it->second.bytes;
+    _order.erase(it->second.order);
+    _entries.erase(it);
+  }
+
+  _order.push_front(key);
+  _entries.emplace(key, Entry{std::move(value), bytes, _order.begin()});
+  _size += bytes;
+
+  // The newest value stays even when it alone is over budget
+  while ((_size > _budget) && (_order.size() > 1)) {
+    auto last = _entries.find(_order.back());
+    _size -= last->second.bytes;
+    _entries.erase(last);
+    _order.pop_back();
+  }
+}
+
+size_t MemoryCache::size() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _size;
+}
+
+size_t MemoryCache::count() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _entries.size();
+}
@@ -0,0 +1,595 @@
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <sahga/core/pipeline.hpp>
+#include <sahga/utils/parallel.hpp>
+#include <sahga/utils/read.hpp>
+#include <sahga/utils/tokenizer.hpp>
+#include <sahga/utils/utils.hpp>
+#include <stdexcept>
+#include <tuple>
+
+Pipeline::Pipeline(const std::string &folder)
+    : folder(folder),
+      intermediates(false),
+      radius(5),
+      mpgType(Graph::MPGTypes::HALFRADIUM),
+      neighbors(Graph().neighbors),
+      splitKey("split"),
+      mpgKey("mpg"),
+      layersKey("layers"),
+      layerCache(std::make_shared<LayerCache>()),
+      quantization(Utils::binary::Encoding::FLOAT64),
+      fitObjective(GASA::ObjectiveType::MINBOTH),
+      fitParameters(GASA::SAHGAParameter::HIGHPOP) {
+  std::filesystem::create_directories(folder);
+}
+
+Pipeline *Pipeline::keepIntermediates(bool keep) {
+  intermediates = keep;
+  return this;
+}
+
+Pipeline *Pipeline::useCache(const std::string &cacheFolder) {
+  cache = std::make_shared<StageCache>(cacheFolder);
+  return this;
+}
+
+Pipeline *Pipeline::shareLayers(std::shared_ptr<LayerCache> layers) {
+  layerCache = std::move(layers);
+  return this;
+}
+
+Pipeline *Pipeline::useMemory(std::shared_ptr<MemoryCache> memory) {
+  this->memory = std::move(memory);
+  return this;
+}
+
+Pipeline *Pipeline::quantizeLayers(Utils::binary::Encoding quantization) {
+  this->quantization = quantization;
+  return this;
+}
+
+Pipeline *Pipeline::onGeneration(GASA::Progress progress) {
+  this->progress = std::move(progress);
+  return this;
+}
+
+Pipeline *Pipeline::onRestore(std::function<void(const std::string &stage)> restored) {
+  this->restored = std::move(restored);
+  return this;
+}
+
+Pipeline *Pipeline::setNeighborhood(double radius, Graph::MPGTypes type, int32_t neighbors) {
+  this->radius = radius;
+  mpgType = type;
+  this->neighbors = neighbors;
+  return this;
+}
+
+std::string Pipeline::pathTo(const std::string &file) const {
+  return (std::filesystem::path(folder) / file).string();
+}
+
+static size_t datasetBytes(const Dataset &dataset) {
+  const int64_t lines
+      = (dataset.layout() == Dataset::Layout::ROW_MAJOR) ? dataset.rowN : dataset.colN;
+  return (size_t)(lines * dataset.stride()) * sizeof(double);
+}
+
+static size_t graphBytes(const Graph &graph) {
+  size_t total = 0;
+  for (const TNode &node : graph.node)
+    total += sizeof(TNode) + node.edge.capacity() * sizeof(TEdge);
+  return total;
+}
+
+size_t Pipeline::bytes() const {
+  size_t total = datasetBytes(train) + datasetBytes(test) + datasetBytes(layersData);
+  if (merged) total += datasetBytes(*merged);
+  if (fitted) total += datasetBytes(*fitted);
+  if (graph) total += graphBytes(*graph);
+
+  return total;
+}
+
+// The value of key kept in memory. Pipelines keeping intermediates skip it, as a hit in
+// memory writes nothing.
+template <typename T>
+std::shared_ptr<const T> Pipeline::recall(const StageCache::Key &key) const {
+  if (!memory || intermediates) return nullptr;
+  return memory->get<T>(key.value());
+}
+
+template <typename T>
+void Pipeline::keep(const StageCache::Key &key, T value, size_t bytes) const {
+  if (memory) memory->put(key.value(), std::make_shared<const T>(std::move(value)), bytes);
+}
+
+// Whether the files of key are cached; they are also copied out when keeping intermediates.
+bool Pipeline::restore(const StageCache::Key &key, const std::vector<std::string> &files) const {
+  if (!cache || !cache->contains(key, files)) return false;
+
+  if (intermediates)
+    for (const std::string &file : files)
+      std::filesystem::copy_file(cache->path(key, file), pathTo(file),
+                                 std::filesystem::copy_options::overwrite_existing);
+
+  if (restored) restored(key.name());
+  return true;
+}
+
+// Writes the output of a stage to the cache and, when keeping intermediates, to folder.
+void Pipeline::save(const StageCache::Key &key,
+                    const std::function<void(const std::string &folder)> &write) const {
+  if (cache) cache->store(key, write);
+  if (intermediates) write(folder);
+}
+
+//----------------------------------------------------------------------------------------------
+// Points
+//----------------------------------------------------------------------------------------------
+
+// #id;long;lat;presence of the point lines [begin, end), numbered from 1 (see TextFile).
+static void readPoints(const std::vector<std::string_view> &lines, size_t begin, size_t end,
+                       Dataset &points) {
+  points.reset(end - begin, 4);
+  points.names = {"id", "long", "lat", "presence"};
+
+  for (size_t i = begin; i < end; ++i) {
+    Utils::parsing::Tokenizer tokens(lines[i], '\t');
+    double value;
+    double *row = points.M[i - begin];
+
+    row[0] = (double)(i - begin + 1);
+    tokens.skip(2);
+    for (int32_t j = 1; (j < 4) && tokens.next(value); ++j) row[j] = value;
+  }
+}
+
+// The point lines [begin, end) renumbered from 1, after the header, as train.txt/test.txt.
+static void writePoints(const std::string &fileName, std::string_view header,
+                        const std::vector<std::string_view> &lines, size_t begin, size_t end) {
+  std::ofstream os(fileName);
+  os << header << '\n';
+  for (size_t i = begin; i < end; ++i) {
+    std::string_view line = lines[i];
+    os << (i + 1 - begin) << line.substr(std::min(line.find('\t'), line.size())) << '\n';
+  }
+
+  if (!os.good()) throw std::runtime_error(fmt::format("Failed to write {}", fileName));
+}
+
+/*
+ * Separate original dataset in Train and Test instances.
+ *
+ * @param { std::string } fileName - Path to the dataset (#id, label, long, lat, presence).
+ * @param { double } ratio - Percentage of the points that go to Train.
+ * @param { bool } stratify - Preserves the same proportions of examples in each class as
+ * observed in the original dataset.
+ * @param { uint32_t } seed - Seed of the shuffle; the same seed gives the same split.
+ * */
+Pipeline *Pipeline::separateTrainTest(const std::string &fileName, double ratio, bool stratify,
+                                      uint32_t seed) {
+  splitKey = StageCache::Key("split").addFile(fileName).add(ratio).add(stratify).add(seed);
+  source = fileName;
+
+  typedef std::pair<Dataset, Dataset> Split;
+  if (std::shared_ptr<const Split> kept = recall<Split>(splitKey)) {
+    std::tie(train, test) = *kept;
+    return this;
+  }
+
+  if (restore(splitKey, {"train.txt", "test.txt"})) {
+    ReadFile::Read(train, cache->path(splitKey, "train.txt"), '\t');
+    ReadFile::Read(test, cache->path(splitKey, "test.txt"), '\t');
+    train.names = test.names = {"id", "long", "lat", "presence"};
+    keep(splitKey, Split(train, test), datasetBytes(train) + datasetBytes(test));
+    return this;
+  }
+
+  MappedFile file(fileName);
+  std::vector<std::string_view> lines
+      = Utils::parsing::lines(std::string_view(file.data(), file.size()));
+  if (lines.empty()) throw std::runtime_error(fmt::format("{} is empty", fileName));
+
+  // Extract the header, then drop blank lines
+  const std::string_view header = lines.front();
+  lines.erase(lines.begin());
+  lines.erase(std::remove_if(lines.begin(), lines.end(),
+                             [](std::string_view line) { return line.empty(); }),
+              lines.end());
+
+  auto engine = std::default_random_engine{seed};
+  std::shuffle(lines.begin(), lines.end(), engine);
+
+  size_t trainSize = static_cast<size_t>(lines.size() * (ratio / 100));
+  if (stratify) {
+    // ratio% of every class goes to train, each side shuffled again to mix the classes
+    auto presence = [](std::string_view line) {
+      Utils::parsing::Tokenizer tokens(line, '\t');
+      double value = 0;
+      tokens.skip(4);
+      tokens.next(value);
+      return value;
+    };
+
+    std::map<double, std::vector<std::string_view>> classes;
+    for (std::string_view line : lines) classes[presence(line)].push_back(line);
+
+    std::vector<std::string_view> testLines;
+    lines.clear();
+    for (const auto &members : classes) {
+      const auto &group = members.second;
+      const size_t size = static_cast<size_t>(group.size() * (ratio / 100));
+      lines.insert(lines.end(), group.begin(), group.begin() + size);
+      testLines.insert(testLines.end(), group.begin() + size, group.end());
+    }
+
+    trainSize = lines.size();
+    std::shuffle(lines.begin(), lines.end(), engine);
+    std::shuffle(testLines.begin(), testLines.end(), engine);
+    lines.insert(lines.end(), testLines.begin(), testLines.end());
+  }
+
+  readPoints(lines, 0, trainSize, train);
+  readPoints(lines, trainSize, lines.size(), test);
+  keep(splitKey, Split(train, test), datasetBytes(train) + datasetBytes(test));
+
+  save(splitKey, [&](const std::string &target) {
+    writePoints((std::filesystem::path(target) / "train.txt").string(), header, lines, 0,
+                trainSize);
+    writePoints((std::filesystem::path(target) / "test.txt").string(), header, lines, trainSize,
+                lines.size());
+  });
+
+  return this;
+}
+
+//----------------------------------------------------------------------------------------------
+// Graph
+//----------------------------------------------------------------------------------------------
+
+Pipeline *Pipeline::generateMPG(double radius, Graph::MPGTypes type) {
+  this->radius = radius;
+  mpgType = type;
+  mpgKey = StageCache::Key("mpg").add(splitKey).add(radius).add(type);
+
+  if (std::shared_ptr<const Graph> kept = recall<Graph>(mpgKey)) {
+    graph = std::make_shared<Graph>(*kept);
+    neighbors = graph->neighbors;
+    return this;
+  }
+
+  graph = std::make_shared<Graph>();
+  neighbors = graph->neighbors;
+  if (restore(mpgKey, {"gpm.mpg"})) {
+    Dataset unused;
+    ReadFile::Read(*graph, unused, cache->path(mpgKey, "gpm.mpg"), ';');
+    keep(mpgKey, *graph, graphBytes(*graph));
+    return this;
+  }
+
+  graph->createMPG(train, radius, (int32_t)type);
+  keep(mpgKey, *graph, graphBytes(*graph));
+
+  save(mpgKey, [this](const std::string &target) {
+    graph->saveBinary((std::filesystem::path(target) / "gpm.mpg").string());
+  });
+  return this;
+}
+
+//----------------------------------------------------------------------------------------------
+// Layers
+//----------------------------------------------------------------------------------------------
+
+std::shared_ptr<const LayerCache::Layers> Pipeline::buildOverviews(
+    const std::string &folderName, int32_t levels, const std::string &derivedFolder,
+    Utils::binary::Encoding quantization) {
+  return LayerCache(64 << 20, derivedFolder).get(folderName, levels, quantization);
+}
+
+/*
+ * Samples every layer at the training points.
+ *
+ * @param { std::string } folderName - Folder of the layers.
+ * @param { int32_t } level - Overview level to sample (0 = full resolution).
+ * */
+Pipeline *Pipeline::extractLayers(const std::string &folderName, int32_t level) {
+  // Layers are known by the fingerprints of their source files and the encoding they are
+  // sampled from; entries written in an older .sds version get a new key
+  layersKey = StageCache::Key("layers")
+                  .add(splitKey)
+                  .add(level)
+                  .add((int32_t)quantization)
+                  .add(Utils::binary::DATASET_VERSION);
+  for (const auto &layerFile : LayerCache::sources(folderName))
+    layersKey.addFingerprint(layerFile.second.string());
+
+  if (std::shared_ptr<const Dataset> kept = recall<Dataset>(layersKey)) {
+    layersData = *kept;
+    return this;
+  }
+
+  if (restore(layersKey, {"layersData.sds"})) {
+    ReadFile::Read(layersData, cache->path(layersKey, "layersData.sds"), ';');
+    keep(layersKey, layersData, datasetBytes(layersData));
+    return this;
+  }
+
+  std::shared_ptr<const LayerCache::Layers> opened
+      = layerCache->get(folderName, level, quantization);
+  const std::vector<std::unique_ptr<TiledRaster>> &layers = opened->rasters;
+
+  // Columns --> #id;long;lat;presence;x0;x1;...;xn, kept at full precision. Stored
+  // column by column so each layer fills a contiguous column of its own.
+  layersData.reset(train.rowN, 4 + layers.size(), Dataset::Layout::COLUMN_MAJOR);
+  layersData.names = {"id", "long", "lat", "presence"};
+
+  for (const auto &layer : layers) layersData.names.push_back(layer->layerName);
+
+  for (int32_t j = 0; j < 4; ++j)
+    for (int32_t i = 0; i < train.rowN; ++i) layersData.at(i, j) = train.M[i][j];
+
+  Span<const double> longitude = train.column(1);
+  Span<const double> latitude = train.column(2);
+
+  // Layers on one grid are sampled through their layer stack, which hands every variable
+  // of a point over at once. Points go in cell order, so the cube is walked front to back.
+  if (opened->stack) {
+    const LayerStack *stack = opened->stack.get();
+
+    std::vector<std::pair<int64_t, int64_t>> cells(train.rowN);
+    for (int32_t i = 0; i < train.rowN; ++i) {
+      int32_t row = 0, col = 0;
+      bool inside = stack->locate(longitude[i], latitude[i], row, col);
+      cells[i] = {inside ? (int64_t)row * stack->cols() + col : -1, i};
+    }
+    std::sort(cells.begin(), cells.end());
+
+    Utils::parallel::forChunks(0, cells.size(), 4096, [&](int32_t, int64_t begin, int64_t end) {
+      std::vector<double> values(stack->bands());
+      for (int64_t k = begin; k < end; ++k) {
+        const int64_t i = cells[k].second;
+        stack->sample(longitude[i], latitude[i], values.data());
+        for (int32_t b = 0; b < stack->bands(); ++b) layersData.at(i, 4 + b) = values[b];
+      }
+    });
+  } else {
+    // Each layer is sampled on its own, with the points sorted by tile. Layers on the
+    // same grid share the sort.
+    auto sameTiles = [](const TiledRaster &a, const TiledRaster &b) {
+      return LayerStack::sameGrid(a.header(), b.header())
+             && (a.header().tileSize == b.header().tileSize);
+    };
+
+    std::vector<std::vector<int64_t>> orders;
+    std::vector<size_t> orderOf(layers.size());
+    for (size_t j = 0; j < layers.size(); ++j) {
+      orderOf[j] = orders.size();
+      for (size_t k = 0; k < j; ++k)
+        if (sameTiles(*layers[j], *layers[k])) {
+          orderOf[j] = orderOf[k];
+          break;
+        }
+      if (orderOf[j] == orders.size()) orders.push_back(layers[j]->order(longitude, latitude));
+    }
+
+    Utils::parallel::forChunks(0, layers.size(), 1, [&](int32_t, int64_t begin, int64_t end) {
+      for (int64_t j = begin; j < end; ++j)
+        layers[j]->getValues(longitude, latitude, layersData.column(4 + j), orders[orderOf[j]]);
+    });
+  }
+
+  keep(layersKey, layersData, datasetBytes(layersData));
+  save(layersKey, [this](const std::string &target) {
+    layersData.saveBinary((std::filesystem::path(target) / "layersData.sds").string());
+  });
+  return this;
+}
+
+//----------------------------------------------------------------------------------------------
+// Model
+//----------------------------------------------------------------------------------------------
+
+// The MPG nodes with the presence and the layers of each point as their attributes.
+Pipeline *Pipeline::mergeData() {
+  if (!graph) throw std::runtime_error("mergeData needs the MPG (generateMPG)");
+  if (graph->nNodes != layersData.rowN) throw std::runtime_error("The files have different sizes");
+  if (layersData.colN < 4)
+    throw std::runtime_error("mergeData needs the sampled layers (#id;long;lat;presence;x0;...)");
+  const bool named = (int32_t)layersData.names.size() == layersData.colN;
+
+  const StageCache::Key mergeKey = StageCache::Key("merge").add(mpgKey).add(layersKey);
+  if (std::shared_ptr<const Dataset> kept = recall<Dataset>(mergeKey)) {
+    merged = std::make_shared<Dataset>(*kept);
+    return this;
+  }
+
+  if (restore(mergeKey, {"mergedData.mpg"})) {
+    // The MPG is already in graph: only the node attributes are read back
+    merged = std::make_shared<Dataset>();
+    ReadFile::Read(*merged, cache->path(mergeKey, "mergedData.mpg"), ';');
+    if (merged->rowN != graph->nNodes)
+      throw std::runtime_error(fmt::format("The cached merge has {} rows for {} nodes",
+                                           merged->rowN, graph->nNodes));
+
+    if (named) merged->names.assign(layersData.names.begin() + 3, layersData.names.end());
+    keep(mergeKey, *merged, datasetBytes(*merged));
+    return this;
+  }
+
+  // Layers columns --> #id;long;lat;presence;x0;x1;...;xn --> keep presence;x0;x1;...;xn
+  const int32_t Nvariables = layersData.colN - 3;
+
+  merged = std::make_shared<Dataset>();
+  merged->reset(graph->nNodes, Nvariables);
+  if (named) merged->names.assign(layersData.names.begin() + 3, layersData.names.end());
+
+  for (int32_t j = 0; j < Nvariables; ++j) {
+    Span<const double> values = layersData.column(3 + j);
+    for (int32_t i = 0; i < graph->nNodes; ++i) merged->M[i][j] = values[i];
+  }
+
+  keep(mergeKey, *merged, datasetBytes(*merged));
+
+  // The MPG and its node attributes travel together in one binary file
+  save(mergeKey, [this](const std::string &target) {
+    graph->saveBinary((std::filesystem::path(target) / "mergedData.mpg").string(), merged.get());
+  });
+
+  return this;
+}
+
+/*
+ * Fits the model to the merged data and writes it to result.txt.
+ *
+ * @param { ModelType } modelType - LINEAR, QUADRATIC or LAG.
+ * @param { ObjectiveType } objectiveType - MINSQT, MINERR or MINBOTH.
+ * @param { bool } normalize - Normalizes the variables before fitting.
+ * @param { SAHGAParameter } parameters - Population and annealing settings of the GA.
+ * */
+Pipeline *Pipeline::adjustModel(GASA::ModelType modelType, GASA::ObjectiveType objectiveType,
+                                bool normalize, GASA::SAHGAParameter parameters) {
+  if (!graph || !merged) throw std::runtime_error("adjustModel needs the merged data (mergeData)");
+
+  // The fit normalizes its own copy, merged stays as sampled
+  auto dataset = std::make_shared<Dataset>(*merged);
+
+  // Atualizando as estatísticas da matriz de dados
+  dataset->updateStats();
+
+  // Armazena a média e o desvio padrão de cada coluna
+  model.type = modelType;
+  model.avg.clear();
+  model.stdDev.clear();
+  for (int32_t i = 0; i < dataset->colN; ++i) {
+    model.avg.emplace_back(dataset->stats[i].avg);
+    model.stdDev.emplace_back(dataset->stats[i].stdDev);
+  }
+
+  // Normalizando a matriz de dados
+  dataset->normalize(int32_t(normalize));
+
+  // GASA only reads the graph and the data, so it shares them instead of copying
+  auto gasa = std::make_unique<GASA>(graph, dataset, modelType, objectiveType);
+  gasa->setSAHGAParameters(parameters)->setProgress(progress)->run();
+
+  // What the model was fitted on, for bootstrap to fit it again
+  fitted = dataset;
+  fitObjective = objectiveType;
+  fitParameters = parameters;
+
+  model.coefficients.clear();
+  for (int32_t i = 0; i < gasa->geneSize; ++i)
+    model.coefficients.push_back(gasa->bestChromosome.genes[i].value);
+
+  std::ofstream outputStream(pathTo("result.txt"));
+
+  outputStream << std::setiosflags(std::ios::fixed) << std::setprecision(8);
+  outputStream << "//Modelo gerado para o arquivo de entrada: " << source << '\n';
+  outputStream << "//Tipo do modelo ajustado:" << '\n';
+
+  if (modelType == GASA::ModelType::LINEAR) outputStream << "LINEAR" << '\n';
+  if (modelType == GASA::ModelType::QUADRATIC) outputStream << "QUADRATIC" << '\n';
+  if (modelType == GASA::ModelType::LAG) outputStream << "LAG" << '\n';
+
+  if (objectiveType == GASA::ObjectiveType::MINSQT)
+    outputStream << "//Aptidao final (Min SQT) = " << gasa->bestChromosome.fitness << '\n';
+  if (objectiveType == GASA::ObjectiveType::MINERR)
+    outputStream << "//Aptidao final (Min ERR) = " << gasa->bestChromosome.fitness << '\n';
+  if (objectiveType == GASA::ObjectiveType::MINBOTH)
+    outputStream << "//Aptidao final (Min SQT&ERR) = " << gasa->bestChromosome.fitness << '\n';
+
+  outputStream << "//Saida --> c1;c2;...;cn;constante;[lambda]" << '\n';
+  for (double coefficient : model.coefficients) outputStream << coefficient << ';';
+  outputStream << '\n' << "//Media das variáveis --> Media X0;Media X1;...MediaXn" << '\n';
+  for (double avg : model.avg) outputStream << avg << ';';
+  outputStream << '\n' << "//Desvio padrao das variáveis --> s0;s1;...;sn" << '\n';
+  for (double stdDev : model.stdDev) outputStream << stdDev << ';';
+
+  return this;
+}
+
+/*
+ * Evaluates the model over the whole extent of the layers, with the neighborhood of the
+ * MPG it was fitted on.
+ *
+ * @param { std::string } folderName - Folder of the layers the model was fitted on.
+ * @param { std::string } output - Path of the suitability grid (ESRI ASCII).
+ * @param { int32_t } level - Overview level to predict on (0 = full resolution); a level
+ * n map has 2^n times coarser cells.
+ * */
+Pipeline *Pipeline::predict(const std::string &folderName, const std::string &output,
+                            int32_t level) {
+  std::shared_ptr<const LayerCache::Layers> layers
+      = layerCache->get(folderName, level, quantization);
+  if (!layers->stack)
+    throw std::runtime_error(fmt::format("The layers of {} are not on one grid", folderName));
+
+  Predictor(model, radius, mpgType, neighbors).predict(*layers->stack, output);
+
+  return this;
+}
+
+/*
+ * Scores the fitted model on the test points (see Evaluation) and writes the scores to
+ * evaluation.txt. The points are predicted as the map would, over the same layers.
+ *
+ * @param { std::string } folderName - Folder of the layers the model was fitted on.
+ * @param { int32_t } level - Overview level to predict on (0 = full resolution).
+ * @param { double } threshold - Predictions at or above it count as presences.
+ * */
+Pipeline *Pipeline::evaluate(const std::string &folderName, int32_t level, double threshold) {
+  std::shared_ptr<const LayerCache::Layers> layers
+      = layerCache->get(folderName, level, quantization);
+  if (!layers->stack)
+    throw std::runtime_error(fmt::format("The layers of {} are not on one grid", folderName));
+
+  evaluation
+      = Evaluation::score(Predictor(model, radius, mpgType, neighbors), *layers->stack, test,
+                          threshold);
+
+  const std::string fileName = pathTo("evaluation.txt");
+  std::ofstream os(fileName);
+  os << evaluation.report();
+  if (!os.good()) throw std::runtime_error(fmt::format("Failed to write {}", fileName));
+
+  return this;
+}
+
+/*
+ * Percentile confidence intervals for the model coefficients (see Bootstrap), written to
+ * bootstrap.txt next to result.txt.
+ *
+ * @param { int32_t } replicates - Number of bootstrap samples.
+ * @param { double } confidence - Percent of the replicates inside every interval.
+ * @param { int32_t } generations - Generations of every replicate (0 = a quarter of the
+ * generations of the fit).
+ * */
+Pipeline *Pipeline::bootstrap(int32_t replicates, double confidence, int32_t generations) {
+  if (!fitted) throw std::runtime_error("bootstrap needs the fitted model (adjustModel)");
+
+  Bootstrap bootstrap(graph, fitted, model.type, fitObjective);
+  intervals = bootstrap.setReplicates(replicates)
+                  ->setConfidence(confidence)
+                  ->setParameters(fitParameters, generations)
+                  ->run(model.coefficients);
+
+  const std::string fileName = pathTo("bootstrap.txt");
+  std::ofstream os(fileName);
+  os << "//Bootstrap intervals of the model fitted on: " << source << '\n';
+  os << fmt::format("//{} replicates, {}% percentile intervals\n", replicates, confidence);
+  os << "//Coefficient;estimate;lower;upper (c1;c2;...;cn;constante;[lambda])\n";
+  for (size_t c = 0; c < intervals.size(); ++c)
+    os << fmt::format("c{};{:.8f};{:.8f};{:.8f}\n", c + 1, intervals[c].estimate,
+                      intervals[c].lower, intervals[c].upper);
+  if (!os.good()) throw std::runtime_error(fmt::format("Failed to write {}", fileName));
+
+  return this;
+}
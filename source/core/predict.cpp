@@ -0,0 +1,415 @@
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sahga/core/predict.hpp>
+#include <sahga/utils/mapped_file.hpp>
+#include <sahga/utils/parallel.hpp>
+#include <sahga/utils/tokenizer.hpp>
+#include <sahga/utils/utils.hpp>
+#include <stdexcept>
+#include <utility>
+
+//----------------------------------------------------------------------------------------------
+// Fitted model
+//----------------------------------------------------------------------------------------------
+
+/*
+ * Reads the model written by SAHGACore::adjustModel. Lines starting with "//" are
+ * comments; the others are, in order, the model type, the coefficients, the means and
+ * the standard deviations, separated by ';'.
+ *
+ * @param { std::string } fileName - Path of the result.txt.
+ *
+ * @return { SuitabilityModel } The fitted model.
+ * */
+SuitabilityModel SuitabilityModel::load(const std::string &fileName) {
+  MappedFile file(fileName);
+  std::vector<std::string_view> lines;
+  for (std::string_view line : Utils::parsing::lines(std::string_view(file.data(), file.size())))
+    if (!line.empty() && (line.substr(0, 2) != "//")) lines.push_back(line);
+
+  if (lines.size() < 4) throw std::runtime_error(fmt::format("{}: incomplete model", fileName));
+
+  SuitabilityModel model;
+  const std::string type = Utils::miscellaneous::upperCase(std::string(lines[0]));
+  if (type == "LINEAR") {
+    model.type = GASA::ModelType::LINEAR;
+  } else if (type == "QUADRATIC") {
+    model.type = GASA::ModelType::QUADRATIC;
+  } else if (type == "LAG") {
+    model.type = GASA::ModelType::LAG;
+  } else {
+    throw std::runtime_error(fmt::format("{}: unknown model type {}", fileName, type));
+  }
+
+  std::vector<double> *fields[] = {&model.coefficients, &model.avg, &model.stdDev};
+  for (int32_t i = 0; i < 3; ++i) {
+    Utils::parsing::Tokenizer tokens(lines[i + 1], ';');
+    std::string_view token;
+    double value;
+    while (tokens.next(token))
+      if (Utils::parsing::parseNumber(token, value)) fields[i]->push_back(value);
+  }
+
+  return model;
+}
+
+//----------------------------------------------------------------------------------------------
+// Predictor
+//----------------------------------------------------------------------------------------------
+
+Predictor::Predictor(const SuitabilityModel &model, double radius, Graph::MPGTypes type,
+                     int32_t neighbors, int32_t tileSize)
+    : model(model),
+      radius(radius),
+      type(type),
+      neighbors(neighbors),
+      tileSize(tileSize),
+      noData(-9999) {
+  const int32_t n = model.variables();
+  size_t genes = 0;
+  switch (model.type) {
+    case GASA::ModelType::LINEAR:
+      genes = n + 1;
+      break;
+    case GASA::ModelType::QUADRATIC:
+      genes = 2 * n + 1;
+      break;
+    case GASA::ModelType::LAG:
+      genes = n + 2;
+      break;
+  }
+
+  if ((n <= 0) || (model.stdDev.size() != model.avg.size()) || (model.coefficients.size() != genes))
+    throw std::runtime_error("The model coefficients do not match its variables");
+  if (tileSize <= 0) throw std::runtime_error("Tile size must be positive");
+  if (((type == Graph::MPGTypes::KNN) || (type == Graph::MPGTypes::KNNIDW)) && (neighbors <= 0))
+    throw std::runtime_error("KNN neighborhoods need a positive number of neighbors");
+}
+
+/*
+ * Cells within radius km of a cell, itself first, weighed like the MPG edges. For KNN and
+ * KNNIDW, the `neighbors` closest of them (of any distance when radius <= 0), ties at the
+ * last distance taken in row and then column order.
+ * */
+std::vector<Predictor::Offset> Predictor::neighborhood(const LayerStack &stack) const {
+  const double cellKm = stack.header().cellSize * Utils::constants::KM_PER_DEGREE;
+  const bool nearest = (type == Graph::MPGTypes::KNN) || (type == Graph::MPGTypes::KNNIDW);
+
+  int32_t halo = ((cellKm > 0) && (radius > 0)) ? (int32_t)std::floor(radius / cellKm) : 0;
+  if (nearest) {
+    // The square of `ring` cells around holds `neighbors` cells, so the closest ones are
+    // at most ring * sqrt(2) cells away
+    const int32_t ring = (int32_t)std::ceil((std::sqrt(neighbors + 1.0) - 1) / 2);
+    const int32_t reach = (int32_t)std::ceil(ring * std::sqrt(2.0));
+    halo = (radius > 0) ? std::min(halo, reach) : reach;
+  }
+
+  std::vector<std::pair<double, Offset>> cells;
+  for (int32_t dr = -halo; dr <= halo; ++dr)
+    for (int32_t dc = -halo; dc <= halo; ++dc) {
+      const double dist = sqrt((double)dr * dr + (double)dc * dc) * cellKm;
+      if ((dist > 0) && ((radius <= 0) || (dist <= radius)))
+        cells.push_back({dist, {dr, dc, Graph::edgeWeight(type, dist, radius)}});
+    }
+
+  if (nearest && (cells.size() > (size_t)neighbors)) {
+    std::stable_sort(cells.begin(), cells.end(),
+                     [](const auto &a, const auto &b) { return a.first < b.first; });
+    cells.resize(neighbors);
+  }
+
+  std::vector<Offset> offsets = {{0, 0, 1}};
+  for (const auto &cell : cells) offsets.push_back(cell.second);
+
+  return offsets;
+}
+
+/*
+ * Predicts the rows x cols cells at (row, col) into out. The window read from the stack
+ * is the tile plus `halo` cells around it, normalized with the model statistics; a cell
+ * with noData in any layer is left out of every neighborhood and predicted as noData.
+ * */
+void Predictor::predictTile(const LayerStack &stack, const std::vector<Offset> &offsets,
+                            int32_t halo, int32_t row, int32_t col, int32_t rows, int32_t cols,
+                            double *out, int64_t rowStride) const {
+  const int32_t n = model.variables();
+  const int32_t width = cols + 2 * halo, height = rows + 2 * halo;
+  const std::vector<double> &gene = model.coefficients;
+
+  std::vector<double> z((size_t)width * height * n);
+  std::vector<char> valid((size_t)width * height, 0);
+
+  std::vector<double> scale(n);
+  for (int32_t b = 0; b < n; ++b) scale[b] = 1.0 / model.stdDev[b + 1];
+
+  // The part of every window row inside the grid is decoded in one go, then normalized
+  const int32_t first = std::max(0, halo - col);
+  const int32_t last = std::min(width, stack.cols() - col + halo);
+  std::vector<double> values((size_t)std::max(0, last - first) * n);
+
+  for (int32_t r = 0; r < height; ++r) {
+    const int32_t gridRow = row - halo + r;
+    if ((gridRow < 0) || (gridRow >= stack.rows()) || (first >= last)) continue;
+
+    stack.read(gridRow, col - halo + first, last - first, values.data());
+    for (int32_t c = first; c < last; ++c) {
+      const double *cell = values.data() + (size_t)(c - first) * n;
+      double *target = z.data() + ((size_t)r * width + c) * n;
+      bool complete = true;
+      for (int32_t b = 0; b < n; ++b) {
+        complete = complete && (cell[b] != stack.band(b).noData);
+        target[b] = (cell[b] - model.avg[b + 1]) * scale[b];
+      }
+      valid[(size_t)r * width + c] = complete;
+    }
+  }
+
+  if (model.type == GASA::ModelType::LAG) {
+    // Non-spatial part of the model over the whole window, then the lag of each cell
+    std::vector<double> base((size_t)width * height, 0);
+    for (size_t k = 0; k < base.size(); ++k) {
+      if (!valid[k]) continue;
+
+      const double *x = z.data() + k * n;
+      double estimation = gene[n];
+      for (int32_t j = 0; j < n; ++j) estimation += gene[j] * x[j];
+      base[k] = estimation;
+    }
+
+    for (int32_t r = 0; r < rows; ++r)
+      for (int32_t c = 0; c < cols; ++c) {
+        const size_t center = (size_t)(r + halo) * width + (c + halo);
+        if (!valid[center]) {
+          out[r * rowStride + c] = noData;
+          continue;
+        }
+
+        double sumN = 0, sumD = 0;
+        for (size_t o = 1; o < offsets.size(); ++o) {
+          const size_t k = center + (int64_t)offsets[o].row * width + offsets[o].col;
+          if (!valid[k]) continue;
+          sumN += offsets[o].weight * base[k];
+          sumD += offsets[o].weight;
+        }
+
+        out[r * rowStride + c] = base[center] + gene[n + 1] * ((sumD == 0) ? 0 : sumN / sumD);
+      }
+
+    return;
+  }
+
+  // LINEAR and QUADRATIC: weighted mean of every variable over the neighborhood. The
+  // variables of a cell are contiguous, so the inner loops run across them.
+  std::vector<double> sum(n);
+  for (int32_t r = 0; r < rows; ++r)
+    for (int32_t c = 0; c < cols; ++c) {
+      const size_t center = (size_t)(r + halo) * width + (c + halo);
+      if (!valid[center]) {
+        out[r * rowStride + c] = noData;
+        continue;
+      }
+
+      std::fill(sum.begin(), sum.end(), 0.0);
+      double sumD = 0;
+      for (const Offset &offset : offsets) {
+        const size_t k = center + (int64_t)offset.row * width + offset.col;
+        if (!valid[k]) continue;
+
+        const double *x = z.data() + k * n;
+        const double weight = offset.weight;
+        for (int32_t j = 0; j < n; ++j) sum[j] += weight * x[j];
+        sumD += weight;
+      }
+
+      double estimation = gene.back();
+      if (model.type == GASA::ModelType::LINEAR) {
+        for (int32_t j = 0; j < n; ++j) estimation += gene[j] * (sum[j] / sumD);
+      } else {
+        for (int32_t j = 0; j < n; ++j) {
+          const double average = sum[j] / sumD;
+          estimation += gene[2 * j] * average * average + gene[2 * j + 1] * average;
+        }
+      }
+
+      out[r * rowStride + c] = estimation;
+    }
+}
+
+/*
+ * Writes the suitability map of the whole stack extent.
+ *
+ * @param { LayerStack } stack - The layers, in the order of the model variables.
+ * @param { std::string } fileName - Path of the ESRI ASCII grid to write.
+ * */
+Predictor *Predictor::predict(const LayerStack &stack, const std::string &fileName) {
+  if (stack.bands() != model.variables())
+    throw std::runtime_error(fmt::format("The model has {} variables but the stack {} layers",
+                                         model.variables(), stack.bands()));
+
+  const std::vector<Offset> offsets = neighborhood(stack);
+  int32_t halo = 0;
+  for (const Offset &offset : offsets) halo = std::max({halo, abs(offset.row), abs(offset.col)});
+
+  std::unique_ptr<FILE, int (*)(FILE *)> output(fopen(fileName.c_str(), "w"), fclose);
+  if (!output) throw std::runtime_error(fmt::format("Failed to create {}", fileName));
+
+  // Same header as Layer::save
+  const Utils::binary::StackHeader &grid = stack.header();
+  fmt::print(output.get(), "NCOLS {}\nNROWS {}\n", grid.cols, grid.rows);
+  fmt::print(output.get(), "XLLCORNER {:.6f}\nYLLCORNER {:.6f}\nCELLSIZE {:.6f}\n", grid.xCorner,
+             grid.yCorner, grid.cellSize);
+  fmt::print(output.get(), "NODATA_VALUE {:.0f}\n", noData);
+
+  const int32_t tilesX = (grid.cols + tileSize - 1) / tileSize;
+  std::vector<double> band((size_t)tileSize * grid.cols);
+  fmt::memory_buffer text;
+
+  for (int32_t first = 0; first < grid.rows; first += tileSize) {
+    const int32_t rows = std::min(tileSize, grid.rows - first);
+
+    Utils::parallel::forChunks(0, tilesX, 1, [&](int32_t, int64_t begin, int64_t end) {
+      for (int64_t tx = begin; tx < end; ++tx) {
+        const int32_t col = (int32_t)tx * tileSize;
+        predictTile(stack, offsets, halo, first, col, rows, std::min(tileSize, grid.cols - col),
+                    band.data() + col, grid.cols);
+      }
+    });
+
+    for (int32_t r = 0; r < rows; ++r) {
+      text.clear();
+      for (int32_t c = 0; c < grid.cols; ++c) {
+        const double value = band[(size_t)r * grid.cols + c];
+        if (value == noData) {
+          fmt::format_to(std::back_inserter(text), "{:.0f} ", value);
+        } else {
+          fmt::format_to(std::back_inserter(text), "{:.6f} ", value);
+        }
+      }
+      text.push_back('\n');
+      fwrite(text.data(), 1, text.size(), output.get());
+    }
+  }
+
+  if (ferror(output.get())) throw std::runtime_error(fmt::format("Failed to write {}", fileName));
+
+  return this;
+}
+
+/*
+ * Evaluates the model at points, each as the cell of the map it falls in, so a point gets
+ * the same value `predict` writes for its cell.
+ *
+ * Points go in blocks: the weighted means of the variables over the neighborhood of every
+ * point of a block are gathered variable by variable, then each coefficient is applied to
+ * the whole block in one pass. As the model is linear in the means, the lag of a LAG
+ * model is the non-spatial part of the model at the mean of the neighbors.
+ *
+ * @param { LayerStack } stack - The layers, in the order of the model variables.
+ * @param { Span<const double> } longitude - Longitude of each point.
+ * @param { Span<const double> } latitude - Latitude of each point.
+ *
+ * @return { std::vector<double> } The value at each point, noData outside the stack.
+ * */
+std::vector<double> Predictor::predictPoints(const LayerStack &stack,
+                                             Span<const double> longitude,
+                                             Span<const double> latitude) const {
+  if (stack.bands() != model.variables())
+    throw std::runtime_error(fmt::format("The model has {} variables but the stack {} layers",
+                                         model.variables(), stack.bands()));
+
+  const int32_t n = model.variables();
+  const std::vector<double> &gene = model.coefficients;
+  const bool lag = (model.type == GASA::ModelType::LAG);
+  const std::vector<Offset> offsets = neighborhood(stack);
+
+  std::vector<double> scale(n);
+  for (int32_t b = 0; b < n; ++b) scale[b] = 1.0 / model.stdDev[b + 1];
+
+  auto complete = [&](const double *values) {
+    for (int32_t b = 0; b < n; ++b)
+      if (values[b] == stack.band(b).noData) return false;
+    return true;
+  };
+
+  constexpr int32_t block = 256;
+  std::vector<double> values(longitude.size(), noData);
+
+  Utils::parallel::forChunks(0, values.size(), block, [&](int32_t, int64_t begin, int64_t end) {
+    // Normalized means of variable j at the p-th point of the block at [j * block + p]: over
+    // the whole neighborhood (LINEAR, QUADRATIC) or the point alone and its neighbors (LAG)
+    std::vector<double> mean((size_t)n * block), around((size_t)n * block);
+    std::vector<double> sum(n), estimation(block), spatial(block);
+    std::vector<char> related(block);
+    std::vector<int64_t> point(block);
+    std::vector<double> center(n), cell(n);
+
+    for (int64_t first = begin; first < end; first += block) {
+      int32_t count = 0;
+      for (int64_t i = first; i < std::min(first + block, end); ++i) {
+        int32_t row = 0, col = 0;
+        if (!stack.locate(longitude[i], latitude[i], row, col)) continue;
+
+        stack.cell(row, col, center.data());
+        if (!complete(center.data())) continue;
+
+        std::fill(sum.begin(), sum.end(), 0.0);
+        double sumD = 0;
+        for (size_t o = lag ? 1 : 0; o < offsets.size(); ++o) {
+          const int32_t r = row + offsets[o].row, c = col + offsets[o].col;
+          if ((r < 0) || (r >= stack.rows()) || (c < 0) || (c >= stack.cols())) continue;
+
+          const double *x = center.data();
+          if (o != 0) {
+            stack.cell(r, c, cell.data());
+            x = cell.data();
+          }
+          if (!complete(x)) continue;
+          for (int32_t j = 0; j < n; ++j) sum[j] += offsets[o].weight * x[j];
+          sumD += offsets[o].weight;
+        }
+
+        double *target = lag ? around.data() : mean.data();
+        for (int32_t j = 0; j < n; ++j)
+          target[(size_t)j * block + count]
+              = (sumD == 0) ? 0 : (sum[j] / sumD - model.avg[j + 1]) * scale[j];
+        if (lag) {
+          for (int32_t j = 0; j < n; ++j)
+            mean[(size_t)j * block + count] = (center[j] - model.avg[j + 1]) * scale[j];
+          related[count] = (sumD != 0);
+        }
+
+        point[count++] = i;
+      }
+
+      std::fill(estimation.begin(), estimation.begin() + count, lag ? gene[n] : gene.back());
+      for (int32_t j = 0; j < n; ++j) {
+        const double *x = mean.data() + (size_t)j * block;
+        switch (model.type) {
+          case GASA::ModelType::QUADRATIC:
+            for (int32_t p = 0; p < count; ++p)
+              estimation[p] += gene[2 * j] * x[p] * x[p] + gene[2 * j + 1] * x[p];
+            break;
+          default:
+            for (int32_t p = 0; p < count; ++p) estimation[p] += gene[j] * x[p];
+        }
+      }
+
+      if (lag) {
+        std::fill(spatial.begin(), spatial.begin() + count, gene[n]);
+        for (int32_t j = 0; j < n; ++j) {
+          const double *x = around.data() + (size_t)j * block;
+          for (int32_t p = 0; p < count; ++p) spatial[p] += gene[j] * x[p];
+        }
+        for (int32_t p = 0; p < count; ++p)
+          if (related[p]) estimation[p] += gene[n + 1] * spatial[p];
+      }
+
+      for (int32_t p = 0; p < count; ++p) values[point[p]] = estimation[p];
+    }
+  });
+
+  return values;
+}
@@ -0,0 +1,93 @@
+#include <fmt/format.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <sahga/core/stage_cache.hpp>
+#include <sahga/utils/mapped_file.hpp>
+#include <sahga/utils/utils.hpp>
+#include <system_error>
+
+// Bumped whenever a stage changes what it writes, so older entries stop matching.
+static const uint32_t CACHE_VERSION = 1;
+
+//----------------------------------------------------------------------------------------------
+// Key
+//----------------------------------------------------------------------------------------------
+
+StageCache::Key::Key(const std::string &stage) : _stage(stage), _value(0) {
+  _value = Utils::miscellaneous::hash(stage.data(), stage.size());
+  add(CACHE_VERSION);
+}
+
+StageCache::Key &StageCache::Key::add(const void *data, size_t size) {
+  // The size goes in too, so ("ab", "c") and ("a", "bc") differ
+  const uint64_t length = size;
+  _value = Utils::miscellaneous::hash(&length, sizeof(length), _value);
+  _value = Utils::miscellaneous::hash(data, size, _value);
+  return *this;
+}
+
+StageCache::Key &StageCache::Key::add(const std::string &text) {
+  return add(text.data(), text.size());
+}
+
+StageCache::Key &StageCache::Key::add(const Key &key) {
+  add(key._stage);
+  return add(key._value);
+}
+
+StageCache::Key &StageCache::Key::addFile(const std::string &fileName) {
+  MappedFile file(fileName);
+  return add(file.data(), file.size());
+}
+
+StageCache::Key &StageCache::Key::addFingerprint(const std::string &fileName) {
+  const std::filesystem::path path = std::filesystem::absolute(fileName);
+  add(path.string());
+  add((uint64_t)std::filesystem::file_size(path));
+  return add((int64_t)std::filesystem::last_write_time(path).time_since_epoch().count());
+}
+
+std::string StageCache::Key::name() const { return fmt::format("{}-{:016x}", _stage, _value); }
+
+//----------------------------------------------------------------------------------------------
+// Cache
+//----------------------------------------------------------------------------------------------
+
+StageCache::StageCache(const std::string &folder) : _folder(folder) {
+  std::filesystem::create_directories(folder);
+}
+
+std::string StageCache::path(const Key &key, const std::string &file) const {
+  return (std::filesystem::path(_folder) / key.name() / file).string();
+}
+
+bool StageCache::contains(const Key &key, const std::vector<std::string> &files) const {
+  for (const std::string &file : files)
+    if (!std::filesystem::is_regular_file(path(key, file))) return false;
+
+  return true;
+}
+
+void StageCache::store(const Key &key,
+                       const std::function<void(const std::string &folder)> &write) const {
+  static std::atomic<uint64_t> counter(0);
+  const std::filesystem::path entry = std::filesystem::path(_folder) / key.name();
+  const std::filesystem::path temporary = std::filesystem::path(_folder)
+      / fmt::format(".{}.{}.{}", key.name(),
+                    std::chrono::steady_clock::now().time_since_epoch().count(), counter++);
+
+  std::filesystem::create_directories(temporary);
+  try {
+    write(temporary.string());
+  } catch (...) {
+    std::filesystem::remove_all(temporary);
+    throw;
+  }
+
+  // Another run may have stored the same entry meanwhile: either copy will do
+  std::error_code error;
+  std::filesystem::rename(temporary, entry, error);
+  if (error) std::filesystem::remove_all(temporary);
+}
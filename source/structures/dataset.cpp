@@ -1,89 +1,380 @@
+#include <fmt/core.h>
+
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <sahga/structures/dataset.hpp>
+#include <sahga/utils/parallel.hpp>
+#include <sahga/utils/quantize.hpp>
+#include <sahga/utils/statistics.hpp>
+#include <sahga/utils/utils.hpp>
+#include <stdexcept>
+
+// Alignment of the data buffer: one cache line, enough for any SIMD width in use.
+static const size_t ALIGNMENT = 64;
 
 Dataset::Dataset() {
   rowN = 0;
   colN = 0;
   stats.clear();
   M = NULL;
+  _layout = Layout::ROW_MAJOR;
+  _stride = 0;
 }
 
 Dataset::~Dataset() {
-  for (int i = 0; i < rowN; i++) free(M[i]);
-  free(M);
-
   stats.clear();
   M = NULL;
 }
 
+Dataset::Dataset(const Dataset &src) : Dataset() { copy(src); }
+
+Dataset::Dataset(Dataset &&src) noexcept : Dataset() { *this = std::move(src); }
+
+Dataset &Dataset::operator=(const Dataset &src) {
+  if (this != &src) copy(src);
+  return *this;
+}
+
+// The row pointers live in a vector whose storage moves along with it, so M stays valid.
+Dataset &Dataset::operator=(Dataset &&src) noexcept {
+  if (this == &src) return *this;
+
+  rowN = src.rowN;
+  colN = src.colN;
+  stats = std::move(src.stats);
+  names = std::move(src.names);
+  _layout = src._layout;
+  _stride = src._stride;
+  _buffer = std::move(src._buffer);
+  _rows = std::move(src._rows);
+  M = _rows.empty() ? NULL : _rows.data();
+
+  src.rowN = 0;
+  src.colN = 0;
+  src._stride = 0;
+  src._rows.clear();
+  src.M = NULL;
+
+  return *this;
+}
+
 /**
- * Resets array size and allocates space for data
+ * Resets array size and allocates space for data. Any previous data is released.
  *
  * @param { int } row - New row length;
- * @param { int } col - New column length.
+ * @param { int } col - New column length;
+ * @param { Layout } layout - Whether rows or columns are contiguous.
  *
- * @return { bool } true if it succeeded.
+ * @return { bool } true if there is no storage (empty or failed allocation).
  */
-bool Dataset::reset(int row, int col) {
+bool Dataset::reset(int row, int col, Layout layout) {
   rowN = row;
   colN = col;
   stats.resize(colN);
+  _layout = layout;
+  _stride = (_layout == Layout::ROW_MAJOR) ? colN : rowN;
 
-  M = (double **)malloc(rowN * sizeof(double *));
+  size_t bytes = (size_t)rowN * colN * sizeof(double);
+  bytes = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  _buffer.reset((bytes > 0) ? (double *)std::aligned_alloc(ALIGNMENT, bytes) : nullptr, free);
 
-  for (int i = 0; i < rowN; i++) M[i] = (double *)malloc(colN * sizeof(double));
+  _rows.clear();
+  if ((_layout == Layout::ROW_MAJOR) && (_buffer != nullptr)) {
+    _rows.resize(rowN);
+    for (int i = 0; i < rowN; i++) _rows[i] = _buffer.get() + i * _stride;
+  }
+  M = _rows.empty() ? NULL : _rows.data();
 
-  return (M == NULL);
+  return (_buffer == nullptr);
 }
 
 /*
  * Copies the current matrix into src
  *
- * @param { const &Dataset } src - The new source matrix.
+ * @param { &const Dataset } src - The new source matrix.
  *
- * @return { bool } true if it succeeded.
+ * @return { bool } true if there is no storage.
  * */
 bool Dataset::copy(const Dataset &src) {
-  if (M != NULL) {
-    for (int i = 0; i < rowN; i++) free(M[i]);
-    free(M);
+  reset(src.rowN, src.colN, src._layout);
+  stats = src.stats;
+  names = src.names;
+
+  if (_buffer == nullptr) return true;
+
+  int lines = (_layout == Layout::ROW_MAJOR) ? rowN : colN;
+  int length = (_layout == Layout::ROW_MAJOR) ? colN : rowN;
+
+  if (src._stride == _stride)
+    memcpy(_buffer.get(), src._buffer.get(), (size_t)lines * length * sizeof(double));
+  else
+    for (int i = 0; i < lines; ++i)
+      memcpy(_buffer.get() + i * _stride, src._buffer.get() + i * src._stride,
+             length * sizeof(double));
+
+  return false;
+}
+
+/*
+ * Makes the matrix a view of external storage, which is shared rather than copied.
+ *
+ * @param { std::shared_ptr<double> } storage - First value; keeps its owner alive.
+ * @param { int } row, col - Size of the matrix.
+ * @param { Layout } layout - Whether rows or columns are contiguous.
+ * @param { int64_t } stride - Distance (in values) between rows or columns.
+ *
+ * @return { bool } true if there is no storage.
+ * */
+bool Dataset::view(std::shared_ptr<double> storage, int row, int col, Layout layout,
+                   int64_t stride) {
+  rowN = row;
+  colN = col;
+  stats.resize(colN);
+  _layout = layout;
+  _stride = stride;
+  _buffer = std::move(storage);
+
+  _rows.clear();
+  if ((_layout == Layout::ROW_MAJOR) && (_buffer != nullptr)) {
+    _rows.resize(rowN);
+    for (int i = 0; i < rowN; i++) _rows[i] = _buffer.get() + i * _stride;
   }
+  M = _rows.empty() ? NULL : _rows.data();
 
-  reset(src.rowN, src.colN);
-  stats = src.stats;
+  return (_buffer == nullptr);
+}
+
+/*
+ * Rearranges the values in the given layout (a transposition of the buffer).
+ *
+ * @param { Layout } layout - The new layout.
+ *
+ * @return { bool } true if there is no storage.
+ * */
+bool Dataset::setLayout(Layout layout) {
+  if (layout == _layout) return (_buffer == nullptr);
+
+  Dataset converted;
+  converted.reset(rowN, colN, layout);
 
-  for (int i = 0; i < src.rowN; ++i) memcpy(M[i], src.M[i], colN * sizeof(double));
+  // Walks the destination contiguously, in cache-sized tiles of the source
+  const int tile = 64;
+  for (int i0 = 0; i0 < rowN; i0 += tile)
+    for (int j0 = 0; j0 < colN; j0 += tile)
+      for (int i = i0; i < std::min(rowN, i0 + tile); ++i)
+        for (int j = j0; j < std::min(colN, j0 + tile); ++j) converted.at(i, j) = at(i, j);
 
-  return (M == NULL);
+  converted.stats = std::move(stats);
+  converted.names = std::move(names);
+  *this = std::move(converted);
+
+  return (_buffer == nullptr);
 }
 
 /*
- * Update matrix status for each column
+ * Saves the matrix as a columnar binary dataset (see Utils::binary): a header with the
+ * names, encodings and stats of the columns, followed by one aligned block per column.
+ * The file is assembled in memory and written at once.
+ *
+ * @param { const std::string & } fileName - Path of the file.
+ * @param { const std::vector<Encoding> & } encodings - Storage of each column.
+ * FLOAT32 halves and INT16 quarters the size, INT16 quantizing the column range
+ * into 65535 steps. Columns without an encoding are stored as FLOAT64.
  *
  * @return { bool } true if it succeeded.
  * */
-bool Dataset::updateStats() {
-  Stats columnStats;
+bool Dataset::saveBinary(const std::string &fileName,
+                         const std::vector<Utils::binary::Encoding> &encodings) const {
+  using namespace Utils::binary;
+  using Utils::statistics::Moments;
 
-  stats.clear();
+  // Stats of the values being written, whatever the state of `stats`
+  std::vector<Moments> moments(colN, {0, 0, 0});
+  if (_layout == Layout::ROW_MAJOR) {
+    Utils::statistics::ColumnMoments columns(colN);
+    columns.add(data(), rowN, _stride);
+    for (int j = 0; j < colN; ++j) moments[j] = columns[j];
+  } else {
+    for (int j = 0; j < colN; ++j) moments[j] = Utils::statistics::moments(column(j).data(), rowN);
+  }
+
+  std::vector<ColumnHeader> columns(colN);
+  uint64_t size = align64(sizeof(DatasetHeader) + sizeof(ColumnHeader) * colN);
+
+  for (int j = 0; j < colN; ++j) {
+    ColumnHeader &header = columns[j];
+    memset(&header, 0, sizeof(header));
+
+    if (j < (int)names.size()) strncpy(header.name, names[j].c_str(), sizeof(header.name) - 1);
+    header.encoding = (j < (int)encodings.size()) ? encodings[j] : Encoding::FLOAT64;
+    header.scale = 1;
+    header.offset = 0;
+    header.avg = moments[j].mean;
+    header.stdDev = sqrt(moments[j].variance());
+    header.sum = moments[j].sum();
+    header.sum2 = moments[j].sum2();
+
+    header.dataOffset = size;
+    header.dataSize = Utils::quantize::width(header.encoding) * rowN;
+    size = align64(size + header.dataSize);
+  }
+
+  std::vector<char> buffer(size, 0);
 
   for (int j = 0; j < colN; ++j) {
-    columnStats.sum = 0;
-    columnStats.sum2 = 0;
+    ColumnHeader &header = columns[j];
+    Span<const double> values = column(j);
+    char *block = buffer.data() + header.dataOffset;
 
-    for (int i = 0; i < rowN; ++i) {
-      columnStats.sum = columnStats.sum + M[i][j];
-      columnStats.sum2 = columnStats.sum2 + (M[i][j] * M[i][j]);
+    std::vector<double> contiguous;
+    const double *first = values.data();
+    if (!values.contiguous()) {
+      contiguous.resize(rowN);
+      for (int i = 0; i < rowN; ++i) contiguous[i] = values[i];
+      first = contiguous.data();
     }
 
-    columnStats.avg = columnStats.sum / rowN;
-    columnStats.stdDev = sqrt((1.0 / (rowN - 1))
-                              * (columnStats.sum2 - (columnStats.sum * columnStats.sum) / rowN));
-    stats.push_back(columnStats);
+    // The integer encodings spread the range of the column over their codes
+    Utils::quantize::Codec codec = Utils::quantize::fit(header.encoding, 0, 0);
+    if ((header.encoding == Encoding::INT16) || (header.encoding == Encoding::UINT16)) {
+      auto range = std::minmax_element(first, first + rowN);
+      if (rowN > 0) codec = Utils::quantize::fit(header.encoding, *range.first, *range.second);
+    }
+
+    header.scale = codec.scale;
+    header.offset = codec.offset;
+    Utils::quantize::encode(codec, first, rowN, block);
   }
 
+  memcpy(buffer.data() + sizeof(DatasetHeader), columns.data(), sizeof(ColumnHeader) * colN);
+
+  DatasetHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, DATASET_MAGIC, sizeof(header.magic));
+  header.version = DATASET_VERSION;
+  header.nColumns = colN;
+  header.nRows = rowN;
+  header.checksum = Utils::miscellaneous::hash(buffer.data() + sizeof(DatasetHeader),
+                                               size - sizeof(DatasetHeader));
+  header.tableChecksum = Utils::miscellaneous::hash(buffer.data() + sizeof(DatasetHeader),
+                                                    sizeof(ColumnHeader) * colN);
+  memcpy(buffer.data(), &header, sizeof(header));
+
+  std::ofstream outFile(fileName, std::ios::binary | std::ios::trunc);
+  outFile.write(buffer.data(), (std::streamsize)size);
+  if (!outFile) throw std::runtime_error(fmt::format("Failed to write {}", fileName));
+
+  return true;
+}
+
+Span<double> Dataset::row(int i) {
+  return Span<double>(_buffer.get() + offset(i, 0), colN,
+                      (_layout == Layout::ROW_MAJOR) ? 1 : _stride);
+}
+
+Span<const double> Dataset::row(int i) const {
+  return Span<const double>(_buffer.get() + offset(i, 0), colN,
+                            (_layout == Layout::ROW_MAJOR) ? 1 : _stride);
+}
+
+Span<double> Dataset::column(int j) {
+  return Span<double>(_buffer.get() + offset(0, j), rowN,
+                      (_layout == Layout::COLUMN_MAJOR) ? 1 : _stride);
+}
+
+Span<const double> Dataset::column(int j) const {
+  return Span<const double>(_buffer.get() + offset(0, j), rowN,
+                            (_layout == Layout::COLUMN_MAJOR) ? 1 : _stride);
+}
+
+// Values per parallel chunk below which threads cost more than they save.
+static const int64_t PARALLEL_GRAIN = 1 << 16;
+
+/*
+ * Single pass over the matrix that optionally rewrites every value as
+ * x' = (x - shift[j]) * scale[j] and measures the columns as they are written. Rows
+ * are split across threads and the per-thread moments merged afterwards.
+ *
+ * @return { std::vector<Moments> } Moments of each column (after the rewrite).
+ * */
+static std::vector<Utils::statistics::Moments> transformAndMeasure(Dataset &D,
+                                                                   const double *shift,
+                                                                   const double *scale) {
+  using namespace Utils::statistics;
+
+  std::vector<Moments> total(D.colN, {0, 0, 0});
+  if ((D.rowN == 0) || (D.colN == 0)) return total;
+
+  const int64_t grain = std::max<int64_t>(1, PARALLEL_GRAIN / D.colN);
+
+  if (D.layout() == Dataset::Layout::ROW_MAJOR) {
+    const int64_t stride = D.stride();
+    const int64_t blockRows = std::max<int64_t>(1, 16384 / D.colN);
+    std::vector<ColumnMoments> partial(Utils::parallel::chunkCount(D.rowN, grain),
+                                       ColumnMoments(D.colN));
+
+    Utils::parallel::forChunks(0, D.rowN, grain, [&](int32_t chunk, int64_t begin, int64_t end) {
+      for (int64_t start = begin; start < end; start += blockRows) {
+        const int64_t count = std::min(blockRows, end - start);
+        double *block = D.data() + start * stride;
+
+        if (shift != nullptr)
+          for (int64_t i = 0; i < count; ++i) {
+            double *row = block + i * stride;
+            for (int j = 0; j < D.colN; ++j) row[j] = (row[j] - shift[j]) * scale[j];
+          }
+
+        // The block was just written, so measuring it does not touch memory again
+        partial[chunk].add(block, count, stride);
+      }
+    });
+
+    for (const ColumnMoments &chunk : partial)
+      for (int j = 0; j < D.colN; ++j) total[j] = merge(total[j], chunk[j]);
+  } else {
+    for (int j = 0; j < D.colN; ++j) {
+      double *values = D.column(j).data();
+      std::vector<Moments> partial(Utils::parallel::chunkCount(D.rowN, PARALLEL_GRAIN));
+
+      Utils::parallel::forChunks(
+          0, D.rowN, PARALLEL_GRAIN, [&](int32_t chunk, int64_t begin, int64_t end) {
+            if (shift != nullptr)
+              for (int64_t i = begin; i < end; ++i)
+                values[i] = (values[i] - shift[j]) * scale[j];
+            partial[chunk] = moments(values + begin, end - begin);
+          });
+
+      for (const Moments &chunk : partial) total[j] = merge(total[j], chunk);
+    }
+  }
+
+  return total;
+}
+
+// Fills stats from the moments of each column.
+static void storeStats(std::vector<Stats> &stats,
+                       const std::vector<Utils::statistics::Moments> &moments) {
+  stats.resize(moments.size());
+
+  for (size_t j = 0; j < moments.size(); ++j) {
+    stats[j].avg = moments[j].mean;
+    stats[j].stdDev = sqrt(moments[j].variance());
+    stats[j].sum = moments[j].sum();
+    stats[j].sum2 = moments[j].sum2();
+  }
+}
+
+/*
+ * Update matrix status for each column, in a single parallel pass.
+ *
+ * @return { bool } true if it succeeded.
+ * */
+bool Dataset::updateStats() {
+  storeStats(stats, transformAndMeasure(*this, nullptr, nullptr));
+
   return ((int)stats.size() == colN);
 }
 
@@ -115,7 +406,8 @@ bool Dataset::getStats(const std::vector<double> &avg, const std::vector<double>
  * @param { &const int } NDVar - Flag to decide if the algorithm is going to
  * normalize the dependent variable or not
  *
- * @return { (updateStats call) -> bool }
+ * @return { bool } true if it succeeded. The stats of the normalized matrix are
+ * computed in the same pass.
  * */
 bool Dataset::normalize(const int &NDVar) {
   // Normalize the dependent variable?
@@ -123,37 +415,46 @@ bool Dataset::normalize(const int &NDVar) {
   // !0 = No --> Normalize the columns starting from Ci = 1
   int Ci = (NDVar == 0) ? 0 : 1;
 
-  for (int j = Ci; j < colN; ++j)
-    for (int i = 0; i < rowN; ++i) M[i][j] = (M[i][j] - stats[j].avg) / stats[j].stdDev;
+  // Columns before Ci go through x' = (x - 0) * 1, which leaves them untouched
+  std::vector<double> shift(colN, 0.0), scale(colN, 1.0);
+  for (int j = Ci; j < colN; ++j) {
+    shift[j] = stats[j].avg;
+    scale[j] = 1.0 / stats[j].stdDev;
+  }
+
+  // Normalizes and recomputes the statistics in the same pass
+  storeStats(stats, transformAndMeasure(*this, shift.data(), scale.data()));
+
+  return ((int)stats.size() == colN);
+}
 
-  return (updateStats());
+// Exchanges the contents of rows i and j.
+void Dataset::swapRows(int i, int j) {
+  if (_layout == Layout::ROW_MAJOR)
+    std::swap_ranges(M[i], M[i] + colN, M[j]);
+  else
+    for (int k = 0; k < colN; ++k) std::swap(at(i, k), at(j, k));
 }
 
 int Dataset::partition(int col, int l, int r) {
-  double *Temp;
-
-  double Pivo = M[l][col];
+  double Pivo = at(l, col);
   int i = l;
   int j = r + 1;
 
   while (true) {
     do {
       ++i;
-    } while ((i <= r) && (M[i][col] >= Pivo));  // crescente --> <=; decrescente --> >=
+    } while ((i <= r) && (at(i, col) >= Pivo));  // crescente --> <=; decrescente --> >=
 
     do {
       --j;
-    } while (M[j][col] < Pivo);  // crescente --> >; decrescente --> <
+    } while (at(j, col) < Pivo);  // crescente --> >; decrescente --> <
 
     if (i >= j) break;
-    Temp = M[i];
-    M[i] = M[j];
-    M[j] = Temp;
+    swapRows(i, j);
   }
 
-  Temp = M[l];
-  M[l] = M[j];
-  M[j] = Temp;
+  swapRows(l, j);
 
   return j;
 }
@@ -1,21 +1,30 @@
+#include <fmt/core.h>
 #include <stdlib.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
 #include <fstream>
 #include <sahga/structures/dataset.hpp>
 #include <sahga/structures/graph.hpp>
+#include <sahga/structures/spatial_index.hpp>
+#include <sahga/utils/binary_format.hpp>
 #include <sahga/utils/utils.hpp>
+#include <stdexcept>
 #include <vector>
 
 Graph::Graph() {
   node.clear();
   nNodes = 0;
   type = Graph::UNDEFINED;
+  neighbors = 8;
+  radius = 0;
 }
 
 Graph::~Graph() {
-  int i;
-
-  for (i = 0; i < nNodes; ++i) node[i].edge.clear();
+  // A moved-from graph keeps nNodes but not its nodes
+  for (TNode &n : node) n.edge.clear();
   node.clear();
   nNodes = 0;
 }
@@ -32,82 +41,490 @@ Graph *Graph::insert(const TNode &node) {
 Graph *Graph::copy(const Graph &src) {
   nNodes = src.nNodes;
   type = src.type;
+  neighbors = src.neighbors;
   node = src.node;
 
+  radius = src.radius;
+  index = src.index ? std::make_shared<SpatialIndex>(*src.index) : nullptr;
+  slotOfNode = src.slotOfNode;
+  nodeOfSlot = src.nodeOfSlot;
+  reach = src.reach;
+
+  return this;
+}
+
+Graph *Graph::setNeighbors(const int32_t &neighbors) {
+  this->neighbors = neighbors;
   return this;
 }
 
+// Weight of the edge between two related points `dist` km apart under the MPG criteria.
+double Graph::edgeWeight(MPGTypes type, double dist, double R) {
+  switch (type) {
+    case HALFRADIUM:
+      // Up to (1/2 radius) the weight is 1, between (1/2 radius) and radius it is 0.5
+      return (dist <= (R / 2)) ? 1 : 0.5;
+    case UMBD:
+      return 1.0 / dist;
+    case UMBD2:
+      return 1.0 / (dist * dist);
+    case KNNIDW:
+      // Coincident points weigh as much as the node itself
+      return (dist > 0) ? 1.0 / dist : 1;
+    default:
+      return 1;
+  }
+}
+
+// Side (degrees) of the spatial index cells. Radius queries want cells about R wide;
+// nearest-neighbor queries want about `neighbors` points per cell.
+static double indexCellSize(const Dataset &M, const double &R, int32_t neighbors) {
+  double radiusCell = R / Utils::constants::KM_PER_DEGREE;
+  if ((neighbors <= 0) || (M.rowN == 0)) return (radiusCell > 0) ? radiusCell : 1;
+
+  double xMin = M.M[0][1], xMax = M.M[0][1], yMin = M.M[0][2], yMax = M.M[0][2];
+  for (int i = 1; i < M.rowN; ++i) {
+    xMin = std::min(xMin, M.M[i][1]);
+    xMax = std::max(xMax, M.M[i][1]);
+    yMin = std::min(yMin, M.M[i][2]);
+    yMax = std::max(yMax, M.M[i][2]);
+  }
+
+  // Coincident points all share one cell whatever its size
+  const double extent = std::max(xMax - xMin, yMax - yMin);
+  if (!(extent > 0)) return (radiusCell > 0) ? radiusCell : 1;
+
+  // Collinear points spread along one side only: the other side is given the width a cell
+  // would have if they were spread along a line, so the area stays close to what they cover
+  const double thinnest = extent * neighbors / M.rowN;
+  double area = std::max(xMax - xMin, thinnest) * std::max(yMax - yMin, thinnest);
+  double densityCell = std::sqrt(area * neighbors / M.rowN);
+
+  double cell = (radiusCell > 0) ? std::min(radiusCell, densityCell) : densityCell;
+  // No more than a million cells across the points
+  return std::max(cell, 1e-6 * extent);
+}
+
 Graph *Graph::createMPG(const Dataset &M, const double &R, int T) {
-  int i, j;
-  double dist;
+  int i;
   TNode node;
   TEdge edge;
 
   type = (MPGTypes)T;
+  const bool nearest = (type == KNN) || (type == KNNIDW);
+
+  // Columns of M --> #id;long;lat;presence(1)/absence(0). The index outlives this call
+  // so that insertPoints/removePoints only revisit the affected neighborhoods.
+  radius = R;
+  index = std::make_shared<SpatialIndex>(indexCellSize(M, R, nearest ? neighbors : 0));
+  slotOfNode.assign(nNodes, -1);
+  nodeOfSlot.clear();
+  reach.clear();
+  for (i = 0; i < M.rowN; ++i) {
+    int32_t slot = index->insert(M.M[i][1], M.M[i][2], (int32_t)M.M[i][3]);
+    slotOfNode.push_back(slot);
+    nodeOfSlot.push_back(nNodes + i);
+    reach.push_back(0);
+  }
+
+  std::vector<SpatialIndex::Neighbor> related;
+
   // Para cada ponto (linha da matriz)
   for (i = 0; i < M.rowN; ++i) {
     node.edge.clear();
-    node.nodeId = (int)M.M[i][0];  // Seta o #id do n�
-    node.nRel = 1;                 // O n� est� relacionado consigo mesmo
+    node.nodeId = (int)M.M[i][0];  // Seta o #id do nó
+    node.nRel = 1;                 // O nó está relacionado consigo mesmo
     edge.nodeId = node.nodeId;     // Seta numa aresta o #id de seu auto-relacionamento
     edge.weight = 1;               // Seta nesta mesma aresta o peso de seu
                                    // auto-relacionamento
-    node.edge.push_back(edge);     // Insere a aresta na lista de arestas do n�
-
-    // Para cada ponto (linha da matriz)
-    for (j = 0; j < M.rowN; ++j) {
-      // Comparando dois pontos diferentes e do mesmo tipo (presença ou
-      // ausência)
-      if ((i != j) && (M.M[i][3] == M.M[j][3])) {
-        dist = Utils::miscellaneous::distance(M.M[i][1], M.M[i][2], M.M[j][1], M.M[j][2]);
-
-        switch (type) {
-          case UNDEFINED: {
-            break;
-          }
-          case HALFRADIUM: {
-            // Se a distância entre os dois pontos for at� (1/2 raio)
-            if (dist <= (R / 2)) {
-              ++node.nRel;                   // Incrementa o contador de relacionamentos do n�
-              edge.nodeId = (int)M.M[j][0];  // Seta numa aresta o #id do n� j
-                                             // relacionado ao n� i
-              edge.weight = 1;               // Seta nesta mesma aresta o peso do
-                                             // relacionamento entre os n�s i e j (1)
-              node.edge.push_back(edge);     // Insere a aresta na lista de arestas do n�
-            } else {
-              if (dist <= R) {  // Se a distância estiver estiver entre (1/2
-                                // aio) e raio o peso ser� (0.5)
-                ++node.nRel;
-                edge.nodeId = (int)M.M[j][0];
-                edge.weight = 0.5;
-                node.edge.push_back(edge);
-              }
-            }
-            break;
-          }
-          case UMBD: {
-            if (dist <= R) {
-              ++node.nRel;
-              edge.nodeId = (int)M.M[j][0];
-              edge.weight = 1.0 / dist;
-              node.edge.push_back(edge);
-            }
-            break;
-          }
-          case UMBD2: {
-            if (dist <= R) {  // Se dist�ncia menor que Raio o peso ser� cal
-                              // ulado por 1/(d^2)
-              ++node.nRel;
-              edge.nodeId = (int)M.M[j][0];
-              edge.weight = 1.0 / (dist * dist);
-              node.edge.push_back(edge);
-            }
-            break;
-          }
+    node.edge.push_back(edge);     // Insere a aresta na lista de arestas do nó
+
+    // Only points of the same type (presence or absence) are related
+    const int32_t label = (int32_t)M.M[i][3];
+
+    if (type == UNDEFINED) {
+      related.clear();
+    } else if (nearest) {
+      // Already sorted by distance, closest first
+      index->nearest(M.M[i][1], M.M[i][2], neighbors, label, R, related, i);
+      reach[i] = ((int32_t)related.size() == neighbors) ? related.back().distance
+                 : (R > 0)                               ? R
+                                                         : HUGE_VAL;
+    } else {
+      index->radius(M.M[i][1], M.M[i][2], R, label, related, i);
+      // Keep the edges in row order, as the exhaustive search produced them
+      std::sort(related.begin(), related.end(),
+                [](const SpatialIndex::Neighbor &a, const SpatialIndex::Neighbor &b) {
+                  return a.slot < b.slot;
+                });
+    }
+
+    for (const SpatialIndex::Neighbor &neighbor : related) {
+      ++node.nRel;
+      edge.nodeId = (int)M.M[neighbor.slot][0];
+      edge.weight = edgeWeight(type, neighbor.distance, R);
+      node.edge.push_back(edge);
+    }
+
+    insert(node);
+  }
+
+  return this;
+}
+
+/*
+ * Finds, once, the neighbors of every point within R km. Each list is sorted by
+ * distance, so the neighbors within any smaller radius are a prefix of it.
+ *
+ * @param { const Dataset & } M - Points (#id;long;lat;presence/absence).
+ * @param { const double & } R - Largest radius (km) that will be derived from the table.
+ *
+ * @return { TNeighborTable } The neighbor lists of all points.
+ * */
+TNeighborTable Graph::findNeighbors(const Dataset &M, const double &R) {
+  TNeighborTable table;
+  table.radius = R;
+  table.offset.reserve(M.rowN + 1);
+  table.offset.push_back(0);
+
+  SpatialIndex index(indexCellSize(M, R, 0));
+  for (int i = 0; i < M.rowN; ++i) index.insert(M.M[i][1], M.M[i][2], (int32_t)M.M[i][3]);
+
+  std::vector<SpatialIndex::Neighbor> related;
+  for (int i = 0; i < M.rowN; ++i) {
+    index.radius(M.M[i][1], M.M[i][2], R, (int32_t)M.M[i][3], related, i);
+    std::sort(related.begin(), related.end(),
+              [](const SpatialIndex::Neighbor &a, const SpatialIndex::Neighbor &b) {
+                return (a.distance < b.distance)
+                       || ((a.distance == b.distance) && (a.slot < b.slot));
+              });
+
+    table.neighbor.insert(table.neighbor.end(), related.begin(), related.end());
+    table.offset.push_back((int32_t)table.neighbor.size());
+  }
+
+  return table;
+}
+
+/*
+ * Builds the MPG for radius R out of a neighbor table built for a radius >= R. Edges
+ * come out sorted by distance rather than by row. KNN and KNNIDW with R <= 0 take the
+ * nearest points of the table, so their reach is still that of the table.
+ *
+ * @param { const Dataset & } M - The same points the table was built from.
+ * @param { const TNeighborTable & } table - Result of `findNeighbors`.
+ * @param { const double & } R - Radius (km) of this MPG, or the radius limit for KNN, KNNIDW.
+ * @param { int32_t } T - MPG type.
+ * */
+Graph *Graph::createMPG(const Dataset &M, const TNeighborTable &table, const double &R, int T) {
+  if (R > table.radius)
+    throw std::runtime_error(fmt::format(
+        "MPG radius {} km is outside the neighbor table radius of {} km", R, table.radius));
+
+  TNode node;
+  TEdge edge;
+
+  type = (MPGTypes)T;
+  radius = R;  // Recorded by saveBinary, so predictions use the same neighborhood
+  const bool nearest = (type == KNN) || (type == KNNIDW);
+  const bool limited = !nearest || (R > 0);  // KNN with R <= 0: any point of the table
+
+  for (int i = 0; i < M.rowN; ++i) {
+    node.edge.clear();
+    node.nodeId = (int)M.M[i][0];
+    node.nRel = 1;
+    edge.nodeId = node.nodeId;
+    edge.weight = 1;
+    node.edge.push_back(edge);
+
+    for (int32_t k = table.offset[i]; (k < table.offset[i + 1]) && (type != UNDEFINED); ++k) {
+      const SpatialIndex::Neighbor &neighbor = table.neighbor[k];
+      if ((limited && (neighbor.distance > R)) || (nearest && (node.nRel > neighbors))) break;
+
+      ++node.nRel;
+      edge.nodeId = (int)M.M[neighbor.slot][0];
+      edge.weight = edgeWeight(type, neighbor.distance, R);
+      node.edge.push_back(edge);
+    }
+
+    insert(node);
+  }
+
+  return this;
+}
+
+/*
+ * Builds the MPG of a subset of the points out of a neighbor table of all of them, as if
+ * the other points did not exist: their edges are dropped and nearest-neighbor criteria
+ * move on to the next point of the subset. The nodes are numbered 1..rows.size() in the
+ * order of rows, so they match a Dataset holding those rows in that order.
+ *
+ * @param { const Dataset & } M - The same points the table was built from.
+ * @param { const TNeighborTable & } table - Result of `findNeighbors`.
+ * @param { const std::vector<int32_t> & } rows - Rows of M in the MPG.
+ * @param { const double & } R - Radius (km) of this MPG, or the radius limit for KNN, KNNIDW.
+ * @param { int32_t } T - MPG type.
+ * */
+Graph *Graph::createMPG(const Dataset &M, const TNeighborTable &table,
+                        const std::vector<int32_t> &rows, const double &R, int T) {
+  if (R > table.radius)
+    throw std::runtime_error(fmt::format(
+        "MPG radius {} km is outside the neighbor table radius of {} km", R, table.radius));
+
+  TNode node;
+  TEdge edge;
+
+  type = (MPGTypes)T;
+  radius = R;
+  const bool nearest = (type == KNN) || (type == KNNIDW);
+
+  const bool limited = !nearest || (R > 0);
+
+  // Node of each row of M, 0 for the rows left out
+  std::vector<int32_t> nodeOfRow(M.rowN, 0);
+  for (size_t k = 0; k < rows.size(); ++k) nodeOfRow[rows[k]] = (int32_t)k + 1;
+
+  for (size_t k = 0; k < rows.size(); ++k) {
+    const int32_t i = rows[k];
+    node.edge.clear();
+    node.nodeId = (int)k + 1;
+    node.nRel = 1;
+    edge.nodeId = node.nodeId;
+    edge.weight = 1;
+    node.edge.push_back(edge);
+
+    for (int32_t n = table.offset[i]; (n < table.offset[i + 1]) && (type != UNDEFINED); ++n) {
+      const SpatialIndex::Neighbor &neighbor = table.neighbor[n];
+      if ((limited && (neighbor.distance > R)) || (nearest && (node.nRel > neighbors))) break;
+      if (nodeOfRow[neighbor.slot] == 0) continue;
+
+      ++node.nRel;
+      edge.nodeId = nodeOfRow[neighbor.slot];
+      edge.weight = edgeWeight(type, neighbor.distance, R);
+      node.edge.push_back(edge);
+    }
+
+    insert(node);
+  }
+
+  return this;
+}
+
+/*
+ * Builds one MPG per radius with a single neighbor search at the largest radius.
+ *
+ * @param { const Dataset & } M - Points (#id;long;lat;presence/absence).
+ * @param { const std::vector<double> & } radii - Radii (km) of the MPGs.
+ * @param { int32_t } T - MPG type shared by every MPG.
+ * @param { const int32_t & } neighbors - Neighbors per node for KNN, KNNIDW.
+ *
+ * @return { std::vector<Graph> } The MPGs, in the same order as radii.
+ * */
+std::vector<Graph> Graph::createMPGSweep(const Dataset &M, const std::vector<double> &radii,
+                                         int32_t T, const int32_t &neighbors) {
+  std::vector<Graph> graphs(radii.size());
+  if (radii.empty()) return graphs;
+
+  const TNeighborTable table = findNeighbors(M, *std::max_element(radii.begin(), radii.end()));
+
+  for (size_t r = 0; r < radii.size(); ++r)
+    graphs[r].setNeighbors(neighbors)->createMPG(M, table, radii[r], T);
+
+  return graphs;
+}
+
+// Every node of the same type as slot within R km (R may be HUGE_VAL).
+void Graph::candidates(int32_t slot, double R, std::vector<SpatialIndex::Neighbor> &out) {
+  const SpatialIndex::Point &p = index->point(slot);
+
+  if (R != HUGE_VAL) {
+    index->radius(p.x, p.y, R, p.label, out, slot);
+    return;
+  }
+
+  out.clear();
+  for (int32_t q = 0; q < index->slots(); ++q) {
+    const SpatialIndex::Point &other = index->point(q);
+    if ((q != slot) && other.alive && (other.label == p.label))
+      out.push_back({q, Utils::miscellaneous::distance(p.x, p.y, other.x, other.y)});
+  }
+}
+
+// Rebuilds the edges of the node in slot from its current nearest neighbors.
+void Graph::relate(int32_t slot) {
+  std::vector<SpatialIndex::Neighbor> related;
+  const SpatialIndex::Point &p = index->point(slot);
+  TNode &current = node[nodeOfSlot[slot]];
+
+  index->nearest(p.x, p.y, neighbors, p.label, radius, related, slot);
+
+  current.edge.resize(1);  // Keeps only the self relationship
+  current.nRel = 1;
+  for (const SpatialIndex::Neighbor &neighbor : related) {
+    ++current.nRel;
+    current.edge.push_back(
+        {node[nodeOfSlot[neighbor.slot]].nodeId, edgeWeight(type, neighbor.distance, radius)});
+  }
+
+  reach[slot] = ((int32_t)related.size() == neighbors) ? related.back().distance
+                : (radius > 0)                          ? radius
+                                                        : HUGE_VAL;
+}
+
+/*
+ * Appends the points of M to an MPG built by createMPG(M, R, T), updating only the
+ * neighborhoods the new points fall into. New nodes get the ids nNodes + 1, nNodes + 2,
+ * ... so they line up with rows appended to the data matrix; the #id column is ignored.
+ *
+ * @param { const Dataset & } M - New points (#id;long;lat;presence/absence).
+ * */
+Graph *Graph::insertPoints(const Dataset &M) {
+  if (!index) throw std::runtime_error("Graph::insertPoints needs an MPG built by createMPG");
+  if (index.use_count() > 1) index = std::make_shared<SpatialIndex>(*index);
+
+  const bool nearest = (type == KNN) || (type == KNNIDW);
+  std::vector<SpatialIndex::Neighbor> related;
+
+  // Inserting only ever shrinks the reach of existing nodes, so one scan bounds it.
+  double reachMax = 0;
+  if (nearest)
+    for (int32_t slot = 0; slot < index->slots(); ++slot)
+      if (index->point(slot).alive) reachMax = std::max(reachMax, reach[slot]);
+
+  for (int i = 0; i < M.rowN; ++i) {
+    TNode current;
+    current.nodeId = nNodes + 1;
+    current.nRel = 1;
+    current.edge.push_back({current.nodeId, 1});
+
+    const int32_t slot = index->insert(M.M[i][1], M.M[i][2], (int32_t)M.M[i][3]);
+    slotOfNode.push_back(slot);
+    nodeOfSlot.push_back(nNodes);
+    reach.push_back(0);
+    insert(current);
+
+    if (type == UNDEFINED) continue;
+
+    if (nearest) {
+      relate(slot);
+
+      // Nodes that may now count the new point among their nearest neighbors
+      candidates(slot, reachMax, related);
+      for (const SpatialIndex::Neighbor &neighbor : related)
+        if (neighbor.distance <= reach[neighbor.slot]) relate(neighbor.slot);
+
+      reachMax = std::max(reachMax, reach[slot]);
+    } else {
+      // Radius criteria are symmetric: relate both ends
+      index->radius(M.M[i][1], M.M[i][2], radius, (int32_t)M.M[i][3], related, slot);
+      std::sort(related.begin(), related.end(),
+                [](const SpatialIndex::Neighbor &a, const SpatialIndex::Neighbor &b) {
+                  return a.slot < b.slot;
+                });
+
+      TNode &added = node[nodeOfSlot[slot]];
+      for (const SpatialIndex::Neighbor &neighbor : related) {
+        TNode &other = node[nodeOfSlot[neighbor.slot]];
+        double weight = edgeWeight(type, neighbor.distance, radius);
+
+        added.edge.push_back({other.nodeId, weight});
+        ++added.nRel;
+        other.edge.push_back({added.nodeId, weight});
+        ++other.nRel;
+      }
+    }
+  }
+
+  return this;
+}
+
+/*
+ * Removes nodes from an MPG built by createMPG(M, R, T), updating only the
+ * neighborhoods they belonged to. The remaining nodes are renumbered 1..nNodes in
+ * their current order, so removing the same rows from the data matrix keeps the
+ * #id --> row correspondence.
+ *
+ * @param { const std::vector<int32_t> & } nodeIds - Ids of the nodes to remove.
+ * */
+Graph *Graph::removePoints(const std::vector<int32_t> &nodeIds) {
+  if (!index) throw std::runtime_error("Graph::removePoints needs an MPG built by createMPG");
+  if (index.use_count() > 1) index = std::make_shared<SpatialIndex>(*index);
+
+  const bool nearest = (type == KNN) || (type == KNNIDW);
+  std::vector<SpatialIndex::Neighbor> related;
+
+  int32_t maxId = 0;
+  for (const TNode &current : node) maxId = std::max(maxId, current.nodeId);
+  std::vector<int32_t> positionOfId(maxId + 1, -1);
+  for (int32_t i = 0; i < nNodes; ++i) positionOfId[node[i].nodeId] = i;
+
+  double reachMax = 0;
+  if (nearest)
+    for (int32_t slot = 0; slot < index->slots(); ++slot)
+      if (index->point(slot).alive) reachMax = std::max(reachMax, reach[slot]);
+
+  std::vector<bool> removed(nNodes, false);
+  for (int32_t id : nodeIds) {
+    if ((id < 0) || (id > maxId) || (positionOfId[id] < 0) || removed[positionOfId[id]]) continue;
+
+    const int32_t position = positionOfId[id];
+    const int32_t slot = slotOfNode[position];
+    if (slot < 0) throw std::runtime_error(fmt::format("Node {} is not in the MPG index", id));
+    removed[position] = true;
+
+    if (nearest) {
+      candidates(slot, reachMax, related);
+      index->remove(slot);
+
+      // Nodes that had the removed point among their nearest neighbors
+      for (const SpatialIndex::Neighbor &neighbor : related)
+        if (neighbor.distance <= reach[neighbor.slot]) {
+          relate(neighbor.slot);
+          reachMax = std::max(reachMax, reach[neighbor.slot]);
+        }
+    } else {
+      const SpatialIndex::Point &p = index->point(slot);
+      if (type != UNDEFINED) index->radius(p.x, p.y, radius, p.label, related, slot);
+      else related.clear();
+
+      for (const SpatialIndex::Neighbor &neighbor : related) {
+        TNode &other = node[nodeOfSlot[neighbor.slot]];
+        auto edge = std::find_if(other.edge.begin(), other.edge.end(),
+                                 [id](const TEdge &e) { return e.nodeId == id; });
+        if (edge != other.edge.end()) {
+          other.edge.erase(edge);
+          --other.nRel;
         }
       }
+
+      index->remove(slot);
     }
-    insert(node);
+
+    nodeOfSlot[slot] = -1;
+  }
+
+  // Compacts the nodes and renumbers the ids of the survivors
+  std::vector<int32_t> newId(maxId + 1, -1);
+  int32_t kept = 0;
+  for (int32_t i = 0; i < nNodes; ++i) {
+    if (removed[i]) continue;
+
+    newId[node[i].nodeId] = kept + 1;
+    if (kept != i) {
+      node[kept] = std::move(node[i]);
+      slotOfNode[kept] = slotOfNode[i];
+    }
+    nodeOfSlot[slotOfNode[kept]] = kept;
+    ++kept;
+  }
+
+  node.resize(kept);
+  slotOfNode.resize(kept);
+  nNodes = kept;
+
+  for (TNode &current : node) {
+    current.nodeId = newId[current.nodeId];
+    for (TEdge &edge : current.edge) edge.nodeId = newId[edge.nodeId];
   }
 
   return this;
@@ -133,6 +550,12 @@ Graph *Graph::save(const std::string &inFileName, const double &R, const std::st
     case UMBD2:
       outFile << "1/(d^2)" << std::endl;
       break;
+    case KNN:
+      outFile << "kNN (k = " << neighbors << ")" << std::endl;
+      break;
+    case KNNIDW:
+      outFile << "kNN 1/d (k = " << neighbors << ")" << std::endl;
+      break;
   }
 
   outFile << "//Formato da MPG --> #id;n;Rel1;Rel2;...;Reln;W1;W2;...;Wn" << std::endl;
@@ -148,3 +571,72 @@ Graph *Graph::save(const std::string &inFileName, const double &R, const std::st
 
   return this;
 }
+
+/*
+ * Saves the graph (MPG) in the binary MPG format (see Utils::binary). When M is given
+ * its rows are stored as the attributes of the nodes, in node order. The file is
+ * assembled in memory and written at once.
+ *
+ * @param { const std::string & } outFileName - Path of the binary MPG.
+ * @param { const Dataset * } M - Optional node attributes, one row per node.
+ * */
+Graph *Graph::saveBinary(const std::string &outFileName, const Dataset *M) {
+  using namespace Utils::binary;
+  static_assert((sizeof(TEdge) == sizeof(MPGEdge))
+                    && (offsetof(TEdge, weight) == offsetof(MPGEdge, weight)),
+                "TEdge must match the binary MPG edge layout");
+
+  if ((M != nullptr) && (M->rowN != nNodes))
+    throw std::runtime_error(
+        fmt::format("MPG has {} nodes but the attribute matrix has {} rows", nNodes, M->rowN));
+
+  int64_t nEdges = 0;
+  for (int i = 0; i < nNodes; ++i) nEdges += node[i].nRel;
+
+  const int32_t nVars = (M != nullptr) ? M->colN : 0;
+  const uint64_t idsAt = sizeof(MPGHeader);
+  const uint64_t offsetsAt = align8(idsAt + sizeof(int32_t) * nNodes);
+  const uint64_t edgesAt = offsetsAt + sizeof(int64_t) * (nNodes + 1);
+  const uint64_t dataAt = edgesAt + sizeof(MPGEdge) * nEdges;
+  const uint64_t size = dataAt + sizeof(double) * nNodes * nVars;
+
+  std::vector<char> buffer(size, 0);
+  int32_t *ids = (int32_t *)(buffer.data() + idsAt);
+  int64_t *offsets = (int64_t *)(buffer.data() + offsetsAt);
+  MPGEdge *edges = (MPGEdge *)(buffer.data() + edgesAt);
+  double *data = (double *)(buffer.data() + dataAt);
+
+  offsets[0] = 0;
+  for (int i = 0; i < nNodes; ++i) {
+    ids[i] = node[i].nodeId;
+    offsets[i + 1] = offsets[i] + node[i].nRel;
+    // Field by field, so the padding of TEdge never reaches the file or its checksum
+    for (int j = 0; j < node[i].nRel; ++j) {
+      MPGEdge &edge = edges[offsets[i] + j];
+      edge = MPGEdge{};
+      edge.nodeId = node[i].edge[j].nodeId;
+      edge.padding = 0;
+      edge.weight = node[i].edge[j].weight;
+    }
+    if (nVars > 0) memcpy(data + (int64_t)i * nVars, M->M[i], sizeof(double) * nVars);
+  }
+
+  MPGHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MPG_MAGIC, sizeof(header.magic));
+  header.version = MPG_VERSION;
+  header.type = type;
+  header.radius = radius;
+  header.neighbors = neighbors;
+  header.nNodes = nNodes;
+  header.nEdges = nEdges;
+  header.nVars = nVars;
+  header.checksum = Utils::miscellaneous::hash(buffer.data() + idsAt, size - idsAt);
+  memcpy(buffer.data(), &header, sizeof(header));
+
+  std::ofstream outFile(outFileName, std::ios::binary | std::ios::trunc);
+  outFile.write(buffer.data(), (std::streamsize)size);
+  if (!outFile) throw std::runtime_error(fmt::format("Failed to write {}", outFileName));
+
+  return this;
+}
@@ -1,4 +1,8 @@
 #include <sahga/structures/layer.hpp>
+#include <sahga/utils/mapped_file.hpp>
+#include <sahga/utils/parallel.hpp>
+#include <sahga/utils/statistics.hpp>
+#include <sahga/utils/tokenizer.hpp>
 
 Layer::Layer()
     : layerName(""),
@@ -16,53 +20,126 @@ Layer::Layer()
 
 Layer::~Layer() { delete dataset; }
 
+// Grid rows per chunk below which Layer::load parses on a single thread.
+static const int64_t LOAD_GRAIN = 64;
+
+/*
+ * Loads an ESRI ASCII grid. The file is mapped, its rows are parsed in parallel
+ * into the contiguous grid buffer, and min, max, avg and stdDev (over the cells
+ * that are not noData) are computed in the same pass. Cells past the end of a short
+ * row or of a truncated file are noData.
+ *
+ * @param { std::string } fileName - Path of the .asc file.
+ * */
 Layer *Layer::load(const std::string &fileName) {
-  std::ifstream inputStream;
+  std::unique_ptr<MappedFile> file;
 
-  inputStream.open(fileName.c_str());
-
-  if (!inputStream.is_open()) {
+  try {
+    file = std::make_unique<MappedFile>(fileName);
+  } catch (const std::runtime_error &) {
     fmt::print("Erro ao abrir o arquivo {}.\n", fileName);
-    inputStream.clear();
     exit(0);
-  } else {
-    std::string line;
-    getline(inputStream, line);
-
-    using namespace Utils::filemanagement;
-
-    while ((line != "") && (isalpha(line[0]))) {
-      std::string subString = splitOnce(line, ' ');
+  }
 
-      if (subString == "NCOLS") colN = (int32_t)getNumber(line, ' ');
-      if (subString == "NROWS") rowN = (int32_t)getNumber(line, ' ');
-      if (subString == "XLLCORNER") xCorner = getNumber(line, ' ');
-      if (subString == "YLLCORNER") yCorner = getNumber(line, ' ');
-      if (subString == "CELLSIZE") cellSize = getNumber(line, ' ');
-      if (subString == "NODATA_VALUE") noData = getNumber(line, ' ');
+  if (layerName == "") layerName = std::filesystem::path(fileName).stem().string();
+
+  using Utils::parsing::Tokenizer;
+  std::vector<std::string_view> lines
+      = Utils::parsing::lines(std::string_view(file->data(), file->size()));
+
+  size_t line = readHeader(lines);
+
+  // Row boundaries: every non blank line after the header holds one row of the grid
+  lines.erase(lines.begin(), lines.begin() + line);
+  lines.erase(std::remove_if(lines.begin(), lines.end(),
+                             [](std::string_view row) { return row.empty(); }),
+              lines.end());
+  const int64_t rows = std::min<int64_t>(rowN, lines.size());
+
+  dataset = new Dataset();
+  dataset->reset(rowN, colN);
+
+  // Rows are parsed in parallel straight into the grid buffer, and each one is
+  // reduced to moments and extremes while it is still in cache.
+  using namespace Utils::statistics;
+  struct Summary {
+    Moments moments;
+    double min, max;
+  };
+  std::vector<Summary> partial(Utils::parallel::chunkCount(rowN, LOAD_GRAIN),
+                               {{0, 0, 0}, std::numeric_limits<double>::max(),
+                                std::numeric_limits<double>::lowest()});
+
+  Utils::parallel::forChunks(0, rowN, LOAD_GRAIN, [&](int32_t chunk, int64_t begin, int64_t end) {
+    Summary &summary = partial[chunk];
+
+    for (int64_t i = begin; i < end; ++i) {
+      double *cells = dataset->M[i];
+      int32_t j = 0;
+      if (i < rows) {
+        Tokenizer tokens(lines[i], ' ');
+        double value;
+        for (; (j < colN) && tokens.next(value); ++j) {
+          cells[j] = value;
+          if (value != noData) {
+            summary.min = std::min(summary.min, value);
+            summary.max = std::max(summary.max, value);
+          }
+        }
+      }
+      // Missing rows and the end of short ones have no data, as in TiledRaster::convert
+      std::fill(cells + j, cells + colN, noData);
 
-      getline(inputStream, line);
+      summary.moments = merge(summary.moments, moments(cells, colN, noData));
     }
+  });
+
+  Summary total = {{0, 0, 0}, std::numeric_limits<double>::max(),
+                   std::numeric_limits<double>::lowest()};
+  for (const Summary &chunk : partial) {
+    total.moments = merge(total.moments, chunk.moments);
+    total.min = std::min(total.min, chunk.min);
+    total.max = std::max(total.max, chunk.max);
+  }
 
-    xMax = xCorner + (colN - 1) * cellSize;
-    yMax = yCorner + (rowN - 1) * cellSize;
-
-    dataset = new Dataset();
-    dataset->reset(rowN, colN);
+  min = total.min;
+  max = total.max;
+  avg = total.moments.mean;
+  stdDev = sqrt(total.moments.variance());
 
-    int32_t i = 0;
-    while (!inputStream.eof()) {
-      if (line != "") {
-        for (int32_t j = 0; j < colN; ++j) dataset->M[i][j] = getNumber(line, ' ');
-        ++i;
-      }
-      getline(inputStream, line);
-    }
+  return this;
+}
 
-    minMax();
+/*
+ * Reads the header of an ESRI ASCII grid (NCOLS, NROWS, XLLCORNER, ...) from its
+ * first lines and sets the grid geometry.
+ *
+ * @param { std::vector<std::string_view> } lines - Lines of the grid file.
+ *
+ * @return { size_t } Index of the first line after the header.
+ * */
+size_t Layer::readHeader(const std::vector<std::string_view> &lines) {
+  size_t line = 0;
+  for (; (line < lines.size()) && !lines[line].empty() && isalpha(lines[line][0]); ++line) {
+    Utils::parsing::Tokenizer tokens(lines[line], ' ');
+    std::string_view key;
+    double value = 0;
+    tokens.next(key);
+    tokens.next(value);
+
+    std::string subString = Utils::miscellaneous::upperCase(std::string(key));
+    if (subString == "NCOLS") colN = (int32_t)value;
+    if (subString == "NROWS") rowN = (int32_t)value;
+    if (subString == "XLLCORNER") xCorner = value;
+    if (subString == "YLLCORNER") yCorner = value;
+    if (subString == "CELLSIZE") cellSize = value;
+    if (subString == "NODATA_VALUE") noData = value;
   }
 
-  return this;
+  xMax = xCorner + (colN - 1) * cellSize;
+  yMax = yCorner + (rowN - 1) * cellSize;
+
+  return line;
 }
 
 Layer *Layer::save(const std::string &fileName) {
@@ -88,22 +165,22 @@ Layer *Layer::save(const std::string &fileName) {
 }
 
 Layer *Layer::updateStat() {
-  double sum = 0;
-  double sum2 = 0;
+  using namespace Utils::statistics;
 
-  int32_t N = 0;
-  for (int32_t i = 0; i < rowN; ++i) {
-    for (int32_t j = 0; j < colN; ++j) {
-      if (dataset->M[i][j] != noData) {
-        ++N;
-        sum = sum + dataset->M[i][j];
-        sum2 = sum2 + (dataset->M[i][j] * dataset->M[i][j]);
-      }
-    }
-  }
+  // The grid is one contiguous buffer: split it across threads, masking noData
+  const int64_t cells = (int64_t)rowN * colN;
+  const double *values = dataset->data();
+  std::vector<Moments> partial(Utils::parallel::chunkCount(cells, 1 << 16));
 
-  avg = sum / N;
-  stdDev = sqrt((1.0 / (N - 1)) * (sum2 - (sum * sum) / N));
+  Utils::parallel::forChunks(0, cells, 1 << 16, [&](int32_t chunk, int64_t begin, int64_t end) {
+    partial[chunk] = moments(values + begin, end - begin, noData);
+  });
+
+  Moments total = {0, 0, 0};
+  for (const Moments &chunk : partial) total = merge(total, chunk);
+
+  avg = total.mean;
+  stdDev = sqrt(total.variance());
 
   return this;
 }
@@ -137,26 +214,25 @@ Layer *Layer::scale(const double &SMin, const double &SMax) {
 }
 
 double Layer::getValue(double longitude, double latitude) {
-  if ((longitude < xCorner) || (longitude > xMax) || (latitude < yCorner) || (latitude > yMax))
-    return (noData);
-
-  int32_t x = (int32_t)(fabs(longitude - xCorner) / cellSize);
-  int32_t y = (int32_t)(rowN - (fabs(latitude - yCorner) / cellSize));
-
-  return (dataset->M[y][x]);
+  int32_t row, col;
+  return grid().locate(longitude, latitude, row, col) ? cell(row, col) : noData;
 }
 
-int Layer::getX(double longitude) { return (int)(fabs(longitude - xCorner) / cellSize); }
+int Layer::getX(double longitude) { return grid().column(longitude); }
 
-int Layer::getY(double latitude) { return (int)(rowN - (fabs(latitude - yCorner) / cellSize)); }
+int Layer::getY(double latitude) { return grid().row(latitude); }
+
+Utils::sampling::Grid Layer::grid() const {
+  return {rowN, colN, xCorner, yCorner, cellSize, noData};
+}
 
 double Layer::getLong(int x) { return (xCorner + x * cellSize); }
 
 double Layer::getLat(int y) { return (yCorner + (rowN - 1 - y) * cellSize); }
 
 void Layer::minMax() {
-  min = std::numeric_limits<double>::min();
-  max = std::numeric_limits<double>::max();
+  min = std::numeric_limits<double>::max();
+  max = std::numeric_limits<double>::lowest();
 
   for (int32_t i = 0; i < rowN; ++i)
     for (int32_t j = 0; j < colN; ++j)
@@ -165,3 +241,49 @@ void Layer::minMax() {
         if (max < dataset->M[i][j]) max = dataset->M[i][j];
       }
 }
+
+double Layer::cell(int32_t row, int32_t col) const { return dataset->M[row][col]; }
+
+// getValue of every point.
+void Layer::getValues(Span<const double> longitude, Span<const double> latitude,
+                      Span<double> out) const {
+  const Utils::sampling::Grid grid = this->grid();
+  for (int64_t i = 0; i < out.size(); ++i) {
+    int32_t row, col;
+    out[i] = grid.locate(longitude[i], latitude[i], row, col) ? dataset->M[row][col] : noData;
+  }
+}
+
+/*
+ * Samples the layer at every point (see Utils::sampling::sample). NEAREST matches
+ * getValue.
+ *
+ * @param { Span<const double> } longitude, latitude - Coordinates of the points.
+ * @param { Span<double> } out - One value per point.
+ * @param { Mode } mode - NEAREST, BILINEAR or FOCAL_MEAN.
+ * @param { int32_t } k - Side of the FOCAL_MEAN window.
+ * */
+void Layer::sample(Span<const double> longitude, Span<const double> latitude, Span<double> out,
+                   Utils::sampling::Mode mode, int32_t k) const {
+  if (mode == Utils::sampling::Mode::NEAREST) return getValues(longitude, latitude, out);
+
+  Utils::sampling::sample(
+      grid(), [this](int32_t row, int32_t col) { return dataset->M[row][col]; }, mode, k,
+      longitude, latitude, out);
+}
+
+/*
+ * Replaces every cell by the mean of the k x k window around it, leaving out noData
+ * (see Utils::sampling::focalMean). The cost does not depend on k.
+ *
+ * @param { int32_t } k - Side of the window, in cells.
+ * */
+Layer *Layer::focalMean(int32_t k) {
+  if (dataset == nullptr) return this;
+
+  Utils::sampling::focalMean(grid(), dataset->data(), k, dataset->data());
+  minMax();
+  updateStat();
+
+  return this;
+}
@@ -0,0 +1,185 @@
+#include <fmt/core.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <sahga/structures/layer_stack.hpp>
+#include <sahga/utils/parallel.hpp>
+#include <sahga/utils/utils.hpp>
+#include <stdexcept>
+
+using namespace Utils::binary;
+
+bool LayerStack::sameGrid(const RasterHeader &a, const RasterHeader &b) {
+  return (a.rows == b.rows) && (a.cols == b.cols) && (a.xCorner == b.xCorner)
+         && (a.yCorner == b.yCorner) && (a.cellSize == b.cellSize);
+}
+
+// Hash of the header up to its checksum, then of the band headers.
+static uint64_t stackChecksum(const StackHeader &header, const BandHeader *bands) {
+  const uint64_t seed = Utils::miscellaneous::hash(&header, offsetof(StackHeader, checksum));
+  return Utils::miscellaneous::hash(bands, sizeof(BandHeader) * header.nBands, seed);
+}
+
+/*
+ * Builds a layer stack from tiled rasters, every band in the codec of its raster. The
+ * cube is assembled one band of rows at a time, so only `tileSize` rows of every layer
+ * are held in memory.
+ *
+ * @param { std::vector<const TiledRaster *> } layers - The bands, in order.
+ * @param { std::string } fileName - Path of the stack to write.
+ * */
+void LayerStack::build(const std::vector<const TiledRaster *> &layers,
+                       const std::string &fileName) {
+  if (layers.empty()) throw std::runtime_error("A layer stack needs at least one layer");
+
+  const RasterHeader &grid = layers[0]->header();
+  for (const TiledRaster *layer : layers)
+    if (!sameGrid(grid, layer->header()))
+      throw std::runtime_error(fmt::format("Layer {} is not on the grid of layer {}",
+                                           layer->layerName, layers[0]->layerName));
+
+  const int32_t nBands = (int32_t)layers.size();
+  StackHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, STACK_MAGIC, sizeof(header.magic));
+  header.version = STACK_VERSION;
+  header.nBands = nBands;
+  header.rows = grid.rows;
+  header.cols = grid.cols;
+  header.xCorner = grid.xCorner;
+  header.yCorner = grid.yCorner;
+  header.cellSize = grid.cellSize;
+  header.dataOffset = align64(sizeof(StackHeader) + sizeof(BandHeader) * nBands);
+
+  std::vector<BandHeader> bands(nBands);
+  std::vector<Utils::quantize::Codec> codecs(nBands);
+  for (int32_t b = 0; b < nBands; ++b) {
+    const RasterHeader &raster = layers[b]->header();
+    codecs[b] = layers[b]->codec();
+
+    memset(&bands[b], 0, sizeof(BandHeader));
+    strncpy(bands[b].name, layers[b]->layerName.c_str(), sizeof(bands[b].name) - 1);
+    bands[b].encoding = codecs[b].encoding;
+    bands[b].position = (int32_t)header.recordSize;
+    bands[b].scale = codecs[b].scale;
+    bands[b].offset = codecs[b].offset;
+    bands[b].noData = raster.noData;
+    bands[b].min = raster.min;
+    bands[b].max = raster.max;
+    bands[b].avg = raster.avg;
+    bands[b].stdDev = raster.stdDev;
+    header.recordSize += Utils::quantize::width(codecs[b].encoding);
+  }
+  header.checksum = stackChecksum(header, bands.data());
+
+  Utils::filemanagement::writeAtomically(fileName, [&](const std::string &temporary) {
+    std::ofstream outputStream(temporary, std::ios::binary);
+    if (!outputStream.is_open())
+      throw std::runtime_error(fmt::format("Failed to create {}", temporary));
+
+    outputStream.write((const char *)&header, sizeof(header));
+    outputStream.write((const char *)bands.data(), sizeof(BandHeader) * nBands);
+    const std::string padding(
+        header.dataOffset - sizeof(StackHeader) - sizeof(BandHeader) * nBands, '\0');
+    outputStream.write(padding.data(), padding.size());
+
+    // Every band encodes its rows of a band of rows and copies its codes into the records
+    const int32_t bandRows = std::max(1, grid.tileSize);
+    const uint64_t recordSize = header.recordSize;
+    std::vector<char> records((size_t)bandRows * grid.cols * recordSize);
+
+    for (int32_t first = 0; first < grid.rows; first += bandRows) {
+      const int32_t count = std::min(bandRows, grid.rows - first);
+      const int64_t cells = (int64_t)count * grid.cols;
+
+      Utils::parallel::forChunks(0, nBands, 1, [&](int32_t, int64_t begin, int64_t end) {
+        std::vector<double> values(cells);
+        std::vector<char> codes;
+        for (int64_t b = begin; b < end; ++b) {
+          const size_t width = Utils::quantize::width(codecs[b].encoding);
+          codes.resize(cells * width);
+          layers[b]->read(first, 0, count, grid.cols, values.data(), 1, grid.cols);
+          Utils::quantize::encode(codecs[b], values.data(), cells, codes.data());
+
+          char *target = records.data() + bands[b].position;
+          for (int64_t k = 0; k < cells; ++k)
+            memcpy(target + k * recordSize, codes.data() + k * width, width);
+        }
+      });
+
+      outputStream.write(records.data(), cells * recordSize);
+    }
+
+    outputStream.close();
+    if (!outputStream) throw std::runtime_error(fmt::format("Failed to write {}", temporary));
+  });
+}
+
+LayerStack::LayerStack(const std::string &fileName)
+    : _file(std::make_unique<MappedFile>(fileName)),
+      _header(nullptr),
+      _bands(nullptr),
+      _cube(nullptr) {
+  if ((_file->size() < sizeof(StackHeader)) || (memcmp(_file->data(), STACK_MAGIC, 8) != 0))
+    throw std::runtime_error(fmt::format("{} is not a layer stack", fileName));
+
+  _header = (const StackHeader *)_file->data();
+  if (_header->version != STACK_VERSION)
+    throw std::runtime_error(
+        fmt::format("{}: unsupported layer stack version {}", fileName, _header->version));
+
+  if ((_header->nBands <= 0)
+      || (_header->dataOffset < sizeof(StackHeader) + sizeof(BandHeader) * _header->nBands)
+      || (_file->size() < _header->dataOffset))
+    throw std::runtime_error(fmt::format("{}: truncated layer stack", fileName));
+
+  _bands = (const BandHeader *)(_file->data() + sizeof(StackHeader));
+  if (stackChecksum(*_header, _bands) != _header->checksum)
+    throw std::runtime_error(fmt::format("{}: layer stack checksum mismatch", fileName));
+
+  bool consistent = true;
+  for (int32_t b = 0; b < _header->nBands; ++b) {
+    const BandHeader &band = _bands[b];
+    consistent = consistent && (band.position >= 0)
+                 && (band.position + Utils::quantize::width(band.encoding)
+                     <= _header->recordSize);
+    _codecs.push_back({band.encoding, band.scale, band.offset, band.noData, true});
+  }
+
+  const uint64_t cells = (uint64_t)_header->rows * _header->cols;
+  if (!consistent || (_file->size() != _header->dataOffset + _header->recordSize * cells))
+    throw std::runtime_error(fmt::format("{}: truncated layer stack", fileName));
+
+  _cube = _file->data() + _header->dataOffset;
+}
+
+std::vector<std::string> LayerStack::names() const {
+  std::vector<std::string> result;
+  for (int32_t b = 0; b < _header->nBands; ++b)
+    result.emplace_back(_bands[b].name, strnlen(_bands[b].name, sizeof(_bands[b].name)));
+
+  return result;
+}
+
+void LayerStack::read(int32_t row, int32_t col, int32_t count, double *out) const {
+  const int64_t recordSize = (int64_t)_header->recordSize;
+  const char *first = _cube + ((int64_t)row * _header->cols + col) * recordSize;
+  for (int32_t b = 0; b < _header->nBands; ++b)
+    Utils::quantize::decode(_codecs[b], first + _bands[b].position, count, recordSize, out + b,
+                            _header->nBands);
+}
+
+bool LayerStack::locate(double longitude, double latitude, int32_t &row, int32_t &col) const {
+  const Utils::sampling::Grid grid
+      = {_header->rows, _header->cols, _header->xCorner, _header->yCorner, _header->cellSize, 0};
+  return grid.locate(longitude, latitude, row, col);
+}
+
+void LayerStack::sample(double longitude, double latitude, double *out) const {
+  int32_t row, col;
+  if (locate(longitude, latitude, row, col)) return cell(row, col, out);
+
+  for (int32_t b = 0; b < _header->nBands; ++b) out[b] = _bands[b].noData;
+}
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sahga/structures/spatial_index.hpp>
+#include <sahga/utils/utils.hpp>
+
+SpatialIndex::SpatialIndex(double cellSize)
+    : cellSize((cellSize > 0) && std::isfinite(cellSize) ? cellSize : 1.0),
+      alive(0),
+      minX(std::numeric_limits<int32_t>::max()),
+      minY(std::numeric_limits<int32_t>::max()),
+      maxX(std::numeric_limits<int32_t>::min()),
+      maxY(std::numeric_limits<int32_t>::min()) {}
+
+// Cells past +-2^29 share the border cell, so that the ring and range arithmetic below never
+// leaves int32_t. Clamping keeps the order of the cells, so every search still covers them.
+int32_t SpatialIndex::cellOf(double coordinate) const {
+  constexpr int64_t limit = int64_t(1) << 29;
+  const double cell = std::floor(coordinate / cellSize);
+  if (!(cell > -limit)) return (int32_t)-limit;
+  return (int32_t)std::min((int64_t)cell, limit);
+}
+
+int64_t SpatialIndex::key(int32_t cx, int32_t cy) {
+  return ((int64_t)cx << 32) | (uint32_t)cy;
+}
+
+const std::vector<int32_t> *SpatialIndex::bucket(int32_t cx, int32_t cy) const {
+  auto it = cells.find(key(cx, cy));
+  return (it == cells.end()) ? nullptr : &it->second;
+}
+
+/*
+ * Adds a point to the index.
+ *
+ * @param { double } x, y - Longitude and latitude of the point.
+ * @param { int32_t } label - Class of the point.
+ *
+ * @return { int32_t } The slot that identifies the point from now on.
+ * */
+int32_t SpatialIndex::insert(double x, double y, int32_t label) {
+  const int32_t slot = (int32_t)points.size();
+  const int32_t cx = cellOf(x);
+  const int32_t cy = cellOf(y);
+
+  points.push_back({x, y, label, true});
+  cells[key(cx, cy)].push_back(slot);
+  ++alive;
+
+  minX = std::min(minX, cx);
+  maxX = std::max(maxX, cx);
+  minY = std::min(minY, cy);
+  maxY = std::max(maxY, cy);
+
+  return slot;
+}
+
+/*
+ * Removes the point stored in slot. The slot is not reused.
+ *
+ * @param { int32_t } slot - Slot returned by `insert`.
+ * */
+void SpatialIndex::remove(int32_t slot) {
+  if ((slot < 0) || (slot >= (int32_t)points.size()) || !points[slot].alive) return;
+
+  auto it = cells.find(key(cellOf(points[slot].x), cellOf(points[slot].y)));
+  std::vector<int32_t> &members = it->second;
+  auto position = std::find(members.begin(), members.end(), slot);
+  *position = members.back();
+  members.pop_back();
+  if (members.empty()) cells.erase(it);
+
+  points[slot].alive = false;
+  --alive;
+}
+
+void SpatialIndex::radius(double x, double y, double R, int32_t label, std::vector<Neighbor> &out,
+                          int32_t exclude) const {
+  out.clear();
+  if ((alive == 0) || (R < 0)) return;
+
+  // Small slack so points sitting exactly on the radius are not lost to rounding.
+  const double reach = R / Utils::constants::KM_PER_DEGREE * (1 + 1e-9);
+  const int32_t x0 = std::max(minX, cellOf(x - reach));
+  const int32_t x1 = std::min(maxX, cellOf(x + reach));
+  const int32_t y0 = std::max(minY, cellOf(y - reach));
+  const int32_t y1 = std::min(maxY, cellOf(y + reach));
+
+  for (int32_t cx = x0; cx <= x1; ++cx)
+    for (int32_t cy = y0; cy <= y1; ++cy) {
+      const std::vector<int32_t> *members = bucket(cx, cy);
+      if (members == nullptr) continue;
+
+      for (int32_t slot : *members) {
+        const Point &p = points[slot];
+        if ((slot == exclude) || (p.label != label)) continue;
+
+        double dist = Utils::miscellaneous::distance(x, y, p.x, p.y);
+        if (dist <= R) out.push_back({slot, dist});
+      }
+    }
+}
+
+void SpatialIndex::nearest(double x, double y, int32_t k, int32_t label, double maxRadius,
+                           std::vector<Neighbor> &out, int32_t exclude) const {
+  out.clear();
+  if ((alive == 0) || (k <= 0)) return;
+
+  auto farther = [](const Neighbor &a, const Neighbor &b) { return a.distance < b.distance; };
+  const double kmPerCell = cellSize * Utils::constants::KM_PER_DEGREE;
+  const int32_t cx = cellOf(x);
+  const int32_t cy = cellOf(y);
+
+  // Beyond this ring there are no occupied cells (or no cells within maxRadius).
+  int32_t lastRing = std::max(std::max(cx - minX, maxX - cx), std::max(cy - minY, maxY - cy));
+  if (maxRadius > 0) lastRing = std::min(lastRing, (int32_t)std::ceil(maxRadius / kmPerCell) + 1);
+
+  auto collect = [&](const std::vector<int32_t> &members) {
+    for (int32_t slot : members) {
+      const Point &p = points[slot];
+      if ((slot == exclude) || (p.label != label)) continue;
+
+      double dist = Utils::miscellaneous::distance(x, y, p.x, p.y);
+      if ((maxRadius > 0) && (dist > maxRadius)) continue;
+
+      // Bounded max-heap: the farthest of the current k best sits on top.
+      if ((int32_t)out.size() < k) {
+        out.push_back({slot, dist});
+        std::push_heap(out.begin(), out.end(), farther);
+      } else if (dist < out.front().distance) {
+        std::pop_heap(out.begin(), out.end(), farther);
+        out.back() = {slot, dist};
+        std::push_heap(out.begin(), out.end(), farther);
+      }
+    }
+  };
+  auto visit = [&](int32_t px, int32_t py) {
+    const std::vector<int32_t> *members = bucket(px, py);
+    if (members != nullptr) collect(*members);
+  };
+
+  for (int32_t ring = 0; ring <= lastRing; ++ring) {
+    // Every point in this ring is at least (ring - 1) cells away from the query.
+    if (((int32_t)out.size() == k) && (out.front().distance <= (ring - 1) * kmPerCell)) break;
+
+    // Rings with more cells than are occupied (sparse points, or cells much smaller than the
+    // gaps between them): the occupied cells from this ring on are visited directly instead.
+    if (8 * (int64_t)ring > (int64_t)cells.size()) {
+      for (const auto &cell : cells) {
+        const int64_t dx = (int32_t)(cell.first >> 32) - (int64_t)cx;
+        const int64_t dy = (int32_t)(uint32_t)cell.first - (int64_t)cy;
+        if (std::max(std::abs(dx), std::abs(dy)) >= ring) collect(cell.second);
+      }
+      break;
+    }
+
+    if (ring == 0) {
+      visit(cx, cy);
+      continue;
+    }
+
+    for (int32_t dx = -ring; dx <= ring; ++dx) {
+      visit(cx + dx, cy - ring);
+      visit(cx + dx, cy + ring);
+    }
+    for (int32_t dy = -ring + 1; dy < ring; ++dy) {
+      visit(cx - ring, cy + dy);
+      visit(cx + ring, cy + dy);
+    }
+  }
+
+  std::sort_heap(out.begin(), out.end(), farther);
+}
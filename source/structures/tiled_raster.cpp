@@ -0,0 +1,587 @@
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <sahga/structures/layer.hpp>
+#include <sahga/structures/tiled_raster.hpp>
+#include <sahga/utils/parallel.hpp>
+#include <sahga/utils/quantize.hpp>
+#include <sahga/utils/statistics.hpp>
+#include <sahga/utils/tokenizer.hpp>
+#include <sahga/utils/utils.hpp>
+#include <stdexcept>
+
+using namespace Utils::binary;
+
+//----------------------------------------------------------------------------------------------
+// TileCache
+//----------------------------------------------------------------------------------------------
+
+TileCache::TileCache(size_t capacity) : _capacity(capacity), _size(0), _hits(0), _misses(0) {}
+
+TileCache::Tile TileCache::get(uint64_t key, const std::function<std::vector<double>()> &load) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _tiles.find(key);
+    if (it != _tiles.end()) {
+      _order.splice(_order.begin(), _order, it->second.second);
+      ++_hits;
+      return it->second.first;
+    }
+  }
+
+  // Decode without holding the lock; a tile decoded twice concurrently is kept once
+  Tile tile = std::make_shared<const std::vector<double>>(load());
+  const size_t bytes = tile->size() * sizeof(double);
+  ++_misses;
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto it = _tiles.find(key);
+  if (it != _tiles.end()) return it->second.first;
+
+  _order.push_front(key);
+  _tiles.emplace(key, std::make_pair(tile, _order.begin()));
+  _size += bytes;
+
+  while ((_size > _capacity) && (_order.size() > 1)) {
+    auto last = _tiles.find(_order.back());
+    _size -= last->second.first->size() * sizeof(double);
+    _tiles.erase(last);
+    _order.pop_back();
+  }
+
+  return tile;
+}
+
+size_t TileCache::size() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _size;
+}
+
+//----------------------------------------------------------------------------------------------
+// Tile encoding
+//----------------------------------------------------------------------------------------------
+
+// Codes of a tile, or their RLE runs when compress is set and they are smaller.
+template <typename T>
+static Compression encodeTile(const Utils::quantize::Codec &codec,
+                              const std::vector<double> &cells, bool compress,
+                              std::vector<char> &block) {
+  std::vector<T> values(cells.size());
+  Utils::quantize::encode(codec, cells.data(), cells.size(), values.data());
+  block.assign((const char *)values.data(), (const char *)(values.data() + values.size()));
+  if (!compress) return Compression::NONE;
+
+  std::vector<char> runs;
+  for (size_t i = 0; i < values.size();) {
+    uint32_t count = 1;
+    while ((i + count < values.size()) && (memcmp(&values[i + count], &values[i], sizeof(T)) == 0))
+      ++count;
+
+    runs.insert(runs.end(), (const char *)&count, (const char *)&count + sizeof(count));
+    runs.insert(runs.end(), (const char *)&values[i], (const char *)&values[i] + sizeof(T));
+    if (runs.size() >= block.size()) return Compression::NONE;
+
+    i += count;
+  }
+
+  block.swap(runs);
+  return Compression::RLE;
+}
+
+// Blocks are 8-byte aligned, so raw ones are decoded in place.
+template <typename T>
+static void decodeTile(const Utils::quantize::Codec &codec, const char *block,
+                       const TileEntry &entry, std::vector<double> &cells) {
+  if (entry.compression == Compression::NONE) {
+    const size_t n = std::min(cells.size(), (size_t)entry.size / sizeof(T));
+    Utils::quantize::decode(codec, block, n, cells.data());
+    return;
+  }
+
+  size_t i = 0;
+  for (const char *run = block; (run + sizeof(uint32_t) + sizeof(T) <= block + entry.size)
+                                && (i < cells.size());
+       run += sizeof(uint32_t) + sizeof(T)) {
+    uint32_t count;
+    T code;
+    double value;
+    memcpy(&count, run, sizeof(count));
+    memcpy(&code, run + sizeof(count), sizeof(T));
+    Utils::quantize::decode(codec, &code, 1, &value);
+
+    const size_t last = std::min(cells.size(), i + count);
+    std::fill(cells.begin() + i, cells.begin() + last, value);
+    i = last;
+  }
+}
+
+static Compression encodeTile(const Utils::quantize::Codec &codec,
+                              const std::vector<double> &cells, bool compress,
+                              std::vector<char> &block) {
+  switch (codec.encoding) {
+    case Encoding::INT16:
+      return encodeTile<int16_t>(codec, cells, compress, block);
+    case Encoding::UINT16:
+      return encodeTile<uint16_t>(codec, cells, compress, block);
+    case Encoding::FLOAT32:
+      return encodeTile<float>(codec, cells, compress, block);
+    default:
+      return encodeTile<double>(codec, cells, compress, block);
+  }
+}
+
+// Hash of the header up to its checksum, then of the tile table.
+static uint64_t rasterChecksum(const RasterHeader &header, const TileEntry *entries,
+                               size_t tiles) {
+  const uint64_t seed = Utils::miscellaneous::hash(&header, offsetof(RasterHeader, checksum));
+  return Utils::miscellaneous::hash(entries, sizeof(TileEntry) * tiles, seed);
+}
+
+//----------------------------------------------------------------------------------------------
+// Conversion from ESRI ASCII grids
+//----------------------------------------------------------------------------------------------
+
+// Parses the cells of one grid row into out, leaving noData where the row is short.
+static void parseRow(std::string_view line, int32_t cols, double noData, double *out) {
+  Utils::parsing::Tokenizer tokens(line, ' ');
+  int32_t j = 0;
+  double value;
+  for (; (j < cols) && tokens.next(value); ++j) out[j] = value;
+  std::fill(out + j, out + cols, noData);
+}
+
+// Parses rows [first, first + count) of the grid into band, in parallel.
+static void parseBand(const std::vector<std::string_view> &rows, int32_t first, int32_t count,
+                      int32_t cols, double noData, std::vector<double> &band) {
+  std::fill(band.begin(), band.end(), noData);
+  Utils::parallel::forChunks(0, count, 8, [&](int32_t, int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i)
+      if (first + i < (int64_t)rows.size())
+        parseRow(rows[first + i], cols, noData, band.data() + i * cols);
+  });
+}
+
+/*
+ * Writes a tiled raster of the grid described by header, one band of `tileSize` rows at
+ * a time, twice: the first pass finds the statistics and the narrowest encoding that
+ * holds every cell exactly (INT16, FLOAT32 or FLOAT64), the second one encodes and writes
+ * the tiles of each band. When header.quantization is narrower than that encoding, the
+ * cells are quantized to it instead and the error is kept in the header. Only one band is
+ * ever held in memory. The raster is written to a temporary file and renamed to fileName
+ * once complete.
+ *
+ * @param { RasterHeader } header - Grid, tiling, noData and quantization of the raster.
+ * @param { std::string } fileName - Path of the tiled raster to write.
+ * @param { bool } compress - Stores tiles as RLE runs when that is smaller.
+ * @param { function } readBand - Fills band with the `count` rows from `first`.
+ * */
+static void writeRaster(RasterHeader header, const std::string &fileName, bool compress,
+                        const std::function<void(int32_t first, int32_t count,
+                                                 std::vector<double> &band)> &readBand) {
+  const int32_t tileSize = header.tileSize;
+  const int32_t cols = header.cols;
+  std::vector<double> band((size_t)tileSize * cols);
+
+  // First pass: statistics and encoding
+  using namespace Utils::statistics;
+  Moments moments = {0, 0, 0};
+  double min = std::numeric_limits<double>::max();
+  double max = std::numeric_limits<double>::lowest();
+  bool integral = true;
+  bool float32 = ((double)(float)header.noData == header.noData);
+
+  for (int32_t first = 0; first < header.rows; first += tileSize) {
+    const int32_t count = std::min(tileSize, header.rows - first);
+    readBand(first, count, band);
+
+    moments = merge(moments, Utils::statistics::moments(band.data(), (int64_t)count * cols,
+                                                         header.noData));
+    for (int64_t i = 0; i < (int64_t)count * cols; ++i) {
+      const double value = band[i];
+      if (value == header.noData) continue;
+
+      min = std::min(min, value);
+      max = std::max(max, value);
+      integral = integral && (value == std::floor(value));
+      float32 = float32 && ((double)(float)value == value);
+    }
+  }
+
+  // noData has a code of its own, so only the range of the other cells decides
+  using Utils::quantize::width;
+  const bool int16
+      = integral && (Utils::quantize::fit(Encoding::INT16, min, max, integral).scale == 1);
+  const Encoding exact
+      = int16 ? Encoding::INT16 : (float32 ? Encoding::FLOAT32 : Encoding::FLOAT64);
+  const bool quantized = (header.quantization != Encoding::FLOAT64)
+                         && (width(header.quantization) < width(exact));
+  const Utils::quantize::Codec codec = Utils::quantize::fit(
+      quantized ? header.quantization : exact, min, max, header.noData, integral);
+
+  header.encoding = codec.encoding;
+  header.scale = codec.scale;
+  header.offset = codec.offset;
+  header.min = min;
+  header.max = max;
+  header.avg = moments.mean;
+  header.stdDev = sqrt(moments.variance());
+
+  // Second pass: tiles, written after the header and a tile table filled in at the end
+  std::vector<TileEntry> entries((size_t)header.tilesX * header.tilesY);
+  Utils::filemanagement::writeAtomically(fileName, [&](const std::string &temporary) {
+    std::ofstream outputStream(temporary, std::ios::binary);
+    if (!outputStream.is_open())
+      throw std::runtime_error(fmt::format("Failed to create {}", temporary));
+
+    uint64_t offset = align8(sizeof(RasterHeader) + sizeof(TileEntry) * entries.size());
+    outputStream.write(std::string(offset, '\0').data(), offset);
+
+    std::vector<std::vector<char>> blocks(header.tilesX);
+    std::vector<Utils::quantize::Error> errors(header.tilesX, {0, 0, 0});
+    for (int32_t ty = 0; ty < header.tilesY; ++ty) {
+      const int32_t first = ty * tileSize;
+      const int32_t count = std::min(tileSize, header.rows - first);
+      readBand(first, count, band);
+
+      Utils::parallel::forChunks(0, header.tilesX, 1, [&](int32_t, int64_t begin, int64_t end) {
+        std::vector<double> cells((size_t)tileSize * tileSize);
+        for (int64_t tx = begin; tx < end; ++tx) {
+          std::fill(cells.begin(), cells.end(), header.noData);
+          const int64_t col0 = tx * tileSize;
+          const int64_t width = std::min<int64_t>(tileSize, cols - col0);
+          for (int32_t r = 0; r < count; ++r)
+            std::copy_n(band.begin() + (size_t)r * cols + col0, width,
+                        cells.begin() + (size_t)r * tileSize);
+
+          entries[ty * header.tilesX + tx].compression
+              = encodeTile(codec, cells, compress, blocks[tx]);
+          if (quantized)
+            errors[tx] = Utils::quantize::merge(
+                errors[tx], Utils::quantize::error(codec, cells.data(), cells.size()));
+        }
+      });
+
+      for (int32_t tx = 0; tx < header.tilesX; ++tx) {
+        TileEntry &entry = entries[ty * header.tilesX + tx];
+        entry.offset = offset;
+        entry.size = (uint32_t)blocks[tx].size();
+
+        const uint64_t padded = align8(entry.size);
+        blocks[tx].resize(padded, '\0');
+        outputStream.write(blocks[tx].data(), padded);
+        offset += padded;
+      }
+    }
+
+    Utils::quantize::Error error = {0, 0, 0};
+    for (const Utils::quantize::Error &tile : errors) error = Utils::quantize::merge(error, tile);
+    header.maxError = error.max;
+    header.rmsError = error.rms;
+
+    header.checksum = rasterChecksum(header, entries.data(), entries.size());
+    outputStream.seekp(0);
+    outputStream.write((const char *)&header, sizeof(header));
+    outputStream.write((const char *)entries.data(), sizeof(TileEntry) * entries.size());
+
+    outputStream.close();
+    if (!outputStream) throw std::runtime_error(fmt::format("Failed to write {}", temporary));
+  });
+}
+
+static RasterHeader rasterHeader(int32_t rows, int32_t cols, int32_t tileSize, double xCorner,
+                                 double yCorner, double cellSize, double noData,
+                                 Encoding quantization) {
+  RasterHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, RASTER_MAGIC, sizeof(header.magic));
+  header.version = RASTER_VERSION;
+  header.rows = rows;
+  header.cols = cols;
+  header.tileSize = tileSize;
+  header.tilesX = (cols + tileSize - 1) / tileSize;
+  header.tilesY = (rows + tileSize - 1) / tileSize;
+  header.xCorner = xCorner;
+  header.yCorner = yCorner;
+  header.cellSize = cellSize;
+  header.noData = noData;
+  header.quantization = quantization;
+
+  return header;
+}
+
+/*
+ * Converts an ESRI ASCII grid to the tiled raster format.
+ *
+ * @param { std::string } asciiFile - Path of the .asc grid.
+ * @param { std::string } fileName - Path of the tiled raster to write.
+ * @param { int32_t } tileSize - Side of the tiles, in cells.
+ * @param { bool } compress - Stores tiles as RLE runs when that is smaller.
+ * @param { Encoding } quantization - INT16, UINT16 or FLOAT32 to quantize the cells to
+ * when they do not fit it exactly; FLOAT64 keeps them exact.
+ * */
+void TiledRaster::convert(const std::string &asciiFile, const std::string &fileName,
+                          int32_t tileSize, bool compress, Encoding quantization) {
+  if (tileSize <= 0) throw std::runtime_error("Tile size must be positive");
+
+  MappedFile file(asciiFile);
+  std::vector<std::string_view> rows
+      = Utils::parsing::lines(std::string_view(file.data(), file.size()));
+
+  Layer grid;
+  rows.erase(rows.begin(), rows.begin() + grid.readHeader(rows));
+  rows.erase(
+      std::remove_if(rows.begin(), rows.end(), [](std::string_view row) { return row.empty(); }),
+      rows.end());
+
+  writeRaster(rasterHeader(grid.rowN, grid.colN, tileSize, grid.xCorner, grid.yCorner,
+                           grid.cellSize, grid.noData, quantization),
+              fileName, compress, [&](int32_t first, int32_t count, std::vector<double> &band) {
+                parseBand(rows, first, count, grid.colN, grid.noData, band);
+              });
+}
+
+/*
+ * Writes the overview of a tiled raster: the same extent at half the resolution, each
+ * cell holding the mean of the (up to) 2 x 2 cells it covers that are not noData. Cells
+ * covering only noData stay noData. The north-west corner is kept, so odd grids gain
+ * half a cell of noData on the south and east edges.
+ *
+ * @param { std::string } sourceFile - Path of the tiled raster to reduce.
+ * @param { std::string } fileName - Path of the overview to write.
+ * @param { bool } compress - Stores tiles as RLE runs when that is smaller.
+ * @param { Encoding } quantization - As in convert.
+ * */
+void TiledRaster::overview(const std::string &sourceFile, const std::string &fileName,
+                           bool compress, Encoding quantization) {
+  const TiledRaster source(sourceFile);
+  const RasterHeader &grid = source.header();
+  const int32_t rows = (grid.rows + 1) / 2, cols = (grid.cols + 1) / 2;
+  const double cellSize = 2 * grid.cellSize;
+  const double north = grid.yCorner + grid.rows * grid.cellSize;
+
+  std::vector<double> fine;
+  writeRaster(rasterHeader(rows, cols, grid.tileSize, grid.xCorner, north - rows * cellSize,
+                           cellSize, grid.noData, quantization),
+              fileName, compress, [&](int32_t first, int32_t count, std::vector<double> &band) {
+                const int64_t width = 2 * (int64_t)cols;
+                fine.resize((size_t)2 * count * width);
+                source.read(2 * first, 0, 2 * count, width, fine.data(), 1, width);
+
+                Utils::parallel::forChunks(0, count, 8, [&](int32_t, int64_t begin, int64_t end) {
+                  for (int64_t r = begin; r < end; ++r) {
+                    const double *top = fine.data() + 2 * r * width;
+                    const double *bottom = top + width;
+                    for (int32_t c = 0; c < cols; ++c) {
+                      const double values[] = {top[2 * c], top[2 * c + 1], bottom[2 * c],
+                                               bottom[2 * c + 1]};
+                      double sum = 0;
+                      int32_t n = 0;
+                      for (double value : values)
+                        if (value != grid.noData) {
+                          sum += value;
+                          ++n;
+                        }
+                      band[r * cols + c] = (n > 0) ? sum / n : grid.noData;
+                    }
+                  }
+                });
+              });
+}
+
+//----------------------------------------------------------------------------------------------
+// Reading
+//----------------------------------------------------------------------------------------------
+
+static std::atomic<uint64_t> nextRasterId(0);
+
+TiledRaster::TiledRaster(const std::string &fileName, std::shared_ptr<TileCache> cache)
+    : layerName(std::filesystem::path(fileName).stem().string()),
+      _fileName(fileName),
+      _file(std::make_unique<MappedFile>(fileName)),
+      _header(nullptr),
+      _entries(nullptr),
+      _cache(cache ? cache : std::make_shared<TileCache>(16 << 20)),
+      _id(nextRasterId++) {
+  if ((_file->size() < sizeof(RasterHeader)) || (memcmp(_file->data(), RASTER_MAGIC, 8) != 0))
+    throw std::runtime_error(fmt::format("{} is not a tiled raster", fileName));
+
+  _header = (const RasterHeader *)_file->data();
+  if (_header->version != RASTER_VERSION)
+    throw std::runtime_error(
+        fmt::format("{}: unsupported tiled raster version {}", fileName, _header->version));
+
+  const size_t tiles = (size_t)_header->tilesX * _header->tilesY;
+  if ((_header->tileSize <= 0)
+      || (_file->size() < sizeof(RasterHeader) + sizeof(TileEntry) * tiles))
+    throw std::runtime_error(fmt::format("{}: truncated tiled raster", fileName));
+
+  _entries = (const TileEntry *)(_file->data() + sizeof(RasterHeader));
+  if (rasterChecksum(*_header, _entries, tiles) != _header->checksum)
+    throw std::runtime_error(fmt::format("{}: tiled raster checksum mismatch", fileName));
+  for (size_t i = 0; i < tiles; ++i)
+    if ((_entries[i].offset + _entries[i].size > _file->size()) || (_entries[i].offset % 8 != 0))
+      throw std::runtime_error(fmt::format("{}: truncated tiled raster", fileName));
+
+  _codec = {_header->encoding, _header->scale, _header->offset, _header->noData, true};
+}
+
+std::vector<double> TiledRaster::decode(int32_t index) const {
+  const TileEntry &entry = _entries[index];
+  const char *block = _file->data() + entry.offset;
+  std::vector<double> cells((size_t)_header->tileSize * _header->tileSize, _header->noData);
+
+  switch (_codec.encoding) {
+    case Encoding::INT16:
+      decodeTile<int16_t>(_codec, block, entry, cells);
+      break;
+    case Encoding::UINT16:
+      decodeTile<uint16_t>(_codec, block, entry, cells);
+      break;
+    case Encoding::FLOAT32:
+      decodeTile<float>(_codec, block, entry, cells);
+      break;
+    default:
+      decodeTile<double>(_codec, block, entry, cells);
+  }
+
+  return cells;
+}
+
+TileCache::Tile TiledRaster::tile(int32_t index) const {
+  return _cache->get((_id << 32) | (uint32_t)index, [this, index]() { return decode(index); });
+}
+
+double TiledRaster::cell(int32_t row, int32_t col) const {
+  if ((row < 0) || (row >= _header->rows) || (col < 0) || (col >= _header->cols))
+    return _header->noData;
+
+  const int32_t size = _header->tileSize;
+  TileCache::Tile cells = tile((row / size) * _header->tilesX + col / size);
+  return (*cells)[(row % size) * size + col % size];
+}
+
+void TiledRaster::read(int32_t row, int32_t col, int32_t rows, int32_t cols, double *out,
+                       int64_t cellStride, int64_t rowStride) const {
+  const int32_t size = _header->tileSize;
+
+  for (int32_t r = 0; r < rows; ++r)
+    for (int32_t c = 0; c < cols; ++c) out[r * rowStride + c * cellStride] = _header->noData;
+
+  // Visit the tiles overlapping the window, copying their part of it
+  const int32_t r0 = std::max(row, 0), r1 = std::min(row + rows, _header->rows);
+  const int32_t c0 = std::max(col, 0), c1 = std::min(col + cols, _header->cols);
+  for (int32_t ty = r0 / size; (r0 < r1) && (ty * size < r1); ++ty)
+    for (int32_t tx = c0 / size; (c0 < c1) && (tx * size < c1); ++tx) {
+      TileCache::Tile cells = tile(ty * _header->tilesX + tx);
+      const int32_t top = std::max(r0, ty * size), bottom = std::min(r1, (ty + 1) * size);
+      const int32_t left = std::max(c0, tx * size), right = std::min(c1, (tx + 1) * size);
+
+      for (int32_t r = top; r < bottom; ++r) {
+        const double *source = cells->data() + (r - ty * size) * size - tx * size;
+        double *target = out + (r - row) * rowStride - col * cellStride;
+        for (int32_t c = left; c < right; ++c) target[c * cellStride] = source[c];
+      }
+    }
+}
+
+Utils::sampling::Grid TiledRaster::grid() const {
+  return {_header->rows,     _header->cols,     _header->xCorner,
+          _header->yCorner, _header->cellSize, _header->noData};
+}
+
+double TiledRaster::getValue(double longitude, double latitude) const {
+  int32_t row, col;
+  return grid().locate(longitude, latitude, row, col) ? cell(row, col) : _header->noData;
+}
+
+template <typename Index>
+void TiledRaster::gather(Span<const double> longitude, Span<const double> latitude,
+                         Span<double> out, Index index) const {
+  const int32_t size = _header->tileSize;
+  const Utils::sampling::Grid grid = this->grid();
+  int32_t current = -1;
+  TileCache::Tile cells;
+
+  for (int64_t k = 0; k < out.size(); ++k) {
+    const int64_t i = index(k);
+    int32_t row, col;
+    if (!grid.locate(longitude[i], latitude[i], row, col)) {
+      out[i] = _header->noData;
+      continue;
+    }
+
+    const int32_t tileIndex = (row / size) * _header->tilesX + col / size;
+    if (tileIndex != current) {
+      cells = tile(tileIndex);
+      current = tileIndex;
+    }
+    out[i] = (*cells)[(row % size) * size + col % size];
+  }
+}
+
+void TiledRaster::getValues(Span<const double> longitude, Span<const double> latitude,
+                            Span<double> out) const {
+  gather(longitude, latitude, out, [](int64_t k) { return k; });
+}
+
+void TiledRaster::getValues(Span<const double> longitude, Span<const double> latitude,
+                            Span<double> out, const std::vector<int64_t> &order) const {
+  gather(longitude, latitude, out, [&order](int64_t k) { return order[k]; });
+}
+
+void TiledRaster::sample(Span<const double> longitude, Span<const double> latitude,
+                         Span<double> out, Utils::sampling::Mode mode, int32_t k) const {
+  if (mode == Utils::sampling::Mode::NEAREST) return getValues(longitude, latitude, out);
+
+  // Neighboring cells mostly share a tile: keep the last one at hand
+  const int32_t size = _header->tileSize;
+  int32_t current = -1;
+  TileCache::Tile cells;
+  auto cellAt = [&](int32_t row, int32_t col) {
+    const int32_t tileIndex = (row / size) * _header->tilesX + col / size;
+    if (tileIndex != current) {
+      cells = tile(tileIndex);
+      current = tileIndex;
+    }
+    return (*cells)[(row % size) * size + col % size];
+  };
+
+  Utils::sampling::sample(grid(), cellAt, mode, k, longitude, latitude, out);
+}
+
+/*
+ * Sorting the points by cell before sampling makes every tile be fetched once and
+ * read front to back. Points outside the grid go last.
+ *
+ * @param { Span<const double> } longitude, latitude - Coordinates of the points.
+ *
+ * @return { std::vector<int64_t> } Indices of the points in sampling order.
+ * */
+std::vector<int64_t> TiledRaster::order(Span<const double> longitude,
+                                        Span<const double> latitude) const {
+  const int32_t size = _header->tileSize;
+  const Utils::sampling::Grid grid = this->grid();
+  std::vector<std::pair<int64_t, int64_t>> keys(longitude.size());
+
+  for (int64_t i = 0; i < longitude.size(); ++i) {
+    int32_t row, col;
+    int64_t key = std::numeric_limits<int64_t>::max();
+    if (grid.locate(longitude[i], latitude[i], row, col)) {
+      const int64_t tileIndex = (int64_t)(row / size) * _header->tilesX + col / size;
+      key = tileIndex * size * size + (row % size) * size + col % size;
+    }
+    keys[i] = {key, i};
+  }
+
+  std::sort(keys.begin(), keys.end());
+
+  std::vector<int64_t> result(keys.size());
+  for (size_t k = 0; k < keys.size(); ++k) result[k] = keys[k].second;
+  return result;
+}
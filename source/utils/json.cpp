@@ -0,0 +1,195 @@
+#include <fmt/format.h>
+
+#include <cctype>
+#include <sahga/utils/json.hpp>
+#include <stdexcept>
+
+namespace Utils {
+  namespace json {
+    static void skipBlanks(std::string_view text, size_t &position) {
+      while ((position < text.size()) && std::isspace((unsigned char)text[position])) ++position;
+    }
+
+    static void appendUtf8(std::string &out, uint32_t code) {
+      if (code < 0x80) {
+        out += (char)code;
+      } else if (code < 0x800) {
+        out += (char)(0xC0 | (code >> 6));
+        out += (char)(0x80 | (code & 0x3F));
+      } else if (code < 0x10000) {
+        out += (char)(0xE0 | (code >> 12));
+        out += (char)(0x80 | ((code >> 6) & 0x3F));
+        out += (char)(0x80 | (code & 0x3F));
+      } else {
+        out += (char)(0xF0 | (code >> 18));
+        out += (char)(0x80 | ((code >> 12) & 0x3F));
+        out += (char)(0x80 | ((code >> 6) & 0x3F));
+        out += (char)(0x80 | (code & 0x3F));
+      }
+    }
+
+    // The string literal at position (its opening quote), unescaped; position ends past it.
+    static std::string parseString(std::string_view text, size_t &position) {
+      auto fail = [&]() -> std::string {
+        throw std::runtime_error(fmt::format("JSON: bad string at offset {}", position));
+      };
+      auto hex = [&](size_t at) {
+        if (at + 4 > text.size()) fail();
+        uint32_t code = 0;
+        for (size_t k = at; k < at + 4; ++k) {
+          const char c = text[k];
+          code <<= 4;
+          if ((c >= '0') && (c <= '9')) {
+            code |= c - '0';
+          } else if ((c >= 'a') && (c <= 'f')) {
+            code |= c - 'a' + 10;
+          } else if ((c >= 'A') && (c <= 'F')) {
+            code |= c - 'A' + 10;
+          } else {
+            fail();
+          }
+        }
+        return code;
+      };
+
+      std::string out;
+      for (++position; position < text.size(); ++position) {
+        const char c = text[position];
+        if (c == '"') {
+          ++position;
+          return out;
+        }
+        if (c != '\\') {
+          out += c;
+          continue;
+        }
+
+        if (++position >= text.size()) break;
+        switch (text[position]) {
+          case '"': out += '"'; break;
+          case '\\': out += '\\'; break;
+          case '/': out += '/'; break;
+          case 'b': out += '\b'; break;
+          case 'f': out += '\f'; break;
+          case 'n': out += '\n'; break;
+          case 'r': out += '\r'; break;
+          case 't': out += '\t'; break;
+          case 'u': {
+            uint32_t code = hex(position + 1);
+            position += 4;
+            // Surrogate pair
+            if ((code >= 0xD800) && (code < 0xDC00) && (position + 6 < text.size())
+                && (text[position + 1] == '\\') && (text[position + 2] == 'u')) {
+              const uint32_t low = hex(position + 3);
+              if ((low >= 0xDC00) && (low < 0xE000)) {
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                position += 6;
+              }
+            }
+            appendUtf8(out, code);
+            break;
+          }
+          default: fail();
+        }
+      }
+
+      return fail();
+    }
+
+    std::map<std::string, std::string> parseObject(std::string_view text) {
+      auto fail = [](size_t position, const char *expected) {
+        throw std::runtime_error(fmt::format("JSON: expected {} at offset {}", expected, position));
+      };
+
+      std::map<std::string, std::string> members;
+      size_t position = 0;
+      skipBlanks(text, position);
+      if ((position >= text.size()) || (text[position] != '{')) fail(position, "'{'");
+      ++position;
+
+      skipBlanks(text, position);
+      if ((position < text.size()) && (text[position] == '}')) return members;
+
+      while (true) {
+        skipBlanks(text, position);
+        if ((position >= text.size()) || (text[position] != '"')) fail(position, "a key");
+        std::string key = parseString(text, position);
+
+        skipBlanks(text, position);
+        if ((position >= text.size()) || (text[position] != ':')) fail(position, "':'");
+        ++position;
+
+        skipBlanks(text, position);
+        if (position >= text.size()) fail(position, "a value");
+        if (text[position] == '"') {
+          members[key] = parseString(text, position);
+        } else if ((text[position] == '{') || (text[position] == '[')) {
+          fail(position, "a string, number, true, false or null");
+        } else {
+          const size_t start = position;
+          while ((position < text.size()) && (text[position] != ',') && (text[position] != '}')
+                 && !std::isspace((unsigned char)text[position]))
+            ++position;
+          members[key] = std::string(text.substr(start, position - start));
+        }
+
+        skipBlanks(text, position);
+        if (position >= text.size()) fail(position, "',' or '}'");
+        if (text[position] == '}') break;
+        if (text[position] != ',') fail(position, "',' or '}'");
+        ++position;
+      }
+
+      return members;
+    }
+
+    std::string quote(std::string_view text) {
+      std::string out = "\"";
+      for (char c : text) {
+        switch (c) {
+          case '"': out += "\\\""; break;
+          case '\\': out += "\\\\"; break;
+          case '\n': out += "\\n"; break;
+          case '\r': out += "\\r"; break;
+          case '\t': out += "\\t"; break;
+          default:
+            if ((unsigned char)c < 0x20) {
+              out += fmt::format("\\u{:04x}", (int)c);
+            } else {
+              out += c;
+            }
+        }
+      }
+
+      return out + '"';
+    }
+
+    //------------------------------------------------------------------------------------------
+    // Object
+    //------------------------------------------------------------------------------------------
+
+    Object &Object::add(const std::string &key, std::string_view value) {
+      return raw(key, quote(value));
+    }
+
+    Object &Object::add(const std::string &key, const std::vector<double> &values) {
+      std::string array = "[";
+      for (size_t i = 0; i < values.size(); ++i) {
+        if (i > 0) array += ',';
+        array += std::isfinite(values[i]) ? number(values[i]) : "null";
+      }
+
+      return raw(key, array + "]");
+    }
+
+    Object &Object::raw(const std::string &key, std::string_view json) {
+      if (!_members.empty()) _members += ',';
+      _members += quote(key);
+      _members += ':';
+      _members += json;
+      return *this;
+    }
+
+    std::string Object::number(double value) { return fmt::format("{}", value); }
+  }  // namespace json
+}  // namespace Utils
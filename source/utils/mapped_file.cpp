@@ -0,0 +1,37 @@
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <sahga/utils/mapped_file.hpp>
+#include <stdexcept>
+
+MappedFile::MappedFile(const std::string &fileName, bool copyOnWrite)
+    : _data(nullptr), _size(0), _copyOnWrite(copyOnWrite) {
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error(fmt::format("Failed to open {}", fileName));
+
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    throw std::runtime_error(fmt::format("Failed to stat {}", fileName));
+  }
+
+  _size = (size_t)info.st_size;
+  if (_size > 0) {
+    int protection = copyOnWrite ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void *mapping = mmap(nullptr, _size, protection, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error(fmt::format("Failed to map {}", fileName));
+    }
+    _data = (char *)mapping;
+  }
+
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (_data != nullptr) munmap(_data, _size);
+}
@@ -0,0 +1,290 @@
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <sahga/utils/parallel.hpp>
+#include <stdexcept>
+#include <utility>
+
+namespace Utils {
+  namespace parallel {
+    int32_t threads() { return std::max(1, (int32_t)std::thread::hardware_concurrency()); }
+
+    int32_t chunkCount(int64_t size, int64_t grain) {
+      if (size <= 0) return 0;
+      int64_t chunks = size / std::max<int64_t>(grain, 1);
+      return (int32_t)std::max<int64_t>(1, std::min<int64_t>(chunks, threads()));
+    }
+
+    //------------------------------------------------------------------------------------------
+    // Executor
+    //------------------------------------------------------------------------------------------
+
+    // Executor and queue of the calling thread, when it is a worker.
+    static thread_local const Executor *currentExecutor = nullptr;
+    static thread_local int32_t currentWorker = -1;
+
+    Executor::Executor(int32_t workers) : _pending(0), _next(0), _stopping(false) {
+      workers = std::max(workers, 1);
+      for (int32_t i = 0; i < workers; ++i) _queues.push_back(std::make_unique<Queue>());
+      for (int32_t i = 0; i < workers; ++i) _threads.emplace_back(&Executor::work, this, i);
+    }
+
+    Executor::~Executor() {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+      }
+      _wake.notify_all();
+      for (std::thread &thread : _threads) thread.join();
+    }
+
+    Executor &Executor::global() {
+      static Executor executor;
+      return executor;
+    }
+
+    void Executor::submit(std::function<void()> task) {
+      const int32_t self = (currentExecutor == this) ? currentWorker : -1;
+      Queue &queue = *_queues[(self >= 0) ? self : _next++ % _queues.size()];
+      {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_pending;
+      }
+      _wake.notify_one();
+    }
+
+    // The newest task of queue `self`, or else the oldest one of any other queue.
+    bool Executor::pop(int32_t self, std::function<void()> &task) {
+      const int32_t n = (int32_t)_queues.size();
+      for (int32_t k = 0; k < n; ++k) {
+        const int32_t index = (self >= 0) ? (self + k) % n : k;
+        Queue &queue = *_queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+
+        if (index == self) {
+          task = std::move(queue.tasks.back());
+          queue.tasks.pop_back();
+        } else {
+          task = std::move(queue.tasks.front());
+          queue.tasks.pop_front();
+        }
+        --_pending;
+        return true;
+      }
+
+      return false;
+    }
+
+    void Executor::work(int32_t self) {
+      currentExecutor = this;
+      currentWorker = self;
+
+      std::function<void()> task;
+      while (true) {
+        if (pop(self, task)) {
+          task();
+          task = nullptr;
+          continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _wake.wait(lock, [this]() { return _stopping || (_pending > 0); });
+        if (_stopping && (_pending == 0)) return;
+      }
+    }
+
+    //------------------------------------------------------------------------------------------
+    // TaskGroup
+    //------------------------------------------------------------------------------------------
+
+    bool TaskGroup::State::runOne() {
+      std::function<void()> task;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (tasks.empty()) return false;
+        task = std::move(tasks.front());
+        tasks.pop_front();
+      }
+
+      std::exception_ptr failure;
+      try {
+        task();
+      } catch (...) {
+        failure = std::current_exception();
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if (failure && !error) error = failure;
+      if (--count == 0) done.notify_all();
+      return true;
+    }
+
+    TaskGroup::TaskGroup(Executor &executor)
+        : _executor(executor), _state(std::make_shared<State>()) {}
+
+    TaskGroup::~TaskGroup() {
+      // Tasks still running may reference what the group's owner holds
+      std::unique_lock<std::mutex> lock(_state->mutex);
+      _state->done.wait(lock, [this]() { return _state->count == 0; });
+    }
+
+    void TaskGroup::run(std::function<void()> task) {
+      {
+        std::lock_guard<std::mutex> lock(_state->mutex);
+        _state->tasks.push_back(std::move(task));
+        ++_state->count;
+      }
+
+      // The runner finds nothing to do when the waiting thread got to the task first
+      _executor.submit([state = _state]() { state->runOne(); });
+    }
+
+    void TaskGroup::wait() {
+      // Run our queued tasks rather than block, then wait for those taken by workers
+      while (_state->runOne()) {
+      }
+
+      std::unique_lock<std::mutex> lock(_state->mutex);
+      _state->done.wait(lock, [this]() { return _state->count == 0; });
+      if (_state->error) std::rethrow_exception(std::exchange(_state->error, nullptr));
+    }
+
+    //------------------------------------------------------------------------------------------
+    // TaskGraph
+    //------------------------------------------------------------------------------------------
+
+    int32_t TaskGraph::add(const std::string &name, std::function<void()> task,
+                           const std::vector<int32_t> &dependencies) {
+      const int32_t id = (int32_t)_tasks.size();
+      for (int32_t dependency : dependencies)
+        if ((dependency < 0) || (dependency >= id))
+          throw std::invalid_argument(fmt::format("{}: unknown dependency {}", name, dependency));
+
+      _tasks.push_back({name, std::move(task), dependencies, {}, 0, 0, false, false});
+      for (int32_t dependency : dependencies) _tasks[dependency].dependents.push_back(id);
+
+      return id;
+    }
+
+    void TaskGraph::run(Executor &executor) {
+      using Clock = std::chrono::steady_clock;
+      const Clock::time_point origin = Clock::now();
+      auto now = [&origin]() {
+        return std::chrono::duration<double>(Clock::now() - origin).count();
+      };
+
+      std::vector<std::atomic<int32_t>> waiting(_tasks.size());
+      std::vector<std::atomic<bool>> failed(_tasks.size());
+      for (size_t i = 0; i < _tasks.size(); ++i) {
+        waiting[i] = (int32_t)_tasks[i].dependencies.size();
+        failed[i] = false;
+        _tasks[i].ran = _tasks[i].failed = false;
+        _tasks[i].start = _tasks[i].end = 0;
+      }
+
+      TaskGroup group(executor);
+      std::function<void(int32_t)> start = [&](int32_t id) {
+        group.run([&, id]() {
+          Task &task = _tasks[id];
+          bool skip = false;
+          for (int32_t dependency : task.dependencies) skip = skip || failed[dependency];
+
+          try {
+            if (!skip) {
+              task.start = now();
+              if (_listener) _listener(task.name, "started", task.start);
+              task.run();
+              task.ran = true;
+            }
+          } catch (...) {
+            task.end = now();
+            task.failed = failed[id] = true;
+            if (_listener) _listener(task.name, "failed", task.end);
+            for (int32_t dependent : task.dependents)
+              if (--waiting[dependent] == 0) start(dependent);
+            throw;
+          }
+
+          task.end = skip ? task.start : now();
+          failed[id] = skip;
+          if (_listener) _listener(task.name, skip ? "skipped" : "done", task.end);
+          for (int32_t dependent : task.dependents)
+            if (--waiting[dependent] == 0) start(dependent);
+        });
+      };
+
+      for (size_t i = 0; i < _tasks.size(); ++i)
+        if (_tasks[i].dependencies.empty()) start((int32_t)i);
+
+      try {
+        group.wait();
+      } catch (...) {
+        _elapsed = now();
+        throw;
+      }
+      _elapsed = now();
+    }
+
+    // Longest chain of dependent tasks by time spent; tasks are stored in dependency order.
+    std::vector<int32_t> TaskGraph::criticalPath() const {
+      const int32_t n = (int32_t)_tasks.size();
+      std::vector<double> finish(n, 0);
+      std::vector<int32_t> previous(n, -1);
+
+      int32_t last = -1;
+      for (int32_t i = 0; i < n; ++i) {
+        for (int32_t dependency : _tasks[i].dependencies)
+          if ((previous[i] < 0) || (finish[dependency] > finish[previous[i]]))
+            previous[i] = dependency;
+
+        const double time = _tasks[i].end - _tasks[i].start;
+        finish[i] = ((previous[i] >= 0) ? finish[previous[i]] : 0) + time;
+        if ((last < 0) || (finish[i] > finish[last])) last = i;
+      }
+
+      std::vector<int32_t> path;
+      for (int32_t i = last; i >= 0; i = previous[i]) path.push_back(i);
+      std::reverse(path.begin(), path.end());
+
+      return path;
+    }
+
+    std::string TaskGraph::report() const {
+      const std::vector<int32_t> path = criticalPath();
+      std::vector<bool> critical(_tasks.size(), false);
+      for (int32_t id : path) critical[id] = true;
+
+      size_t width = 5;
+      for (const Task &task : _tasks) width = std::max(width, task.name.size());
+
+      std::string text = fmt::format("{:<{}}  {:>9}  {:>9}  {:>9}\n", "Stage", width, "Start (s)",
+                                     "End (s)", "Time (s)");
+      double sum = 0, pathTime = 0;
+      for (size_t i = 0; i < _tasks.size(); ++i) {
+        const Task &task = _tasks[i];
+        const double time = task.end - task.start;
+        sum += time;
+        if (critical[i]) pathTime += time;
+
+        const char *mark
+            = task.failed ? "  failed" : (!task.ran ? "  skipped" : (critical[i] ? "  *" : ""));
+        text += fmt::format("{:<{}}  {:>9.3f}  {:>9.3f}  {:>9.3f}{}\n", task.name, width,
+                            task.start, task.end, time, mark);
+      }
+
+      std::string names;
+      for (int32_t id : path) names += (names.empty() ? "" : " -> ") + _tasks[id].name;
+
+      text += fmt::format("Wall {:.3f} s, stages {:.3f} s, critical path (*) {:.3f} s: {}\n",
+                          _elapsed, sum, pathTime, names);
+      return text;
+    }
+  }  // namespace parallel
+}  // namespace Utils
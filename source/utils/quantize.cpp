@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <sahga/utils/quantize.hpp>
+#include <vector>
+
+namespace Utils {
+  namespace quantize {
+    // Codes of the integer encodings, the sentinel left out.
+    template <typename T> struct Codes;
+    template <> struct Codes<int16_t> {
+      static constexpr double first = -32767, last = 32767;
+      static constexpr int16_t sentinel = -32768;
+    };
+    template <> struct Codes<uint16_t> {
+      static constexpr double first = 0, last = 65534;
+      static constexpr uint16_t sentinel = 65535;
+    };
+
+    size_t width(Encoding encoding) {
+      switch (encoding) {
+        case Encoding::FLOAT32:
+          return sizeof(float);
+        case Encoding::INT16:
+          return sizeof(int16_t);
+        case Encoding::UINT16:
+          return sizeof(uint16_t);
+        default:
+          return sizeof(double);
+      }
+    }
+
+    const char *name(Encoding encoding) {
+      switch (encoding) {
+        case Encoding::FLOAT32:
+          return "FLOAT32";
+        case Encoding::INT16:
+          return "INT16";
+        case Encoding::UINT16:
+          return "UINT16";
+        default:
+          return "FLOAT64";
+      }
+    }
+
+    template <typename T> static Codec fitCodes(Codec codec, double min, double max, bool integral) {
+      const double span = Codes<T>::last - Codes<T>::first;
+      if (!(min <= max)) return codec;  // No values: anything goes
+
+      if (integral && (max - min <= span)) {
+        // Exact: shift by a whole number only when the values do not fit as they are
+        codec.scale = 1;
+        codec.offset = ((min >= Codes<T>::first) && (max <= Codes<T>::last))
+                           ? 0
+                           : std::floor(min) - Codes<T>::first;
+      } else {
+        codec.scale = (max > min) ? (max - min) / span : 1;
+        codec.offset = min - Codes<T>::first * codec.scale;
+      }
+
+      return codec;
+    }
+
+    Codec fit(Encoding encoding, double min, double max, bool integral) {
+      Codec codec = fit(encoding, min, max, 0, integral);
+      codec.hasNoData = false;
+      return codec;
+    }
+
+    Codec fit(Encoding encoding, double min, double max, double noData, bool integral) {
+      Codec codec = {encoding, 1, 0, noData, true};
+
+      switch (encoding) {
+        case Encoding::INT16:
+          return fitCodes<int16_t>(codec, min, max, integral);
+        case Encoding::UINT16:
+          return fitCodes<uint16_t>(codec, min, max, integral);
+        default:
+          return codec;
+      }
+    }
+
+    template <typename T>
+    static void encodeAs(const Codec &codec, const double *values, int64_t size, T *codes) {
+      if constexpr (std::is_floating_point<T>::value) {
+        // Floats keep noData as themselves
+        for (int64_t i = 0; i < size; ++i) codes[i] = (T)values[i];
+      } else {
+        const double inverse = 1.0 / codec.scale;
+        for (int64_t i = 0; i < size; ++i) {
+          const double code = std::round((values[i] - codec.offset) * inverse);
+          const T stored = (T)std::clamp(code, Codes<T>::first, Codes<T>::last);
+          codes[i] = (codec.hasNoData && (values[i] == codec.noData)) ? Codes<T>::sentinel : stored;
+        }
+      }
+    }
+
+    template <typename T>
+    static void decodeAs(const Codec &codec, const T *codes, int64_t size, double *values) {
+      const double scale = codec.scale, offset = codec.offset, noData = codec.noData;
+
+      if (!codec.hasNoData) {
+        for (int64_t i = 0; i < size; ++i) values[i] = codes[i] * scale + offset;
+        return;
+      }
+
+      T sentinel;
+      if constexpr (std::is_floating_point<T>::value) {
+        sentinel = (T)noData;
+      } else {
+        sentinel = Codes<T>::sentinel;
+      }
+
+      for (int64_t i = 0; i < size; ++i) {
+        const double value = codes[i] * scale + offset;
+        values[i] = (codes[i] == sentinel) ? noData : value;
+      }
+    }
+
+    template <typename T>
+    static void decodeStrided(const Codec &codec, const char *codes, int64_t size,
+                              int64_t codeStride, double *values, int64_t valueStride) {
+      const double scale = codec.scale, offset = codec.offset, noData = codec.noData;
+
+      T sentinel;
+      if constexpr (std::is_floating_point<T>::value) {
+        sentinel = (T)noData;
+      } else {
+        sentinel = Codes<T>::sentinel;
+      }
+
+      for (int64_t i = 0; i < size; ++i) {
+        T code;
+        memcpy(&code, codes + i * codeStride, sizeof(T));  // Records need not be aligned
+        const double value = code * scale + offset;
+        values[i * valueStride] = (codec.hasNoData && (code == sentinel)) ? noData : value;
+      }
+    }
+
+    void encode(const Codec &codec, const double *values, int64_t size, void *codes) {
+      switch (codec.encoding) {
+        case Encoding::FLOAT32:
+          return encodeAs(codec, values, size, (float *)codes);
+        case Encoding::INT16:
+          return encodeAs(codec, values, size, (int16_t *)codes);
+        case Encoding::UINT16:
+          return encodeAs(codec, values, size, (uint16_t *)codes);
+        default:
+          return encodeAs(codec, values, size, (double *)codes);
+      }
+    }
+
+    void decode(const Codec &codec, const void *codes, int64_t size, double *values) {
+      switch (codec.encoding) {
+        case Encoding::FLOAT32:
+          return decodeAs(codec, (const float *)codes, size, values);
+        case Encoding::INT16:
+          return decodeAs(codec, (const int16_t *)codes, size, values);
+        case Encoding::UINT16:
+          return decodeAs(codec, (const uint16_t *)codes, size, values);
+        default:
+          return decodeAs(codec, (const double *)codes, size, values);
+      }
+    }
+
+    void decode(const Codec &codec, const void *codes, int64_t size, int64_t codeStride,
+                double *values, int64_t valueStride) {
+      const char *bytes = (const char *)codes;
+      switch (codec.encoding) {
+        case Encoding::FLOAT32:
+          return decodeStrided<float>(codec, bytes, size, codeStride, values, valueStride);
+        case Encoding::INT16:
+          return decodeStrided<int16_t>(codec, bytes, size, codeStride, values, valueStride);
+        case Encoding::UINT16:
+          return decodeStrided<uint16_t>(codec, bytes, size, codeStride, values, valueStride);
+        default:
+          return decodeStrided<double>(codec, bytes, size, codeStride, values, valueStride);
+      }
+    }
+
+    Error error(const Codec &codec, const double *values, int64_t size) {
+      const int64_t BLOCK = 1024;
+      std::vector<char> codes(BLOCK * width(codec.encoding));
+      std::vector<double> decoded(BLOCK);
+
+      double max = 0, sum2 = 0;
+      int64_t n = 0;
+      for (int64_t start = 0; start < size; start += BLOCK) {
+        const int64_t count = std::min(BLOCK, size - start);
+        encode(codec, values + start, count, codes.data());
+        decode(codec, codes.data(), count, decoded.data());
+
+        for (int64_t i = 0; i < count; ++i) {
+          if (codec.hasNoData && (values[start + i] == codec.noData)) continue;
+
+          const double difference = fabs(decoded[i] - values[start + i]);
+          max = std::max(max, difference);
+          sum2 += difference * difference;
+          ++n;
+        }
+      }
+
+      return {max, (n > 0) ? sqrt(sum2 / n) : 0, n};
+    }
+
+    Error merge(const Error &a, const Error &b) {
+      const int64_t n = a.count + b.count;
+      if (n == 0) return {0, 0, 0};
+
+      const double sum2 = a.rms * a.rms * a.count + b.rms * b.rms * b.count;
+      return {std::max(a.max, b.max), sqrt(sum2 / n), n};
+    }
+  }  // namespace quantize
+}  // namespace Utils
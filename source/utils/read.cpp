@@ -1,127 +1,311 @@
+#include <cstring>
+#include <sahga/utils/binary_format.hpp>
 #include <sahga/utils/common.hpp>
+#include <sahga/utils/mapped_file.hpp>
+#include <sahga/utils/parallel.hpp>
+#include <sahga/utils/quantize.hpp>
 #include <sahga/utils/read.hpp>
+#include <sahga/utils/tokenizer.hpp>
 
 using namespace Utils::filemanagement;
 
-int TextFile::ReadData(std::vector<std::string> &list, const std::string &fileName) {
-  std::ifstream file;
-
-  file.open(fileName);
-
-  if (!file.is_open()) {
-    fmt::print("Failed to open");
-    file.clear();
+// Maps a text file for the readers below, which report a missing file and stop.
+static std::unique_ptr<MappedFile> openText(const std::string &fileName) {
+  try {
+    return std::make_unique<MappedFile>(fileName);
+  } catch (const std::runtime_error &) {
+    fmt::print("\nErro ao abrir o arquivo {}.", fileName);
     exit(0);
   }
+}
 
-  std::string line;
-  while (std::getline(file, line)) {
-    if ((line != "") && (line.substr(0, 2) != "//")) list.push_back(line);
-  }
+static std::string_view textOf(const MappedFile &file) {
+  return std::string_view(file.data(), file.size());
+}
+
+// Lines per chunk below which the text readers parse on a single thread.
+static const int64_t LINES_PER_CHUNK = 4096;
+
+int TextFile::ReadData(std::vector<std::string> &list, const std::string &fileName) {
+  std::unique_ptr<MappedFile> file = openText(fileName);
+
+  for (std::string_view line : Utils::parsing::lines(textOf(*file)))
+    if (!line.empty() && (line.substr(0, 2) != "//")) list.emplace_back(line);
 
-  file.close();
   return list.size();
 }
 
 int TextFile::ReadData(Dataset &M, const std::string &fileName, const char &separator) {
-  std::fstream FIn;
-  std::string line;
-  unsigned int i;
-  std::vector<std::string> lines;
-
-  M.rowN = 0;
-  FIn.open(fileName.c_str(), std::ios::in);
+  std::unique_ptr<MappedFile> file = openText(fileName);
+  std::vector<std::string_view> lines = Utils::parsing::lines(textOf(*file));
 
-  if (!FIn.is_open()) {
-    fmt::print("\nErro ao abrir o arquivo {}.", fileName);
-    FIn.clear();
-    exit(0);
-  } else {
-    getline(FIn, line);
+  // Skip the header and blank lines
+  if (!lines.empty()) lines.erase(lines.begin());
+  lines.erase(std::remove_if(lines.begin(), lines.end(),
+                             [](std::string_view line) { return line.empty(); }),
+              lines.end());
 
-    while (!FIn.eof()) {
-      getline(FIn, line);
-      if (line != "") lines.push_back(line);
-    }
-  }
-
-  FIn.close();
   M.reset(lines.size(), 4);
 
-  for (i = 0; i < lines.size(); ++i) {
-    line = lines[i];
-    std::vector<std::string> tokens = Utils::miscellaneous::split(line, separator);
-    // Remove second position in order to don't get the species label
-    tokens.erase(tokens.begin() + 1);
+  Utils::parallel::forChunks(0, lines.size(), LINES_PER_CHUNK, [&](int32_t, int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i) {
+      Utils::parsing::Tokenizer tokens(lines[i], separator);
+      double value;
 
-    // Convert to double array
-    for (unsigned int j = 0; j < tokens.size(); ++j) {
-      M.M[i][j] = std::stod(tokens[j]);
+      // #id, then the species label, which is not kept
+      if (tokens.next(value)) M.M[i][0] = value;
+      tokens.skip();
+      for (int32_t j = 1; (j < M.colN) && tokens.next(value); ++j) M.M[i][j] = value;
     }
-  }
+  });
 
-  lines.clear();
   return (M.rowN);
 }
 
 int TextFile::ReadData(Graph &G, Dataset &M, const std::string &fileName, const char &separator) {
-  std::ifstream inputStream(fileName);
+  std::unique_ptr<MappedFile> file = openText(fileName);
+  std::vector<std::string_view> lines = Utils::parsing::lines(textOf(*file));
+  if (lines.empty()) return (G.nNodes == 0);
 
-  if (!inputStream.is_open()) {
-    fmt::print("\nErro ao abrir o arquivo {}.", fileName);
-    inputStream.clear();
-    exit(0);
-  }
+  Utils::parsing::Tokenizer header(lines[0], separator);
+  double numNodes = 0, numVars = 0;
+  header.next(numNodes);
+  header.next(numVars);
 
-  std::string line;
-  getline(inputStream, line);  // Consumes the header
+  lines.erase(lines.begin());
+  lines.erase(std::remove_if(lines.begin(), lines.end(),
+                             [](std::string_view line) { return line.empty(); }),
+              lines.end());
 
-  int32_t numNodes = (int)Utils::filemanagement::getNumber(line, separator);
-  int32_t numVars = (int)Utils::filemanagement::getNumber(line, separator);
+  // numVars counts the independent variables; the dependent one comes first
+  M.reset((int32_t)numNodes, (int32_t)numVars + 1);
 
-  M.reset(numNodes, numVars);
+  std::vector<TNode> nodes(lines.size());
+  Utils::parallel::forChunks(0, lines.size(), LINES_PER_CHUNK, [&](int32_t, int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i) {
+      Utils::parsing::Tokenizer tokens(lines[i], separator);
+      TNode &node = nodes[i];
+      double value = 0;
 
-  int32_t i = 0;
-  TNode node;
-  while (getline(inputStream, line)) {
-    if (line != "") {
-      node.nodeId = (int32_t)Utils::filemanagement::getNumber(line, separator);
-      node.nRel = (int)Utils::filemanagement::getNumber(line, separator);
+      tokens.next(value);
+      node.nodeId = (int32_t)value;
+      value = 0;
+      tokens.next(value);
+      node.nRel = (int32_t)value;
       node.edge.resize(node.nRel);
 
       for (int32_t j = 0; j < node.nRel; ++j)
-        node.edge[j].nodeId = (int)Utils::filemanagement::getNumber(line, separator);
+        if (tokens.next(value)) node.edge[j].nodeId = (int32_t)value;
       for (int32_t j = 0; j < node.nRel; ++j)
-        node.edge[j].weight = Utils::filemanagement::getNumber(line, separator);
+        if (tokens.next(value)) node.edge[j].weight = value;
+
+      if (i < M.rowN)
+        for (int32_t j = 0; (j < M.colN) && tokens.next(value); ++j) M.M[i][j] = value;
+    }
+  });
+
+  for (TNode &node : nodes) G.insert(node);
+
+  return (G.nNodes == (int32_t)numNodes);
+}
+
+// Checks the header, section sizes, checksum and edge offsets of a mapped binary MPG.
+static const Utils::binary::MPGHeader &validateMPG(const MappedFile &file,
+                                                  const std::string &fileName) {
+  using namespace Utils::binary;
+
+  if ((file.size() < sizeof(MPGHeader)) || (memcmp(file.data(), MPG_MAGIC, 8) != 0))
+    throw std::runtime_error(fmt::format("{} is not a binary MPG", fileName));
 
-      G.insert(node);
+  const MPGHeader &header = *(const MPGHeader *)file.data();
+  if (header.version != MPG_VERSION)
+    throw std::runtime_error(
+        fmt::format("{}: unsupported binary MPG version {}", fileName, header.version));
 
-      int32_t j = 0;
-      while (line != "") {
-        M.M[i][j] = Utils::filemanagement::getNumber(line, separator);
-        ++j;
-      }
+  if ((header.nNodes < 0) || (header.nEdges < 0) || (header.nVars < 0))
+    throw std::runtime_error(fmt::format("{}: negative binary MPG sizes", fileName));
+
+  const uint64_t offsetsAt = align8(sizeof(MPGHeader) + sizeof(int32_t) * header.nNodes);
+  const uint64_t dataAt = offsetsAt + sizeof(int64_t) * (header.nNodes + 1)
+                          + sizeof(MPGEdge) * header.nEdges;
+  if (file.size() != dataAt + sizeof(double) * header.nNodes * header.nVars)
+    throw std::runtime_error(fmt::format("{}: truncated binary MPG", fileName));
+
+  uint64_t checksum = Utils::miscellaneous::hash(file.data() + sizeof(MPGHeader),
+                                                 file.size() - sizeof(MPGHeader));
+  if (checksum != header.checksum)
+    throw std::runtime_error(fmt::format("{}: binary MPG checksum mismatch", fileName));
+
+  // The edges of node i are [offsets[i], offsets[i + 1]), so every node reads inside them
+  const int64_t *offsets = (const int64_t *)(file.data() + offsetsAt);
+  bool ordered = (offsets[0] == 0) && (offsets[header.nNodes] == header.nEdges);
+  for (int32_t i = 0; ordered && (i < header.nNodes); ++i) ordered = offsets[i] <= offsets[i + 1];
+  if (!ordered) throw std::runtime_error(fmt::format("{}: bad binary MPG edge offsets", fileName));
+
+  return header;
+}
+
+// Copies the node attribute block of a binary MPG into M.
+static void readMPGAttributes(const MappedFile &file, const Utils::binary::MPGHeader &header,
+                              Dataset &M) {
+  using namespace Utils::binary;
+
+  const uint64_t offsetsAt = align8(sizeof(MPGHeader) + sizeof(int32_t) * header.nNodes);
+  const double *data = (const double *)(file.data() + offsetsAt
+                                        + sizeof(int64_t) * (header.nNodes + 1)
+                                        + sizeof(MPGEdge) * header.nEdges);
+
+  M.reset(header.nNodes, header.nVars);
+  for (int32_t i = 0; i < header.nNodes; ++i)
+    memcpy(M.M[i], data + (int64_t)i * header.nVars, sizeof(double) * header.nVars);
+}
 
-      ++i;
+int BinaryMPGFile::ReadData(Graph &G, Dataset &M, const std::string &fileName, const char &) {
+  using namespace Utils::binary;
+
+  MappedFile file(fileName);
+  const MPGHeader &header = validateMPG(file, fileName);
+
+  const int32_t *ids = (const int32_t *)(file.data() + sizeof(MPGHeader));
+  const int64_t *offsets
+      = (const int64_t *)(file.data() + align8(sizeof(MPGHeader) + sizeof(int32_t) * header.nNodes));
+  const char *edges = (const char *)(offsets + header.nNodes + 1);
+
+  G.type = (Graph::MPGTypes)header.type;
+  G.neighbors = header.neighbors;
+
+  // Edges are stored with the TEdge layout, so each node is a single copy
+  const size_t first = G.node.size();
+  G.node.resize(first + header.nNodes);
+  for (int32_t i = 0; i < header.nNodes; ++i) {
+    TNode &node = G.node[first + i];
+    node.nodeId = ids[i];
+    node.nRel = (int)(offsets[i + 1] - offsets[i]);
+    node.edge.resize(node.nRel);
+    memcpy(node.edge.data(), edges + sizeof(MPGEdge) * offsets[i], sizeof(MPGEdge) * node.nRel);
+  }
+  G.nNodes += header.nNodes;
+
+  if (header.nVars > 0) readMPGAttributes(file, header, M);
+
+  return (G.nNodes == (int)(first + header.nNodes));
+}
+
+int BinaryMPGFile::ReadData(Dataset &M, const std::string &fileName, const char &) {
+  MappedFile file(fileName);
+  readMPGAttributes(file, validateMPG(file, fileName), M);
+
+  return (M.rowN);
+}
+
+int BinaryMPGFile::ReadData(std::vector<std::string> &, const std::string &fileName) {
+  throw std::runtime_error(fmt::format("{} is a binary MPG, not a list of lines", fileName));
+}
+
+Utils::binary::MPGHeader BinaryMPGFile::header(const std::string &fileName) {
+  MappedFile file(fileName);
+  return validateMPG(file, fileName);
+}
+
+int ColumnarFile::ReadData(Dataset &M, const std::string &fileName, const char &) {
+  using namespace Utils::binary;
+
+  auto file = std::make_shared<MappedFile>(fileName, true);
+
+  if ((file->size() < sizeof(DatasetHeader)) || (memcmp(file->data(), DATASET_MAGIC, 8) != 0))
+    throw std::runtime_error(fmt::format("{} is not a columnar dataset", fileName));
+
+  const DatasetHeader &header = *(const DatasetHeader *)file->data();
+  if (header.version != DATASET_VERSION)
+    throw std::runtime_error(
+        fmt::format("{}: unsupported columnar dataset version {}", fileName, header.version));
+
+  const ColumnHeader *columns = (const ColumnHeader *)(file->data() + sizeof(DatasetHeader));
+  bool truncated = (file->size() < sizeof(DatasetHeader) + sizeof(ColumnHeader) * header.nColumns);
+  for (int32_t j = 0; (j < header.nColumns) && !truncated; ++j)
+    truncated = (columns[j].dataOffset + columns[j].dataSize > file->size())
+                || (columns[j].dataSize < Utils::quantize::width(columns[j].encoding) * header.nRows);
+  if (truncated) throw std::runtime_error(fmt::format("{}: truncated columnar dataset", fileName));
+
+  // The column headers always; the blocks only on request, as hashing them reads every page
+  // of the mapping up front
+  const char *table = file->data() + sizeof(DatasetHeader);
+  bool intact = (Utils::miscellaneous::hash(table, sizeof(ColumnHeader) * header.nColumns)
+                 == header.tableChecksum);
+  if (intact && verify)
+    intact = (Utils::miscellaneous::hash(table, file->size() - sizeof(DatasetHeader))
+              == header.checksum);
+  if (!intact)
+    throw std::runtime_error(fmt::format("{}: columnar dataset checksum mismatch", fileName));
+
+  // FLOAT64 columns evenly spaced in the file already are a COLUMN_MAJOR matrix
+  const uint64_t block = align64(sizeof(double) * header.nRows);
+  bool mappable = (header.nColumns > 0);
+  for (int32_t j = 0; (j < header.nColumns) && mappable; ++j)
+    mappable = (columns[j].encoding == Encoding::FLOAT64)
+               && (columns[j].dataOffset == columns[0].dataOffset + j * block);
+
+  if (mappable) {
+    // Aliases the mapping: the matrix keeps the file mapped for as long as it lives
+    double *first = (double *)(file->privateData() + columns[0].dataOffset);
+    M.view(std::shared_ptr<double>(file, first), (int)header.nRows, header.nColumns,
+           Dataset::Layout::COLUMN_MAJOR, (int64_t)(block / sizeof(double)));
+  } else {
+    M.reset((int)header.nRows, header.nColumns, Dataset::Layout::COLUMN_MAJOR);
+
+    for (int32_t j = 0; j < header.nColumns; ++j) {
+      double *values = M.column(j).data();
+      const char *stored = file->data() + columns[j].dataOffset;
+      const Utils::quantize::Codec codec
+          = {columns[j].encoding, columns[j].scale, columns[j].offset, 0, false};
+      Utils::quantize::decode(codec, stored, header.nRows, values);
     }
   }
 
-  inputStream.close();
-  return (G.nNodes == numNodes);
+  M.names.resize(header.nColumns);
+  for (int32_t j = 0; j < header.nColumns; ++j) {
+    M.names[j] = std::string(columns[j].name, strnlen(columns[j].name, sizeof(columns[j].name)));
+    M.stats[j] = {columns[j].avg, columns[j].stdDev, columns[j].sum, columns[j].sum2};
+  }
+
+  return (M.rowN);
+}
+
+int ColumnarFile::ReadData(Graph &, Dataset &, const std::string &fileName, const char &) {
+  throw std::runtime_error(fmt::format("{} is a columnar dataset, not an MPG", fileName));
+}
+
+int ColumnarFile::ReadData(std::vector<std::string> &, const std::string &fileName) {
+  throw std::runtime_error(fmt::format("{} is a columnar dataset, not a list of lines", fileName));
+}
+
+// Recognizes the binary formats by their magic number, whatever the extension.
+static bool hasMagic(const std::string &fileName, const char *magic) {
+  char buffer[8];
+  std::ifstream file(fileName, std::ios::binary);
+
+  return (file.read(buffer, sizeof(buffer)) && (memcmp(buffer, magic, sizeof(buffer)) == 0));
 }
 
 Strat_Read *Strat_Read::FileFormat(const std::string &fileName) {
-  int pos;
-  std::string extension;
+  if (hasMagic(fileName, Utils::binary::MPG_MAGIC)) return (new BinaryMPGFile);
+  if (hasMagic(fileName, Utils::binary::DATASET_MAGIC)) return (new ColumnarFile);
+
+  std::string::size_type pos = fileName.rfind('.');
+  std::string::size_type slash = fileName.rfind('/');
 
-  if ((pos = fileName.find(".", 2)) == -1) {
+  if ((pos == std::string::npos) || ((slash != std::string::npos) && (pos < slash))) {
     fmt::print("Nome de arquivo sem extensão!");
     exit(0);
   } else {
-    extension = Utils::miscellaneous::upperCase(fileName.substr(pos + 1, 3));
+    std::string extension = Utils::miscellaneous::upperCase(fileName.substr(pos + 1, 3));
 
     if (extension == "TXT") {
       return (new TextFile);
+    } else if (extension == "MPG") {
+      return (new BinaryMPGFile);
+    } else if (extension == "SDS") {
+      return (new ColumnarFile);
     } else {
       fmt::print("Formato de arquivo desconhecido!");
       exit(0);
@@ -0,0 +1,62 @@
+#include <sahga/utils/parallel.hpp>
+#include <sahga/utils/sampling.hpp>
+#include <vector>
+
+namespace Utils {
+  namespace sampling {
+    // Rows per chunk of the table passes.
+    static const int64_t GRAIN = 64;
+
+    void focalMean(const Grid &grid, const double *values, int32_t k, double *out) {
+      const int64_t rows = grid.rows, cols = grid.cols, width = cols + 1;
+      const int32_t half = std::max(k, 1) / 2;
+
+      // sum[r][c] and count[r][c] cover the cells above and left of (r, c): row and
+      // column 0 of the tables are zero.
+      std::vector<double> sum((rows + 1) * width, 0);
+      std::vector<int32_t> count((rows + 1) * width, 0);
+
+      parallel::forChunks(0, rows, GRAIN, [&](int32_t, int64_t begin, int64_t end) {
+        for (int64_t r = begin; r < end; ++r) {
+          const double *row = values + r * cols;
+          double *sumRow = sum.data() + (r + 1) * width;
+          int32_t *countRow = count.data() + (r + 1) * width;
+          for (int64_t c = 0; c < cols; ++c) {
+            const bool valid = (row[c] != grid.noData);
+            sumRow[c + 1] = sumRow[c] + (valid ? row[c] : 0);
+            countRow[c + 1] = countRow[c] + valid;
+          }
+        }
+      });
+
+      // Columns are independent: accumulate the rows down, a band of columns per thread
+      parallel::forChunks(1, width, 1024, [&](int32_t, int64_t begin, int64_t end) {
+        for (int64_t r = 1; r <= rows; ++r) {
+          double *sumRow = sum.data() + r * width;
+          int32_t *countRow = count.data() + r * width;
+          for (int64_t c = begin; c < end; ++c) {
+            sumRow[c] += sumRow[c - width];
+            countRow[c] += countRow[c - width];
+          }
+        }
+      });
+
+      parallel::forChunks(0, rows, GRAIN, [&](int32_t, int64_t begin, int64_t end) {
+        for (int64_t r = begin; r < end; ++r) {
+          const int64_t top = std::max<int64_t>(r - half, 0) * width;
+          const int64_t bottom = std::min<int64_t>(r + half + 1, rows) * width;
+          for (int64_t c = 0; c < cols; ++c) {
+            const int64_t left = std::max<int64_t>(c - half, 0);
+            const int64_t right = std::min<int64_t>(c + half + 1, cols);
+
+            const double total
+                = sum[bottom + right] - sum[bottom + left] - sum[top + right] + sum[top + left];
+            const int32_t n = count[bottom + right] - count[bottom + left] - count[top + right]
+                              + count[top + left];
+            out[r * cols + c] = (n > 0) ? total / n : grid.noData;
+          }
+        }
+      });
+    }
+  }  // namespace sampling
+}  // namespace Utils
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <sahga/utils/statistics.hpp>
+
+namespace Utils {
+  namespace statistics {
+    // Values reduced per block before merging; small enough to stay in L1.
+    static const int64_t BLOCK = 1024;
+    // Independent accumulators per reduction, so the compiler can keep them in SIMD lanes.
+    static const int LANES = 4;
+
+    Moments merge(const Moments &a, const Moments &b) {
+      const double n = a.n + b.n;
+      if (b.n == 0) return a;
+      if (a.n == 0) return b;
+
+      const double delta = b.mean - a.mean;
+      return {n, a.mean + delta * (b.n / n), a.m2 + b.m2 + delta * delta * (a.n * b.n / n)};
+    }
+
+    Moments moments(const double *values, int64_t size) {
+      Moments total = {0, 0, 0};
+
+      for (int64_t start = 0; start < size; start += BLOCK) {
+        const double *block = values + start;
+        const int64_t count = std::min(BLOCK, size - start);
+        const int64_t tail = count - count % LANES;
+
+        // Two passes over a block that is already in cache: mean, then deviations
+        double sum[LANES] = {0, 0, 0, 0};
+        for (int64_t i = 0; i < tail; i += LANES)
+          for (int l = 0; l < LANES; ++l) sum[l] += block[i + l];
+        for (int64_t i = tail; i < count; ++i) sum[0] += block[i];
+
+        const double mean = (sum[0] + sum[1] + sum[2] + sum[3]) / count;
+
+        double m2[LANES] = {0, 0, 0, 0};
+        for (int64_t i = 0; i < tail; i += LANES)
+          for (int l = 0; l < LANES; ++l) {
+            double delta = block[i + l] - mean;
+            m2[l] += delta * delta;
+          }
+        for (int64_t i = tail; i < count; ++i) m2[0] += (block[i] - mean) * (block[i] - mean);
+
+        total = merge(total, {(double)count, mean, m2[0] + m2[1] + m2[2] + m2[3]});
+      }
+
+      return total;
+    }
+
+    Moments moments(const double *values, int64_t size, double noData) {
+      Moments total = {0, 0, 0};
+
+      for (int64_t start = 0; start < size; start += BLOCK) {
+        const double *block = values + start;
+        const int64_t count = std::min(BLOCK, size - start);
+        const int64_t tail = count - count % LANES;
+
+        // Branch-free masking: invalid values contribute zero to every accumulator
+        double n[LANES] = {0, 0, 0, 0};
+        double sum[LANES] = {0, 0, 0, 0};
+        for (int64_t i = 0; i < tail; i += LANES)
+          for (int l = 0; l < LANES; ++l) {
+            bool valid = block[i + l] != noData;
+            n[l] += valid ? 1 : 0;
+            sum[l] += valid ? block[i + l] : 0;
+          }
+        for (int64_t i = tail; i < count; ++i)
+          if (block[i] != noData) {
+            n[0] += 1;
+            sum[0] += block[i];
+          }
+
+        const double valid = n[0] + n[1] + n[2] + n[3];
+        if (valid == 0) continue;
+        const double mean = (sum[0] + sum[1] + sum[2] + sum[3]) / valid;
+
+        double m2[LANES] = {0, 0, 0, 0};
+        for (int64_t i = 0; i < tail; i += LANES)
+          for (int l = 0; l < LANES; ++l) {
+            double delta = (block[i + l] != noData) ? block[i + l] - mean : 0;
+            m2[l] += delta * delta;
+          }
+        for (int64_t i = tail; i < count; ++i)
+          if (block[i] != noData) m2[0] += (block[i] - mean) * (block[i] - mean);
+
+        total = merge(total, {valid, mean, m2[0] + m2[1] + m2[2] + m2[3]});
+      }
+
+      return total;
+    }
+
+    ColumnMoments::ColumnMoments(int32_t columns)
+        : _moments(columns, {0, 0, 0}), _mean(columns), _m2(columns) {}
+
+    void ColumnMoments::add(const double *first, int64_t rows, int64_t stride) {
+      const int32_t cols = columns();
+      if (cols == 0) return;
+
+      // Rows per block, so that a block stays about BLOCK * 16 values (128 KB)
+      const int64_t blockRows = std::max<int64_t>(1, BLOCK * 16 / cols);
+      double *mean = _mean.data();
+      double *m2 = _m2.data();
+
+      for (int64_t start = 0; start < rows; start += blockRows) {
+        const int64_t count = std::min(blockRows, rows - start);
+        const double *block = first + start * stride;
+
+        std::fill(_mean.begin(), _mean.end(), 0.0);
+        std::fill(_m2.begin(), _m2.end(), 0.0);
+
+        for (int64_t i = 0; i < count; ++i) {
+          const double *row = block + i * stride;
+          for (int32_t j = 0; j < cols; ++j) mean[j] += row[j];
+        }
+        for (int32_t j = 0; j < cols; ++j) mean[j] /= count;
+
+        for (int64_t i = 0; i < count; ++i) {
+          const double *row = block + i * stride;
+          for (int32_t j = 0; j < cols; ++j) {
+            double delta = row[j] - mean[j];
+            m2[j] += delta * delta;
+          }
+        }
+
+        for (int32_t j = 0; j < cols; ++j)
+          _moments[j] = statistics::merge(_moments[j], {(double)count, mean[j], m2[j]});
+      }
+    }
+
+    void ColumnMoments::merge(const ColumnMoments &other) {
+      for (int32_t j = 0; j < columns(); ++j)
+        _moments[j] = statistics::merge(_moments[j], other._moments[j]);
+    }
+  }  // namespace statistics
+}  // namespace Utils
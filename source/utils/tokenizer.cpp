@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <sahga/utils/parallel.hpp>
+#include <sahga/utils/tokenizer.hpp>
+
+namespace Utils {
+  namespace parsing {
+    // Bytes per chunk below which splitting lines across threads is not worth it.
+    static const int64_t BYTES_PER_CHUNK = 1 << 20;
+
+    std::vector<std::string_view> lines(std::string_view text) {
+      const int64_t size = (int64_t)text.size();
+      const int32_t chunks = std::max(1, Utils::parallel::chunkCount(size, BYTES_PER_CHUNK));
+
+      // First line starting at or after each nominal chunk boundary
+      std::vector<int64_t> start(chunks + 1, size);
+      start[0] = 0;
+      for (int32_t c = 1; c < chunks; ++c) {
+        size_t newline = text.find('\n', size * c / chunks - 1);
+        start[c] = (newline == std::string_view::npos) ? size : (int64_t)newline + 1;
+      }
+
+      std::vector<std::vector<std::string_view>> found(chunks);
+      Utils::parallel::forChunks(0, chunks, 1, [&](int32_t, int64_t first, int64_t last) {
+        for (int64_t c = first; c < last; ++c) {
+          int64_t position = start[c];
+          while (position < start[c + 1]) {
+            size_t newline = text.find('\n', position);
+            int64_t end = (newline == std::string_view::npos) ? size : (int64_t)newline;
+
+            std::string_view line = text.substr(position, end - position);
+            if (!line.empty() && (line.back() == '\r')) line.remove_suffix(1);
+            found[c].push_back(line);
+
+            position = end + 1;
+          }
+        }
+      });
+
+      std::vector<std::string_view> result;
+      size_t total = 0;
+      for (const auto &chunk : found) total += chunk.size();
+      result.reserve(total);
+      for (const auto &chunk : found) result.insert(result.end(), chunk.begin(), chunk.end());
+
+      return result;
+    }
+
+    bool parseNumber(std::string_view token, double &value) {
+      while (!token.empty() && ((token.front() == ' ') || (token.front() == '\t')))
+        token.remove_prefix(1);
+      while (!token.empty() && ((token.back() == ' ') || (token.back() == '\r')))
+        token.remove_suffix(1);
+      if (!token.empty() && (token.front() == '+')) token.remove_prefix(1);
+      if (token.empty()) return false;
+
+      const char *first = token.data();
+      const char *last = token.data() + token.size();
+
+      // Decimal comma: parse a copy with a decimal point instead
+      char buffer[64];
+      if ((token.find(',') != std::string_view::npos) && (token.size() < sizeof(buffer))) {
+        std::replace_copy(token.begin(), token.end(), buffer, ',', '.');
+        first = buffer;
+        last = buffer + token.size();
+      }
+
+      return (std::from_chars(first, last, value).ec == std::errc());
+    }
+
+    double number(std::string_view token) {
+      double value = 0;
+      return parseNumber(token, value) ? value : 0;
+    }
+
+    Tokenizer::Tokenizer(std::string_view line, char separator)
+        : _rest(line),
+          _separator(separator),
+          _blank((separator == ' ') || (separator == '\t')),
+          _done(false) {
+      if (_blank) {
+        while (!_rest.empty() && ((_rest.front() == ' ') || (_rest.front() == '\t')))
+          _rest.remove_prefix(1);
+        _done = _rest.empty();
+      }
+    }
+
+    bool Tokenizer::next(std::string_view &token) {
+      if (_done) return false;
+
+      size_t end = _blank ? _rest.find_first_of(" \t") : _rest.find(_separator);
+      if (end == std::string_view::npos) {
+        token = _rest;
+        _rest = std::string_view();
+        _done = true;
+        return true;
+      }
+
+      token = _rest.substr(0, end);
+      _rest.remove_prefix(end + 1);
+      if (_blank)
+        while (!_rest.empty() && ((_rest.front() == ' ') || (_rest.front() == '\t')))
+          _rest.remove_prefix(1);
+      _done = _rest.empty();
+
+      return true;
+    }
+
+    bool Tokenizer::next(double &value) {
+      std::string_view token;
+      if (!next(token)) return false;
+
+      value = number(token);
+      return true;
+    }
+
+    bool Tokenizer::skip(int32_t fields) {
+      std::string_view token;
+      for (int32_t i = 0; i < fields; ++i)
+        if (!next(token)) return false;
+
+      return true;
+    }
+  }  // namespace parsing
+}  // namespace Utils
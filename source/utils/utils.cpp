@@ -1,3 +1,9 @@
+#include <fmt/format.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <sahga/utils/tokenizer.hpp>
 #include <sahga/utils/utils.hpp>
 #include <sstream>
 
@@ -19,14 +25,12 @@ namespace Utils {
      */
     std::vector<std::string> split(std::string str, char delimiter) {
       std::vector<std::string> result;
-      int8_t pos = 0;
-      std::string token;
-      while ((pos = str.find(delimiter)) != std::string::npos) {
-        token = str.substr(0, pos);
-        result.push_back(token);
-        str.erase(0, pos + 1);
+      size_t start = 0, pos;
+      while ((pos = str.find(delimiter, start)) != std::string::npos) {
+        result.emplace_back(str, start, pos - start);
+        start = pos + 1;
       }
-      result.push_back(str);
+      result.emplace_back(str, start);
       return result;
     }
 
@@ -52,6 +56,32 @@ namespace Utils {
       std::transform(str.begin(), str.end(), str.begin(), ::toupper);
       return str;
     }
+
+    /*
+     * 64-bit FNV-1a style hash, folding 8 bytes per step. Chaining calls through seed
+     * hashes discontiguous buffers as one.
+     *
+     * @param { const void * } **data** - Bytes to hash.
+     * @param { size_t } **size** - Number of bytes.
+     * @param { uint64_t } **seed** - Hash of the previous buffers, if any.
+     *
+     * @return { uint64_t } - The hash.
+     * */
+    uint64_t hash(const void *data, size_t size, uint64_t seed) {
+      const uint64_t prime = 1099511628211ULL;
+      const unsigned char *bytes = (const unsigned char *)data;
+      uint64_t value = seed;
+
+      size_t i = 0;
+      for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        value = (value ^ word) * prime;
+      }
+      for (; i < size; ++i) value = (value ^ bytes[i]) * prime;
+
+      return value;
+    }
   }  // namespace miscellaneous
 
   namespace filemanagement {
@@ -65,12 +95,11 @@ namespace Utils {
     }
 
     double getNumber(std::string &line, char separator) {
-      int32_t i = 0;
-      while ((line[i] != separator) && (line[i] != '\0')) ++i;
-      std::string buffer = line.substr(0, i);
+      size_t i = std::min(line.find(separator), line.size());
+      double value = Utils::parsing::number(std::string_view(line).substr(0, i));
       line.erase(0, i + 1);
 
-      return std::atof(buffer.c_str());
+      return value;
     }
 
     std::string splitOnce(std::string &line, char separator) {
@@ -80,5 +109,30 @@ namespace Utils {
       line.erase(0, i + 1);
       return (Utils::miscellaneous::upperCase(buffer));
     }
+
+    /*
+     * Writes fileName through a temporary file of its folder, renamed into place once
+     * complete. A run that stops halfway leaves at most a stray temporary file, and
+     * writers racing on one fileName each rename a whole file of their own.
+     *
+     * @param { std::string } fileName - Path of the file to write.
+     * @param { function } write - Writes the file to the path it is given.
+     * */
+    void writeAtomically(const std::string &fileName,
+                         const std::function<void(const std::string &temporary)> &write) {
+      static std::atomic<uint64_t> counter(0);
+      const std::string temporary
+          = fmt::format("{}.{}.{}.tmp", fileName,
+                        std::chrono::steady_clock::now().time_since_epoch().count(), counter++);
+
+      try {
+        write(temporary);
+        std::filesystem::rename(temporary, fileName);
+      } catch (...) {
+        std::error_code error;
+        std::filesystem::remove(temporary, error);
+        throw;
+      }
+    }
   }  // namespace filemanagement
 }  // namespace Utils
@@ -1,9 +1,33 @@
 #include <sahga/core/core.hpp>
+#include <sahga/utils/parallel.hpp>
 
 int main(int argc, char *argv[]) {
   std::string functionparameters[argc - 1];
   std::copy(argv + 1, argv + argc, functionparameters);
 
+  // SAHGA --daemon [socket] [budget in MB] serves requests until asked to shut down
+  if ((argc > 1) && (std::string(argv[1]) == "--daemon")) {
+    const std::string socketPath = (argc > 2) ? argv[2] : "/tmp/sahga.sock";
+    const size_t budget = (argc > 3) ? std::stoul(argv[3]) : 512;
+    SAHGACore::serve(socketPath, budget << 20);
+    return 0;
+  }
+
+  // SAHGA --cv <points> <layers> [folds] [spatial] cross validates the default model
+  if ((argc > 3) && (std::string(argv[1]) == "--cv")) {
+    const int32_t folds = (argc > 4) ? std::stoi(argv[4]) : 5;
+    const bool spatial = (argc > 5) && (std::string(argv[5]) == "spatial");
+    SAHGACore::crossValidate(argv[2], argv[3], folds, spatial);
+    return 0;
+  }
+
+  // SAHGA <queue> [workers] runs a queue of jobs; with no arguments, the default one
+  if (argc > 1) {
+    const int32_t workers = (argc > 2) ? std::stoi(argv[2]) : Utils::parallel::threads();
+    SAHGACore::runJobs(argv[1], workers);
+    return 0;
+  }
+
   std::make_unique<SAHGACore>();
 
   return 0;
@@ -0,0 +1,102 @@
+#include <chrono>
+#include <sahga/core/core.hpp>
+#include <sahga/utils/mapped_file.hpp>
+#include <sahga/utils/parallel.hpp>
+#include <sahga/utils/tokenizer.hpp>
+
+/*
+ * Parse throughput of the text readers, in MB/s.
+ *
+ * Usage: parse_benchmark [file...]
+ *
+ * Every number of each file is parsed twice: with the old getline + getNumber loop
+ * and with Utils::parsing (mapped file, parallel lines, Tokenizer). Without files a
+ * synthetic 2000 x 2000 ASCII grid is written to the temporary directory and used.
+ * */
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds(Clock::time_point since) {
+  return std::chrono::duration<double>(Clock::now() - since).count();
+}
+
+// Field separator of a text file, guessed from its last line.
+static char separatorOf(std::string_view text) {
+  std::vector<std::string_view> lines = Utils::parsing::lines(text);
+  while (!lines.empty() && lines.back().empty()) lines.pop_back();
+  if (lines.empty()) return ' ';
+
+  if (lines.back().find(';') != std::string_view::npos) return ';';
+  if (lines.back().find('\t') != std::string_view::npos) return '\t';
+  return ' ';
+}
+
+static double legacySum(const std::string &fileName, char separator) {
+  std::ifstream inputStream(fileName);
+  std::string line;
+  double sum = 0;
+
+  while (getline(inputStream, line))
+    while (line != "") sum += Utils::filemanagement::getNumber(line, separator);
+
+  return sum;
+}
+
+static double tokenizerSum(const std::string &fileName, char separator) {
+  MappedFile file(fileName);
+  std::vector<std::string_view> lines
+      = Utils::parsing::lines(std::string_view(file.data(), file.size()));
+  std::vector<double> partial(Utils::parallel::chunkCount(lines.size(), 4096));
+
+  Utils::parallel::forChunks(0, lines.size(), 4096, [&](int32_t chunk, int64_t begin, int64_t end) {
+    double sum = 0, value;
+    for (int64_t i = begin; i < end; ++i) {
+      Utils::parsing::Tokenizer tokens(lines[i], separator);
+      while (tokens.next(value)) sum += value;
+    }
+    partial[chunk] = sum;
+  });
+
+  return std::accumulate(partial.begin(), partial.end(), 0.0);
+}
+
+static std::string syntheticGrid() {
+  std::string fileName
+      = (std::filesystem::temp_directory_path() / "sahga_parse_benchmark.asc").string();
+  std::ofstream outputStream(fileName);
+
+  outputStream << "NCOLS 2000\nNROWS 2000\nXLLCORNER -73.98\nYLLCORNER -33.75\n"
+               << "CELLSIZE 0.041666\nNODATA_VALUE -9999\n";
+  for (int32_t i = 0; i < 2000; ++i) {
+    for (int32_t j = 0; j < 2000; ++j) outputStream << (i * 7919 + j * 104729) % 4000 << ' ';
+    outputStream << "\n";
+  }
+
+  return fileName;
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<std::string> files(argv + 1, argv + argc);
+  if (files.empty()) files.push_back(syntheticGrid());
+
+  fmt::print("{} thread(s)\n", Utils::parallel::threads());
+  for (const std::string &fileName : files) {
+    MappedFile file(fileName);
+    const double megabytes = file.size() / 1048576.0;
+    const char separator = separatorOf(std::string_view(file.data(), file.size()));
+
+    Clock::time_point start = Clock::now();
+    double legacy = legacySum(fileName, separator);
+    double legacyTime = seconds(start);
+
+    start = Clock::now();
+    double current = tokenizerSum(fileName, separator);
+    double currentTime = seconds(start);
+
+    fmt::print("{} ({:.1f} MB)\n", fileName, megabytes);
+    fmt::print("  getNumber  {:9.1f} MB/s  (sum {:.6g})\n", megabytes / legacyTime, legacy);
+    fmt::print("  Tokenizer  {:9.1f} MB/s  (sum {:.6g})\n", megabytes / currentTime, current);
+  }
+
+  return 0;
+}
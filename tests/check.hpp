@@ -0,0 +1,14 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include <cstdlib>
+
+// Prints the failed condition and leaves the test with a failure status.
+#define CHECK(condition)                                                                \
+  do {                                                                                  \
+    if (!(condition)) {                                                                 \
+      fmt::print(stderr, "{}:{}: CHECK({}) failed\n", __FILE__, __LINE__, #condition); \
+      std::exit(1);                                                                     \
+    }                                                                                   \
+  } while (0)
@@ -0,0 +1,58 @@
+#include <fmt/format.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sahga/structures/dataset.hpp>
+#include <sahga/utils/binary_format.hpp>
+#include <sahga/utils/read.hpp>
+#include <stdexcept>
+#include <string>
+
+#include "check.hpp"
+
+// Whether reading fileName with reader throws.
+static bool fails(ColumnarFile &reader, const std::string &fileName) {
+  Dataset M;
+  try {
+    reader.ReadData(M, fileName, ';');
+  } catch (const std::runtime_error &) {
+    return true;
+  }
+  return false;
+}
+
+int main() {
+  const std::filesystem::path fileName
+      = std::filesystem::temp_directory_path()
+        / fmt::format("sahga-columnar-{}.sds",
+                      std::chrono::steady_clock::now().time_since_epoch().count());
+
+  Dataset M;
+  M.reset(100, 3);
+  M.names = {"presence", "a", "b"};
+  for (int32_t i = 0; i < M.rowN; ++i)
+    for (int32_t j = 0; j < M.colN; ++j) M.M[i][j] = i * 0.5 + j;
+  CHECK(M.saveBinary(fileName.string()));
+
+  ColumnarFile quick, verified(true);
+  CHECK(!fails(quick, fileName.string()));
+  CHECK(!fails(verified, fileName.string()));
+
+  // A damaged value goes unnoticed unless the whole file is verified
+  {
+    using namespace Utils::binary;
+    std::fstream file(fileName, std::ios::in | std::ios::out | std::ios::binary);
+    ColumnHeader column;
+    file.seekg(sizeof(DatasetHeader));
+    file.read((char *)&column, sizeof(column));
+    file.seekp(column.dataOffset + 3);
+    const char damage = 0x7f;
+    file.write(&damage, 1);
+  }
+  CHECK(!fails(quick, fileName.string()));
+  CHECK(fails(verified, fileName.string()));
+
+  std::filesystem::remove(fileName);
+  return 0;
+}
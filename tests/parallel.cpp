@@ -0,0 +1,69 @@
+#include <atomic>
+#include <mutex>
+#include <sahga/utils/parallel.hpp>
+#include <stdexcept>
+
+#include "check.hpp"
+
+using namespace Utils::parallel;
+
+// A thread waiting on a group while it holds a lock runs none of the other groups' tasks,
+// which may need that lock.
+static void checkWaitRunsOwnTasks() {
+  Executor executor(1);
+  std::mutex mutex;
+  std::atomic<int32_t> ran(0);
+
+  TaskGroup other(executor);
+  std::unique_lock<std::mutex> lock(mutex);
+  for (int32_t i = 0; i < 4; ++i)
+    other.run([&]() {
+      std::lock_guard<std::mutex> taken(mutex);
+      ++ran;
+    });
+
+  TaskGroup own(executor);
+  for (int32_t i = 0; i < 64; ++i) own.run([&]() { ++ran; });
+  own.wait();
+  CHECK(ran >= 64);
+
+  lock.unlock();
+  other.wait();
+  CHECK(ran == 68);
+}
+
+// wait rethrows the failure of a task after every task is done.
+static void checkErrors() {
+  std::atomic<int32_t> ran(0);
+  TaskGroup group;
+  for (int32_t i = 0; i < 16; ++i)
+    group.run([&, i]() {
+      ++ran;
+      if (i == 7) throw std::runtime_error("task 7");
+    });
+
+  bool thrown = false;
+  try {
+    group.wait();
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  CHECK(thrown && (ran == 16));
+}
+
+// Nested forChunks on every worker completes.
+static void checkNested() {
+  std::atomic<int64_t> sum(0);
+  forChunks(0, 64, 1, [&](int32_t, int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i)
+      forChunks(0, 1000, 10, [&](int32_t, int64_t first, int64_t last) { sum += last - first; });
+  });
+  CHECK(sum == 64 * 1000);
+}
+
+int main() {
+  checkWaitRunsOwnTasks();
+  checkErrors();
+  checkNested();
+  return 0;
+}
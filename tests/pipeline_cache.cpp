@@ -0,0 +1,74 @@
+#include <fmt/format.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sahga/core/pipeline.hpp>
+#include <string>
+
+#include "check.hpp"
+
+// Points of two labels scattered over the grid of writeLayer, as in PtsFurcata.txt.
+static void writePoints(const std::filesystem::path &fileName, int32_t count) {
+  std::ofstream outputStream(fileName);
+  outputStream << "#id label long  lat abundance\n";
+  for (int32_t i = 0; i < count; ++i) {
+    const std::string longitude = fmt::format("{:.4f}", -59.5 + (i * 7 % 19) + 0.01 * i);
+    const std::string latitude = fmt::format("{:.4f}", -19.5 + (i * 11 % 19) + 0.02 * i);
+    outputStream << fmt::format("{}\tspecies\t{}\t{}\t{}\n", i + 1, longitude, latitude, i % 2);
+  }
+}
+
+// A 20 x 20 ESRI ASCII grid over [-60, -40] x [-20, 0].
+static void writeLayer(const std::filesystem::path &fileName, int32_t seed) {
+  std::ofstream outputStream(fileName);
+  outputStream << "ncols 20\nnrows 20\nxllcorner -60\nyllcorner -20\ncellsize 1\n"
+               << "NODATA_value -9999\n";
+  for (int32_t row = 0; row < 20; ++row) {
+    for (int32_t col = 0; col < 20; ++col) outputStream << (row * seed + col) % 37 << ' ';
+    outputStream << '\n';
+  }
+}
+
+// Runs the stages up to mergeData on a fresh pipeline, loading from cacheFolder what it can.
+static void merge(const std::filesystem::path &folder, const std::filesystem::path &cacheFolder,
+                  Dataset &merged, int32_t &nodes) {
+  Pipeline pipeline(folder.string());
+  pipeline.useCache(cacheFolder.string())
+      ->separateTrainTest((folder / "points.txt").string())
+      ->generateMPG()
+      ->extractLayers((folder / "layers").string())
+      ->mergeData();
+
+  CHECK(pipeline.graph->nNodes == pipeline.train.rowN);
+  CHECK(pipeline.merged->rowN == pipeline.graph->nNodes);
+  CHECK(pipeline.merged->colN == 3);  // presence and the two layers
+
+  merged = *pipeline.merged;
+  nodes = pipeline.graph->nNodes;
+}
+
+int main() {
+  const std::filesystem::path folder
+      = std::filesystem::temp_directory_path()
+        / fmt::format("sahga-pipeline-cache-{}",
+                      std::chrono::steady_clock::now().time_since_epoch().count());
+  std::filesystem::create_directories(folder / "layers");
+  writePoints(folder / "points.txt", 40);
+  writeLayer(folder / "layers" / "a.asc", 3);
+  writeLayer(folder / "layers" / "b.asc", 5);
+
+  // The second run restores every stage from the cache the first one filled
+  Dataset first, second;
+  int32_t firstNodes = 0, secondNodes = 0;
+  merge(folder, folder / "cache", first, firstNodes);
+  merge(folder, folder / "cache", second, secondNodes);
+
+  CHECK(secondNodes == firstNodes);
+  CHECK((second.rowN == first.rowN) && (second.colN == first.colN));
+  for (int32_t i = 0; i < first.rowN; ++i)
+    for (int32_t j = 0; j < first.colN; ++j) CHECK(second.M[i][j] == first.M[i][j]);
+
+  std::filesystem::remove_all(folder);
+  return 0;
+}
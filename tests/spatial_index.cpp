@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <cmath>
+#include <sahga/structures/graph.hpp>
+#include <sahga/structures/spatial_index.hpp>
+#include <sahga/utils/utils.hpp>
+#include <vector>
+
+#include "check.hpp"
+
+// Distance to the k-th closest point of the same label, by brute force.
+static double kthDistance(const Dataset &M, int32_t i, int32_t k) {
+  std::vector<double> distances;
+  for (int32_t j = 0; j < M.rowN; ++j)
+    if ((j != i) && (M.M[j][3] == M.M[i][3]))
+      distances.push_back(
+          Utils::miscellaneous::distance(M.M[i][1], M.M[i][2], M.M[j][1], M.M[j][2]));
+  std::sort(distances.begin(), distances.end());
+  return distances.empty() ? 0 : distances[std::min<size_t>(k, distances.size()) - 1];
+}
+
+// Every node of a KNN MPG over M holds its k closest points of the same label, whether
+// searched for directly or taken from a neighbor table (R <= 0: no radius limit).
+static void checkNearest(const Dataset &M, int32_t k) {
+  Graph graph, fromTable;
+  graph.setNeighbors(k)->createMPG(M, 0, Graph::KNN);
+  fromTable.setNeighbors(k)->createMPG(M, Graph::findNeighbors(M, 20000), 0, Graph::KNN);
+  CHECK(graph.nNodes == M.rowN);
+  CHECK(fromTable.nNodes == M.rowN);
+
+  for (int32_t i = 0; i < M.rowN; ++i) {
+    int32_t same = 0;
+    for (int32_t j = 0; j < M.rowN; ++j) same += (j != i) && (M.M[j][3] == M.M[i][3]);
+
+    const TNode &node = graph.node[i];
+    CHECK(node.nRel == 1 + std::min(k, same));
+    if (same == 0) continue;
+
+    const int32_t farthest = node.edge.back().nodeId - 1;
+    const double distance = Utils::miscellaneous::distance(M.M[i][1], M.M[i][2],
+                                                           M.M[farthest][1], M.M[farthest][2]);
+    CHECK(std::fabs(distance - kthDistance(M, i, k)) <= 1e-9);
+
+    const TNode &tabled = fromTable.node[i];
+    CHECK(tabled.nRel == node.nRel);
+    const int32_t last = tabled.edge.back().nodeId - 1;
+    CHECK(std::fabs(Utils::miscellaneous::distance(M.M[i][1], M.M[i][2], M.M[last][1],
+                                                   M.M[last][2])
+                    - distance)
+          <= 1e-9);
+  }
+}
+
+static Dataset points(const std::vector<std::pair<double, double>> &locations) {
+  Dataset M;
+  M.reset(locations.size(), 4);
+  for (size_t i = 0; i < locations.size(); ++i) {
+    M.M[i][0] = (double)(i + 1);
+    M.M[i][1] = locations[i].first;
+    M.M[i][2] = locations[i].second;
+    M.M[i][3] = (double)(i % 2);
+  }
+  return M;
+}
+
+int main() {
+  std::vector<std::pair<double, double>> locations;
+
+  // All on one parallel
+  for (int32_t i = 0; i < 400; ++i) locations.emplace_back(-50 + 0.01 * i, -20);
+  checkNearest(points(locations), 8);
+
+  // All on one spot
+  locations.assign(300, {-47.5, -15.8});
+  checkNearest(points(locations), 8);
+
+  // A line a few nanodegrees long, with every point repeated
+  locations.clear();
+  for (int32_t i = 0; i < 600; ++i) locations.emplace_back(-47.5, -15.8 + 1e-9 * (i / 3));
+  checkNearest(points(locations), 6);
+
+  // Cells far smaller than the distances between the points
+  SpatialIndex index(1e-12);
+  const int32_t first = index.insert(-179.9, -89.9);
+  index.insert(179.9, 89.9);
+  index.insert(0, 0);
+
+  std::vector<SpatialIndex::Neighbor> found;
+  index.nearest(-179.0, -89.0, 3, 0, 0, found);
+  CHECK(found.size() == 3);
+  CHECK(found[0].slot == first);
+  index.radius(-179.9, -89.9, 1, 0, found);
+  CHECK((found.size() == 1) && (found[0].slot == first));
+
+  return 0;
+}
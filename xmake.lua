@@ -10,9 +10,29 @@ target("sahga_lib")
   set_kind("static")
   add_files("source/**/*.cpp")
   add_packages(table.unpack(libs))
+  add_syslinks("pthread", { public = true })
 
 target("SAHGA")
   set_kind("binary")
   add_files("standalone/main.cpp")
   add_packages(table.unpack(libs))
   add_deps("sahga_lib")
+
+target("parse_benchmark")
+  set_kind("binary")
+  set_default(false)
+  add_files("standalone/parse_benchmark.cpp")
+  add_packages(table.unpack(libs))
+  add_deps("sahga_lib")
+
+-- One binary per file in tests/, run by `xmake test`
+for _, file in ipairs(os.files("tests/*.cpp")) do
+  target("test_" .. path.basename(file))
+    set_kind("binary")
+    set_default(false)
+    set_group("tests")
+    add_files(file)
+    add_packages(table.unpack(libs))
+    add_deps("sahga_lib")
+    add_tests("default")
+end